@@ -19,6 +19,27 @@ FD_C_SRCS=(
   "$FD_SRC/util/shmem/fd_numa_linux.c"
   "$FD_SRC/util/shmem/fd_shmem_admin.c"   # ← provides _private_boot/_halt
   "$FD_SRC/util/shmem/fd_shmem_user.c"
+
+  # software ed25519 for the device emulator and the CPU verify pool
+  "$FD_SRC/ballet/sha512/fd_sha512.c"
+)
+for src in "$FD_SRC"/ballet/ed25519/fd_*.c; do
+  FD_C_SRCS+=("$src")
+done
+
+# ─── Wiredancer host library ─────────────────────────────────────────────────
+WD_C_SRCS=(
+  wd_f1.c
+  wd_emu.c
+  wd_tel.c
+  wd_cpu.c
+  wd_cache.c
+  wd_rob.c
+  wd_infl.c
+  wd_shm.c
+  wd_evt.c
+  wd_ring.c
+  wd_trace.c
 )
 
 # single-thread tile helper (no atomics)
@@ -37,9 +58,23 @@ DEFS="-DFD_LOG_STYLE=0 -DFD_ENV_STYLE=FD_ENV_STYLE_LINUX -DFD_SHMEM_STYLE=FD_SHM
 CFLAGS="-O2 -std=gnu17   -mavx2 -D_GNU_SOURCE $DEFS"
 CXXFLAGS="-O2 -std=gnu++17 -mavx2 -D_GNU_SOURCE $DEFS"
 
+# ─── Programs ────────────────────────────────────────────────────────────────
+BINS=(
+  test_dma
+  wd_bench
+  wd_mmio
+  wd_evt2json
+)
+
 # ─── Compile C ───────────────────────────────────────────────────────────────
+for bin in "${BINS[@]}"; do
+  gcc  $CFLAGS   -include linux/mman.h \
+       -I"$INC_AWS" -I"$INC_MGMT" -I"$INC_TANGO" -I"$INC_UTIL" -I"$INC_WD" \
+       -c "$bin.c" -o "$bin.o"
+done
+
 OBJS=()
-for src in test_dma.c wd_f1.c "${FD_C_SRCS[@]}"; do
+for src in "${WD_C_SRCS[@]}" "${FD_C_SRCS[@]}"; do
   obj="$(basename "${src%.*}").o"
   gcc  $CFLAGS   -include linux/mman.h \
        -I"$INC_AWS" -I"$INC_MGMT" -I"$INC_TANGO" -I"$INC_UTIL" -I"$INC_WD" \
@@ -54,9 +89,11 @@ g++  $CXXFLAGS \
 OBJS+=("fd_tile_nothreads.o")
 
 # ─── Link ────────────────────────────────────────────────────────────────────
-g++ -mavx2 "${OBJS[@]}" \
-    -L"$LIB_AWS" -lfpga_mgmt -lfpga_pci -lutils -lpthread -lrt \
-    -o test_dma
+for bin in "${BINS[@]}"; do
+  g++ -mavx2 "$bin.o" "${OBJS[@]}" \
+      -L"$LIB_AWS" -lfpga_mgmt -lfpga_pci -lutils -lpthread -lrt \
+      -o "$bin"
+  echo "Built ./$bin"
+done
 
 export LD_LIBRARY_PATH="$LIB_AWS:${LD_LIBRARY_PATH:-}"
-echo "Built ./test_dma"
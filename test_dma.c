@@ -8,10 +8,13 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <time.h>
+#include <pthread.h>
 #include <immintrin.h>
 
 #include <fpga_mgmt.h>
 #include "wd_f1.h"
+#include "wd_emu.h"
+#include "wd_tel.h"
 
 #define HP_SIZE   (2UL << 20)
 #define DEPTH     1024
@@ -20,12 +23,17 @@
 
 /* -------------- helpers ------------------------------------------------ */
 
-static void *alloc_hugepage(void) {
-    void *p = mmap(NULL, HP_SIZE,
-                   PROT_READ | PROT_WRITE,
-                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB,
-                   -1, 0);
-    if(p == MAP_FAILED) { perror("mmap hugepage"); exit(1); }
+static int hp_heap = 0;
+
+/* the hugepage goes on the slot's NUMA node, when known */
+static void *alloc_hugepage(int emu, int node) {
+    void *p = wd_hp_alloc(HP_SIZE, HP_SIZE, node);
+    /* the emulator does not DMA, ordinary (aligned) pages will do */
+    if(!p && emu) {
+        p = aligned_alloc(HP_SIZE, HP_SIZE);
+        hp_heap = 1;
+    }
+    if(!p) { perror("mmap hugepage"); exit(1); }
     memset(p, 0, HP_SIZE);
     return p;
 }
@@ -97,74 +105,8 @@ static uint32_t read_vled_counter(uint8_t func, uint8_t ctr_sel) {
     return v;
 }
 
-/* -------------- counter helpers --------------------------------------- */
-
-struct cntr_desc { uint8_t idx; const char *name; };
-
-static const struct cntr_desc snap_desc[] = {
-    { 1,  "pad in"    },
-    { 2,  "pad out"   },
-    { 3,  "sha out"   },
-    { 4,  "sv0 out"   },
-    { 5,  "sv2_f    " },
-    { 6,  "sv2 out"   },
-    { 7,  "ecc out"   },
-
-    {10,  "input count"      },
-    {11,  "input fifo fill"  },
-    {12,  "input drops"      },
-    {13,  "result count"     },
-    {14,  "result fifo fill" },
-    {15,  "result drops"     },
-    {16,  "result dma count" }
-};
-
-/* read and print snapshot counters */
-static void print_snapshot(wd_wksp_t *wd) {
-    puts("\n--- counters ---");
-    for(size_t i = 0; i < sizeof(snap_desc)/sizeof(snap_desc[0]); i++) {
-        uint32_t val = wd_rd_cntr(wd, SLOT, snap_desc[i].idx);
-        printf("  %-18s : %10u (idx %u)\n",
-               snap_desc[i].name, val, snap_desc[i].idx);
-    }
-    printf("\n");
-}
-
-/* -------------- main --------------------------------------------------- */
-
-int main(void) {
-    wd_wksp_t wd = {0};
-
-    puts("allocating hugepage...");
-    void *hp = alloc_hugepage();
-
-    /* zero the whole 2 MiB page and push clean data to DRAM */
-    memset(hp, 0, HP_SIZE);
-    clflush_hugepage(hp, HP_SIZE);
-
-    if (wd_init_pci(&wd, SLOT_MASK)) {
-        fprintf(stderr, "wd_init_pci failed\n");
-        return 1;
-    }
-
-    printf("allocated hugepage address  : 0x%016" PRIx64 "\n", hp);
-
-    puts("initializing verify request...");
-    wd_ed25519_verify_init_req(&wd, 1, DEPTH, hp);
-
-    struct timespec ts = {0, 5 * 1000 * 2000};   /* 10 ms */
-    nanosleep(&ts, NULL);                         /* wait for init */
-
-    /* dummy verify request */
-    uint8_t msg[64] = {0}, sig[64] = {0}, pub[32] = {0};
-    uint64_t m_seq = 1;
-
-    puts("sending verify request...");
-    wd_ed25519_verify_req(&wd, msg, sizeof(msg),
-                          sig, pub, m_seq, 0, 0x3, sizeof(msg));
-
-    nanosleep(&ts, NULL);                         /* allow CL to issue AW */
-
+/* vLED/PCIM debug state, only meaningful on real hardware */
+static void dump_pcim(void) {
     dump_vled();
 
     /* poll for non-zero AW address (func 0xE) */
@@ -205,20 +147,112 @@ int main(void) {
     for(uint8_t s = 0; s < 8; s++) 
         wstrb |= ((uint64_t)get_vled_byte(0xA, s)) << (s*8);
     printf("captured WSTRB mask  : 0x%016" PRIx64 "\n", wstrb);
+}
 
-    wd_snp_cntrs(&wd, SLOT);
+/* -------------- counter helpers --------------------------------------- */
 
-    print_snapshot(&wd);
+/* read and print snapshot counters */
+static void print_snapshot(wd_wksp_t *wd) {
+    puts("\n--- counters ---");
+    for(size_t i = 0; i < WD_TEL_N_CNTR; i++) {
+        uint32_t val = wd_rd_cntr(wd, SLOT, wd_cntr_desc[i].idx);
+        printf("  %-18s : %10u (idx %u)\n",
+               wd_cntr_desc[i].name, val, wd_cntr_desc[i].idx);
+    }
+    printf("\n");
+}
 
-    /* give the DMA engine time to finish, then invalidate CPU cache */
-    nanosleep(&ts, NULL);
+/* -------------- main --------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    wd_wksp_t wd = {0};
+    wd_emu_t  emu;
+
+    /* --emu runs the same sequence against the software device model */
+    int use_emu = argc > 1 && !strcmp(argv[1], "--emu");
+
+    if (use_emu) {
+        if (wd_emu_init(&emu, 0) || wd_emu_start(&emu)) {
+            fprintf(stderr, "wd_emu_init failed\n");
+            return 1;
+        }
+        if (wd_init_dev(&wd, SLOT_MASK, &wd_dev_emu, &emu)) {
+            fprintf(stderr, "wd_init_dev failed\n");
+            return 1;
+        }
+    } else if (wd_init_pci(&wd, SLOT_MASK)) {
+        fprintf(stderr, "wd_init_pci failed\n");
+        return 1;
+    }
+
+    /* submit from the slot's cores */
+    cpu_set_t cpus;
+    wd_slot_cpus(&wd, SLOT, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+    printf("allocating hugepage on node %d...\n", wd_slot_node(&wd, SLOT));
+    void *hp = alloc_hugepage(use_emu, wd_slot_node(&wd, SLOT));
+
+    /* zero the whole 2 MiB page and push clean data to DRAM */
+    memset(hp, 0, HP_SIZE);
     clflush_hugepage(hp, HP_SIZE);
 
-    /* should be non-zero if DMA was successful */
-    puts("\ndumping non-zero lines in hugepage:");
-    dump_nonzero_lines(hp, HP_SIZE);
+    printf("allocated hugepage address  : 0x%016" PRIx64 "\n", hp);
+
+    puts("initializing verify request...");
+    wd_ed25519_verify_init_req(&wd, 1, DEPTH, hp);
+    wd_ed25519_verify_init_resp(&wd, 1);
+
+    /* until the slot reads its mcache base and mask back */
+    if (wd_ed25519_verify_ready(&wd, 1000000000L))
+        puts("slot did not confirm its vDIP settings, going on anyway");
+
+    struct timespec ts = {0, 5 * 1000 * 2000};   /* 10 ms */
+
+    /* dummy verify request */
+    uint8_t msg[64] = {0}, sig[64] = {0}, pub[32] = {0};
+    uint64_t m_seq = 1;
+
+    puts("sending verify request...");
+    wd_ed25519_verify_req(&wd, msg, sizeof(msg),
+                          sig, pub, m_seq, 0, 0x3, sizeof(msg));
+
+    nanosleep(&ts, NULL);                         /* allow CL to issue AW */
+
+    if (!use_emu)
+        dump_pcim();
+
+    wd_snp_cntrs(&wd, SLOT);
+
+    print_snapshot(&wd);
+
+    /* wait up to a second for the result line */
+    puts("polling for the result...");
+    wd_ed25519_verify_resp_t resp;
+    ulong got = 0;
+    for (int i = 0; i < 1000 && !got; i++) {
+        got = wd_ed25519_verify_poll_resp(&wd, &resp, 1);
+        if (!got) usleep(1000);
+    }
+    if (got) {
+        printf("result seq %" PRIu64 " chunk %u : %s (tsorig %u tspub %u)\n",
+               resp.seq, resp.chunk,
+               resp.res == WD_ED25519_RES_PASS ? "pass" :
+               resp.res == WD_ED25519_RES_FAIL ? "fail" : "lost",
+               resp.tsorig, resp.tspub);
+    } else {
+        /* no result line, show whatever the DMA engine did write */
+        clflush_hugepage(hp, HP_SIZE);
+        puts("\nno result, dumping non-zero lines in hugepage:");
+        dump_nonzero_lines(hp, HP_SIZE);
+    }
 
     wd_free_pci(&wd);
-    munmap(hp, HP_SIZE);
+    if (use_emu)
+        wd_emu_free(&emu);
+    if (hp_heap)
+        free(hp);
+    else
+        wd_hp_free(hp, HP_SIZE);
     return 0;
 }
@@ -0,0 +1,1648 @@
+/* wd_bench.c – submit-path benchmarks for the Wiredancer host library */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/wait.h>
+
+#include "wd_f1.h"
+#include "wd_emu.h"
+#include "wd_tel.h"
+#include "wd_cpu.h"
+#include "wd_cache.h"
+#include "wd_ring.h"
+#include "wd_trace.h"
+#include "wd_rob.h"
+#include "wd_infl.h"
+#include "wd_shm.h"
+#include "wd_evt.h"
+#include "../../ballet/ed25519/fd_ed25519.h"
+
+#define HP_SIZE   (2UL << 20)
+#define DEPTH     (1UL << 16)
+
+/* -------------- setup -------------------------------------------------- */
+
+typedef struct {
+    int        use_emu;
+    int        lat;
+    uint32_t   lat_lg;
+    char const *tel_name;
+    uint32_t   sched;
+    uint64_t   slow;
+    uint32_t   cpu_threads;
+    int64_t    spill_at[2];     /* pend, DMA levels, 0: the limits     */
+    uint64_t   cache_cap;
+    int        core;
+    int        numa;            /* 0: any, 1: local, 2: remote        */
+    char const *record;
+    char const *trace;
+    char const *evt_path;       /* lifecycle event dump                */
+    uint32_t   paced;
+    uint64_t   init_lat[3];     /* attach, vDIP/vLED, register read, ns */
+    uint64_t   ordered;         /* reorder buffer depth, 0: none       */
+    double     drop_pct;        /* emulated result drops               */
+    double     deadline_us;     /* resubmit after, 0: no in-flight table */
+    int        shared;          /* mcache and device shared with forks */
+
+    /* load */
+    char const *dist;
+    uint64_t   sz_min;
+    uint64_t   sz_max;
+    uint32_t   bad_pct;
+    double     rate;
+    double     secs;
+    uint32_t   emu_flags;
+    uint64_t   slots;
+    uint64_t   cnt;
+    uint64_t   sz;
+    uint64_t   batch;
+    uint64_t   producers;
+    uint64_t   depth;
+
+    wd_wksp_t  wd;
+    wd_emu_t   emu;
+    wd_tel_t   tel;
+    wd_cpu_t   cpu;
+    wd_cache_t cache;
+    wd_trace_t rec;
+    wd_evt_t   evt;
+    void      *hp;
+    uint64_t   hp_sz;
+    int        hp_heap;
+    void      *hp_map;          /* shared mapping hp was cut from      */
+} bench_t;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/* --numa: the node the mcache and the bench threads go on, local to the
+   slots or not, -1 to leave both to the kernel */
+static int place(bench_t *b) {
+    if (!b->numa)
+        return -1;
+    int local = wd_wksp_node(&b->wd);
+    if (local < 0) {
+        printf("numa: slots' node unknown, not placing\n");
+        return -1;
+    }
+    int node = local;
+    cpu_set_t cpus;
+    if (b->numa == 2) {
+        for (node = 0; node < 64; node++)
+            if (node != local && wd_node_cpus(node, &cpus) > 0)
+                break;
+        if (node == 64) {
+            fprintf(stderr, "numa: no remote node\n");
+            exit(1);
+        }
+    }
+    wd_node_cpus(node, &cpus);
+    /* threads started from here on inherit the mask */
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    printf("numa: slots on node %d, mcache and threads on node %d (%d cores)\n",
+           local, node, CPU_COUNT(&cpus));
+    return node;
+}
+
+/* mcache region of 2 MiB hugepages on node, ordinary aligned memory
+   will do for the emulator.  Processes forked to share the emulator
+   need the lines the device writes to be shared memory. */
+static void alloc_dma(bench_t *b, int node) {
+    b->hp_sz = (b->depth * sizeof(fd_frag_meta_t) + HP_SIZE - 1) & ~(HP_SIZE - 1);
+    if (b->shared && b->use_emu) {
+        b->hp_map = mmap(NULL, b->hp_sz + HP_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (b->hp_map == MAP_FAILED) { perror("mmap"); exit(1); }
+        b->hp = (void *)(((uintptr_t)b->hp_map + HP_SIZE - 1) & ~(HP_SIZE - 1));
+        return;
+    }
+    b->hp = wd_hp_alloc(b->hp_sz, HP_SIZE, node);
+    if(!b->hp && b->use_emu) {
+        b->hp = aligned_alloc(HP_SIZE, b->hp_sz);
+        b->hp_heap = 1;
+        if (b->hp) memset(b->hp, 0, b->hp_sz);
+    }
+    if(!b->hp) { perror("mmap hugepage"); exit(1); }
+}
+
+static void bench_open(bench_t *b) {
+    if (b->use_emu) {
+        /* measure the host side: the device model only parses, on its
+           own core when there is one to spare */
+        if (wd_emu_init(&b->emu, b->emu_flags)) {
+            fprintf(stderr, "wd_emu_init failed\n");
+            exit(1);
+        }
+        for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++)
+            if (b->slow & (1UL << slot))
+                b->emu.burst[slot] = 8;
+        b->emu.drop_ppm = (uint32_t)(b->drop_pct * 1e4);
+        /* forked members cannot advance the device themselves */
+        if ((sysconf(_SC_NPROCESSORS_ONLN) > 1 || b->shared) && wd_emu_start(&b->emu)) {
+            fprintf(stderr, "wd_emu_init failed\n");
+            exit(1);
+        }
+        if (wd_init_dev(&b->wd, b->slots, &wd_dev_emu, &b->emu)) {
+            fprintf(stderr, "wd_init_dev failed\n");
+            exit(1);
+        }
+    } else if (wd_init_pci(&b->wd, b->slots)) {
+        fprintf(stderr, "wd_init_pci failed\n");
+        exit(1);
+    }
+    alloc_dma(b, place(b));
+    if (wd_dma_map(&b->wd, b->hp, b->hp_sz, HP_SIZE)) {
+        fprintf(stderr, "wd_dma_map failed\n");
+        exit(1);
+    }
+    wd_ed25519_verify_init_req(&b->wd, 1, b->depth, b->hp);
+    wd_ed25519_verify_init_resp(&b->wd, 1);
+    wd_sub_sched(&b->wd.sub, b->sched);
+    if (b->lat && wd_lat_init(&b->wd, b->lat_lg)) {
+        fprintf(stderr, "wd_lat_init failed\n");
+        exit(1);
+    }
+    if (b->tel_name &&
+        (wd_tel_init(&b->tel, &b->wd, b->tel_name, 100000000UL) || wd_tel_start(&b->tel))) {
+        fprintf(stderr, "wd_tel_init failed\n");
+        exit(1);
+    }
+    if (b->record) {
+        if (wd_trace_open(&b->rec, b->record, 1UL << 22)) {
+            perror(b->record);
+            exit(1);
+        }
+        wd_trace_start(&b->rec, &b->wd);
+    }
+    if (b->evt_path) {
+        if (wd_evt_init(&b->evt, 1UL << 18)) {
+            fprintf(stderr, "wd_evt_init failed\n");
+            exit(1);
+        }
+        wd_ed25519_verify_evt(&b->wd, &b->evt);
+    }
+}
+
+static void bench_close(bench_t *b) {
+    if (b->evt_path) {
+        wd_ed25519_verify_evt(&b->wd, NULL);
+        if (wd_evt_dump(&b->evt, b->evt_path))
+            perror(b->evt_path);
+        else
+            printf("evt: %u threads to %s (wd_evt2json %s > trace.json)\n",
+                   b->evt.n_ring, b->evt_path, b->evt_path);
+        wd_evt_free(&b->evt);
+    }
+    if (b->record) {
+        wd_trace_stop(&b->rec, &b->wd);
+        printf("record: %lu beats to %s, %lu dropped\n",
+               (unsigned long)(b->rec.n_rec < b->rec.cap ? b->rec.n_rec : b->rec.cap),
+               b->record, (unsigned long)b->rec.n_drop);
+        wd_trace_close(&b->rec);
+    }
+    if (b->tel_name)
+        wd_tel_free(&b->tel);
+    wd_lat_fini(&b->wd);
+    wd_free_pci(&b->wd);
+    if (b->use_emu)
+        wd_emu_free(&b->emu);
+    if (b->hp_map)
+        munmap(b->hp_map, b->hp_sz + HP_SIZE);
+    else if (b->hp_heap)
+        free(b->hp);
+    else
+        wd_hp_free(b->hp, b->hp_sz);
+}
+
+/* bytes one request occupies on the BAR4 stream */
+static uint64_t req_bytes(uint64_t sz) {
+    uint64_t nb = (sz + 31) >> 5;
+    return (4 + nb + (nb & 1)) << 5;
+}
+
+static void report(char const *name, uint64_t cnt, uint64_t bytes, double dt) {
+    printf("  %-10s : %10.3f Mmsg/s  %8.3f GB/s  (%lu msgs in %.3f s)\n",
+           name, (double)cnt / dt * 1e-6, (double)bytes / dt * 1e-9,
+           (unsigned long)cnt, dt);
+}
+
+/* fill register reads, credit stalls and waits since the handle
+   counters were last cleared */
+static void report_credit(wd_sub_t *sub, uint64_t cnt) {
+    printf("  %-10s   %10lu fill reads (1 per %.1f msgs), %lu stalls\n", "",
+           (unsigned long)sub->n_mmio,
+           sub->n_mmio ? (double)cnt / (double)sub->n_mmio : 0.,
+           (unsigned long)sub->n_stall);
+    if (sub->n_wait || sub->n_timeout)
+        printf("  %-10s   %10lu waits (avg %.1f us), %lu timeouts\n", "",
+               (unsigned long)sub->n_wait,
+               sub->n_wait ? (double)sub->wait_ns * 1e-3 / (double)sub->n_wait : 0.,
+               (unsigned long)sub->n_timeout);
+    sub->n_mmio = sub->n_stall = 0;
+    sub->n_wait = sub->n_timeout = sub->wait_ns = 0;
+}
+
+/* where a handle's requests went, per slot */
+static void report_slots(wd_sub_t *sub) {
+    if (!(sub->slots & (sub->slots - 1)))
+        return;
+    uint64_t tot = 0;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++)
+        tot += sub->cr[slot].n_beat;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++) {
+        wd_credit_t const *cr = &sub->cr[slot];
+        if (!(sub->slots & (1UL << slot)))
+            continue;
+        printf("  slot %u     : %10lu msgs %10.3f MB  %5.1f%%\n", slot,
+               (unsigned long)cr->n_req, (double)cr->n_beat * 32e-6,
+               tot ? 100. * (double)cr->n_beat / (double)tot : 0.);
+    }
+}
+
+/* -------------- batch -------------------------------------------------- */
+
+/* per-call wd_ed25519_verify_req loop vs wd_ed25519_verify_req_batch on
+   the same request set */
+static void bench_batch(bench_t *b) {
+    uint64_t n  = b->batch;
+    uint8_t *buf = aligned_alloc(64, n * (b->sz + 64 + 32) + 64);
+    for (uint64_t i = 0; i < n * (b->sz + 96); i++) buf[i] = (uint8_t)rand();
+
+    void const **msg = malloc(n * sizeof(void*));
+    void const **sig = malloc(n * sizeof(void*));
+    void const **pub = malloc(n * sizeof(void*));
+    ulong       *sz  = malloc(n * sizeof(ulong));
+    uint64_t    *seq = malloc(n * sizeof(uint64_t));
+    uint32_t    *chk = malloc(n * sizeof(uint32_t));
+    uint16_t    *ctl = malloc(n * sizeof(uint16_t));
+    uint16_t    *msz = malloc(n * sizeof(uint16_t));
+    for (uint64_t i = 0; i < n; i++) {
+        uint8_t *p = buf + i * (b->sz + 96);
+        sig[i] = p;
+        pub[i] = p + 64;
+        msg[i] = p + 96;
+        sz [i] = b->sz;
+        chk[i] = (uint32_t)i;
+        ctl[i] = 0x3;
+        msz[i] = (uint16_t)b->sz;
+    }
+
+    uint64_t rounds = (b->cnt + n - 1) / n;
+    uint64_t total  = rounds * n;
+    uint64_t bytes  = total * req_bytes(b->sz);
+    uint64_t m_seq  = 1;
+
+    printf("batch: %lu msgs of %lu B, batch %lu, %s\n",
+           (unsigned long)total, (unsigned long)b->sz, (unsigned long)n,
+           b->use_emu ? "emu" : "f1");
+
+    b->wd.sub.n_mmio = b->wd.sub.n_stall = 0;
+    double t0 = now_s();
+    for (uint64_t r = 0; r < rounds; r++)
+        for (uint64_t i = 0; i < n; i++, m_seq++)
+            while (wd_ed25519_verify_req(&b->wd, msg[i], sz[i], sig[i], pub[i],
+                                         m_seq, chk[i], ctl[i], msz[i]))
+                ;
+    report("per-call", total, bytes, now_s() - t0);
+    report_credit(&b->wd.sub, total);
+
+    t0 = now_s();
+    for (uint64_t r = 0; r < rounds; r++) {
+        for (uint64_t i = 0; i < n; i++) seq[i] = m_seq++;
+        uint64_t done = 0;
+        while (done < n)
+            done += wd_ed25519_verify_req_batch(&b->wd, msg + done, sz + done,
+                                                sig + done, pub + done, seq + done,
+                                                chk + done, ctl + done, msz + done,
+                                                n - done);
+    }
+    report("batch", total, bytes, now_s() - t0);
+    report_credit(&b->wd.sub, total);
+
+    free(msg); free(sig); free(pub); free(sz);
+    free(seq); free(chk); free(ctl); free(msz);
+    free(buf);
+}
+
+/* -------------- encode ------------------------------------------------- */
+
+/* the request encoder as it was before zero-staging: every beat is
+   copied into an aligned staging buffer and loaded back from it */
+static void staged_stream(wd_pci_t *pci, wd_pci_st_t *st, uint32_t const *stage) {
+    pci->dev->write_256(pci, st->a | st->b, _mm256_load_si256((__m256i const *)stage));
+    st->a += 32;
+    if (st->a == st->m) {
+        pci->dev->flush(pci, 0);
+        st->a = 0;
+    } else if ((st->a & 0xFC0) == 0xFC0) {
+        pci->dev->flush(pci, 0);
+    }
+}
+
+static void staged_req(wd_wksp_t *wd, uint32_t *stage, void const *msg, ulong sz,
+                       void const *sig, void const *pub, uint64_t m_seq) {
+    wd_pci_t    *pci = &wd->pci[wd->sub.req_slot];
+    wd_pci_st_t *st  = &wd->sub.st[wd->sub.req_slot];
+    uint64_t dma_addr = fd_mcache_line_idx(m_seq, wd->sv.req_depth) << 5;
+    stage[0] = WD_PCI_MAGIC;
+    stage[1] = ((uint32_t)sz + 32 + 32) << 16;
+    stage[2] = (uint32_t)sz | (0x3U << 16);
+    stage[3] = (uint32_t)dma_addr;
+    stage[4] = (uint32_t)(dma_addr >> 32);
+    stage[5] = (uint32_t)m_seq;
+    stage[6] = (uint32_t)(m_seq >> 32);
+    stage[7] = 0;
+    staged_stream(pci, st, stage);
+    memcpy(stage, (uint8_t const *)sig,      32); staged_stream(pci, st, stage);
+    memcpy(stage, (uint8_t const *)sig + 32, 32); staged_stream(pci, st, stage);
+    memcpy(stage, pub,                       32); staged_stream(pci, st, stage);
+    ulong i;
+    for (i = 0; i < sz; i += 32) {
+        memcpy(stage, (uint8_t const *)msg + i, 32);
+        staged_stream(pci, st, stage);
+    }
+    if ((i / 32) & 1)
+        staged_stream(pci, st, stage);
+    pci->dev->flush(pci, 0);
+}
+
+/* rdtsc cycles per request of the staged encoder, the generic
+   zero-staging one and the size-specialized kernels in
+   wd_ed25519_verify_req, against a device that discards the stream.
+   Each pass starts with credit for all its requests on every slot, so
+   wd_ed25519_verify_req never reads the fill register inside the timed
+   loop and the columns compare encoding alone, as the staged path does
+   no flow control.  The sizes are the common transaction sizes. */
+static void bench_encode(bench_t *b) {
+    static ulong const szs[] = { 0, 31, 64, 100, 176, 200, 256, 400, 512, 700, 1000, 1232 };
+    uint8_t *buf = aligned_alloc(64, 4096);
+    for (ulong i = 0; i < 4096; i++) buf[i] = (uint8_t)rand();
+    uint32_t *stage = aligned_alloc(32, 32);
+
+    /* odd offsets: callers' buffers are not aligned */
+    uint8_t const *sig = buf + 1;
+    uint8_t const *pub = buf + 67;
+    uint8_t const *msg = buf + 101;
+
+    printf("encode: cycles/request, %lu requests per size, %s\n",
+           (unsigned long)b->cnt, b->use_emu ? "emu sink" : "f1");
+    printf("  %6s %10s %10s %10s\n", "sz", "staged", "generic", "sized");
+
+    uint64_t m_seq = 1;
+    for (ulong k = 0; k < sizeof(szs)/sizeof(szs[0]); k++) {
+        ulong sz = szs[k];
+        double cyc[3];
+        for (int pass = 0; pass < 3; pass++) {
+            wd_sub_encoder(&b->wd.sub, pass == 2 ? WD_ENC_SIZED : WD_ENC_GENERIC);
+            for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++)
+                if (b->wd.sub.slots & (1UL << slot))
+                    b->wd.sub.cr[slot].avail = (int64_t)b->cnt;
+            uint64_t t0 = __rdtsc();
+            for (uint64_t i = 0; i < b->cnt; i++, m_seq++) {
+                if (pass == 0)
+                    staged_req(&b->wd, stage, msg, sz, sig, pub, m_seq);
+                else
+                    wd_ed25519_verify_req(&b->wd, msg, sz, sig, pub, m_seq, 0, 0x3, (uint16_t)sz);
+            }
+            cyc[pass] = (double)(__rdtsc() - t0) / (double)b->cnt;
+        }
+        printf("  %6lu %10.1f %10.1f %10.1f\n", sz, cyc[0], cyc[1], cyc[2]);
+    }
+    wd_sub_encoder(&b->wd.sub, WD_ENC_SIZED);
+
+    free(stage);
+    free(buf);
+}
+
+/* -------------- mp ----------------------------------------------------- */
+
+typedef struct {
+    bench_t          *b;
+    wd_sub_t          sub;
+    uint32_t          idx;
+    uint32_t          n;
+    uint64_t          cnt;
+    pthread_barrier_t *go;
+    double            t1;
+} mp_arg_t;
+
+static void *mp_main(void *_arg) {
+    mp_arg_t *a = (mp_arg_t *)_arg;
+    uint64_t  sz = a->b->sz;
+    uint8_t  *buf = aligned_alloc(64, sz + 96 + 64);
+    memset(buf, a->idx, sz + 96);
+
+    pthread_barrier_wait(a->go);
+    /* producer idx sends every n-th sequence number */
+    for (uint64_t i = 0; i < a->cnt; i++) {
+        uint64_t m_seq = 1 + a->idx + i * a->n;
+        while (wd_ed25519_verify_req_sub(&a->sub, buf + 96, sz, buf, buf + 64,
+                                         m_seq, 0, 0x3, (uint16_t)sz))
+            ;
+    }
+    a->t1 = now_s();
+
+    free(buf);
+    return NULL;
+}
+
+/* aggregate submit rate of 1, 2, 4, ... producer threads, each on its
+   own submit handle (stream 1+i) over all slots in the mask */
+static void bench_mp(bench_t *b) {
+    printf("mp: %lu msgs of %lu B per run, %s\n",
+           (unsigned long)b->cnt, (unsigned long)b->sz,
+           b->use_emu ? "emu sink" : "f1");
+
+    for (uint32_t n = 1; n <= b->producers && n < WD_N_PCI_STREAMS; n <<= 1) {
+        mp_arg_t *arg = aligned_alloc(64, n * sizeof(mp_arg_t));
+        pthread_t *tid = malloc(n * sizeof(pthread_t));
+        pthread_barrier_t go;
+        pthread_barrier_init(&go, NULL, n + 1);
+
+        for (uint32_t i = 0; i < n; i++) {
+            memset(&arg[i], 0, sizeof(mp_arg_t));
+            arg[i].b   = b;
+            arg[i].idx = i;
+            arg[i].n   = n;
+            arg[i].cnt = b->cnt / n;
+            arg[i].go  = &go;
+            if (wd_sub_init(&arg[i].sub, &b->wd, 1 + i, b->slots)) {
+                fprintf(stderr, "wd_sub_init failed\n");
+                exit(1);
+            }
+            wd_sub_sched(&arg[i].sub, b->sched);
+            pthread_create(&tid[i], NULL, mp_main, &arg[i]);
+        }
+
+        pthread_barrier_wait(&go);
+        double t0 = now_s(), t1 = t0;
+        wd_sub_t sum = { 0 };
+        for (uint32_t i = 0; i < n; i++) {
+            pthread_join(tid[i], NULL);
+            if (arg[i].t1 > t1) t1 = arg[i].t1;
+            sum.n_mmio  += arg[i].sub.n_mmio;
+            sum.n_stall += arg[i].sub.n_stall;
+            sum.n_wait  += arg[i].sub.n_wait;
+            sum.wait_ns += arg[i].sub.wait_ns;
+            sum.n_timeout += arg[i].sub.n_timeout;
+            wd_sub_fini(&arg[i].sub);
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u prod", n);
+        uint64_t total = (b->cnt / n) * n;
+        report(name, total, total * req_bytes(b->sz), t1 - t0);
+        report_credit(&sum, total);
+
+        pthread_barrier_destroy(&go);
+        free(tid);
+        free(arg);
+    }
+}
+
+/* -------------- ring --------------------------------------------------- */
+
+typedef struct {
+    bench_t          *b;
+    wd_ring_t        *ring;
+    uint32_t          idx;
+    uint32_t          n;
+    uint64_t          cnt;
+    uint64_t          n_full;
+    pthread_barrier_t *go;
+} ring_arg_t;
+
+static void *ring_main(void *_arg) {
+    ring_arg_t *a = (ring_arg_t *)_arg;
+    uint64_t  sz = a->b->sz;
+    uint8_t  *buf = aligned_alloc(64, sz + 96 + 64);
+    memset(buf, a->idx, sz + 96);
+
+    pthread_barrier_wait(a->go);
+    /* producer idx queues every n-th sequence number; the buffer is
+       never written again, so it may be shared by all its requests */
+    for (uint64_t i = 0; i < a->cnt; i++) {
+        uint64_t m_seq = 1 + a->idx + i * a->n;
+        for (uint32_t spin = 0;
+             wd_ring_req(a->ring, buf + 96, sz, buf, buf + 64, m_seq, 0, 0x3, (uint16_t)sz);
+             spin++) {
+            a->n_full++;
+            if (spin < 64) _mm_pause();
+            else           sched_yield();
+        }
+    }
+    /* the buffer has to outlive the submitter's use of it */
+    while (wd_ring_sent(a->ring) < a->b->cnt / a->n * a->n)
+        sched_yield();
+
+    free(buf);
+    return NULL;
+}
+
+/* aggregate submit rate of 1, 2, 4, ... producer threads feeding the
+   workspace handle through one submission ring and submitter thread */
+static void bench_ring(bench_t *b) {
+    printf("ring: %lu msgs of %lu B per run, submitter on %s core, %s\n",
+           (unsigned long)b->cnt, (unsigned long)b->sz,
+           b->core < 0 ? "any" : "one",
+           b->use_emu ? "emu sink" : "f1");
+
+    for (uint32_t n = 1; n <= b->producers; n <<= 1) {
+        wd_ring_t ring;
+        if (wd_ring_init(&ring, &b->wd.sub, 1UL << 12) || wd_ring_start(&ring, b->core)) {
+            fprintf(stderr, "wd_ring_init failed\n");
+            exit(1);
+        }
+        ring_arg_t *arg = aligned_alloc(64, n * sizeof(ring_arg_t));
+        pthread_t *tid = malloc(n * sizeof(pthread_t));
+        pthread_barrier_t go;
+        pthread_barrier_init(&go, NULL, n + 1);
+
+        uint64_t total = (b->cnt / n) * n;
+        for (uint32_t i = 0; i < n; i++) {
+            memset(&arg[i], 0, sizeof(ring_arg_t));
+            arg[i].b    = b;
+            arg[i].ring = &ring;
+            arg[i].idx  = i;
+            arg[i].n    = n;
+            arg[i].cnt  = b->cnt / n;
+            arg[i].go   = &go;
+            pthread_create(&tid[i], NULL, ring_main, &arg[i]);
+        }
+
+        pthread_barrier_wait(&go);
+        double t0 = now_s();
+        while (wd_ring_sent(&ring) < total)
+            sched_yield();
+        double t1 = now_s();
+        uint64_t n_full = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            pthread_join(tid[i], NULL);
+            n_full += arg[i].n_full;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u prod", n);
+        report(name, total, total * req_bytes(b->sz), t1 - t0);
+        printf("  %-10s   %10.1f msgs per burst, %lu ring full\n", "",
+               ring.n_burst ? (double)total / (double)ring.n_burst : 0.,
+               (unsigned long)n_full);
+        report_credit(&b->wd.sub, total);
+
+        wd_ring_free(&ring);
+        pthread_barrier_destroy(&go);
+        free(tid);
+        free(arg);
+    }
+}
+
+/* -------------- resp --------------------------------------------------- */
+
+/* latency quantiles per phase, all slots and size classes merged */
+static void report_lat(wd_wksp_t *wd) {
+    static char const *phase[WD_LAT_N_PHASE] = { "queue", "pcie", "pipe", "dma", "total" };
+    printf("  %-10s   %10s %10s %10s %10s  (us)\n", "latency", "p50", "p99", "p99.9", "max");
+    for (uint32_t p = 0; p < WD_LAT_N_PHASE; p++) {
+        wd_lat_hist_t h;
+        memset(&h, 0, sizeof(h));
+        for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++)
+            for (uint32_t c = 0; c < WD_LAT_N_SZ; c++)
+                wd_lat_merge(&h, &wd->lat->hist[slot][c][p]);
+        if (!h.cnt)
+            continue;
+        printf("  %-10s   %10.2f %10.2f %10.2f %10.2f\n", phase[p],
+               wd_lat_ns(wd, wd_lat_quantile(&h, 0.5))   * 1e-3,
+               wd_lat_ns(wd, wd_lat_quantile(&h, 0.99))  * 1e-3,
+               wd_lat_ns(wd, wd_lat_quantile(&h, 0.999)) * 1e-3,
+               wd_lat_ns(wd, h.max) * 1e-3);
+    }
+}
+
+/* completions of one resp run; with a reorder buffer, next is the
+   m_seq the next one must have */
+typedef struct {
+    wd_rob_t  *rob;
+    uint64_t   done;
+    uint64_t   pass;
+    uint64_t   next;
+    uint64_t   n_order;
+} resp_t;
+
+static ulong resp_poll(bench_t *b, resp_t *r) {
+    wd_ed25519_verify_resp_t resp[64];
+    ulong n = r->rob ? wd_rob_poll(r->rob, resp, 64)
+                     : wd_ed25519_verify_poll_resp(&b->wd, resp, 64);
+    for (ulong i = 0; i < n; i++) {
+        r->pass += resp[i].res == WD_ED25519_RES_PASS;
+        if (r->rob)
+            r->n_order += resp[i].seq != r->next++;
+    }
+    r->done += n;
+    return n;
+}
+
+/* a quantile's bucket bound, no more than the largest value seen */
+static uint64_t quantile(wd_lat_hist_t const *h, double q) {
+    uint64_t v = wd_lat_quantile(h, q);
+    return v < h->max ? v : h->max;
+}
+
+/* reorder buffer depth and head-of-line stalls */
+static void report_rob(wd_wksp_t *wd, resp_t const *r) {
+    wd_rob_t const *rob = r->rob;
+    printf("  %-10s   %10lu out of order, %lu submits held back, %lu past the ring\n",
+           "ordered", (unsigned long)r->n_order, (unsigned long)rob->n_full,
+           (unsigned long)rob->n_over);
+    printf("  %-10s   %10s %10s %10s %10s\n", "", "p50", "p99", "p99.9", "max");
+    printf("  %-10s   %10lu %10lu %10lu %10lu  (entries past head)\n", "depth",
+           (unsigned long)quantile(&rob->depth_hist, 0.5),
+           (unsigned long)quantile(&rob->depth_hist, 0.99),
+           (unsigned long)quantile(&rob->depth_hist, 0.999),
+           (unsigned long)rob->depth_hist.max);
+    if (rob->hol_hist.cnt)
+        printf("  %-10s   %10.2f %10.2f %10.2f %10.2f  (us, %lu stalls)\n", "hol",
+               wd_lat_ns(wd, quantile(&rob->hol_hist, 0.5))   * 1e-3,
+               wd_lat_ns(wd, quantile(&rob->hol_hist, 0.99))  * 1e-3,
+               wd_lat_ns(wd, quantile(&rob->hol_hist, 0.999)) * 1e-3,
+               wd_lat_ns(wd, rob->hol_hist.max) * 1e-3,
+               (unsigned long)rob->hol_hist.cnt);
+}
+
+/* what the in-flight table saw */
+static void report_infl(wd_infl_t const *infl) {
+    printf("  %-10s   %10lu expired, %lu resubmitted, %lu recovered, %lu given up\n",
+           "inflight", (unsigned long)infl->n_expire, (unsigned long)infl->n_retry,
+           (unsigned long)infl->n_recover, (unsigned long)infl->n_give_up);
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++)
+        if (infl->n_expire_slot[slot])
+            printf("  %-10s   %10lu expired on slot %u\n", "",
+                   (unsigned long)infl->n_expire_slot[slot], slot);
+}
+
+/* end-to-end: submit and drain completions from the mcache on one
+   thread, counting a message when its result line has been read.  With
+   --ordered they are drained through a reorder buffer and must come
+   out in m_seq order; the submit loop then polls whenever the buffer
+   holds it back, as it cannot wait on itself.  With --deadline an
+   in-flight table resubmits the requests --drop lost on stream 1;
+   without one the run ends once nothing has completed for a second.
+   Returns 1 if a request never completed (but to --drop without
+   --deadline), with --ordered if one came out of order, and with
+   --deadline if one was lost or given up on. */
+static int bench_resp(bench_t *b) {
+    uint8_t *buf = aligned_alloc(64, b->sz + 96 + 64);
+    memset(buf, 0, b->sz + 96);
+    resp_t r = { .next = 1 };
+    wd_rob_t rob;
+    wd_sub_t rsub;
+    wd_infl_t infl;
+    int inline_dev = b->use_emu && !b->emu.running;
+
+    printf("resp: %lu msgs of %lu B, %s%s\n",
+           (unsigned long)b->cnt, (unsigned long)b->sz,
+           b->use_emu ? "emu" : "f1",
+           b->emu_flags & WD_EMU_SHUFFLE ? ", shuffled" : "");
+    if (b->ordered) {
+        if (wd_rob_init(&rob, b->ordered)) {
+            fprintf(stderr, "wd_rob_init failed\n");
+            exit(1);
+        }
+        wd_ed25519_verify_rob(&b->wd, &rob);
+        r.rob = &rob;
+    }
+    if (b->deadline_us > 0) {
+        if (wd_sub_init(&rsub, &b->wd, 1, b->slots) ||
+            wd_infl_init(&infl, &rsub, b->depth, (int64_t)(b->deadline_us * 1e3), 3)) {
+            fprintf(stderr, "wd_infl_init failed\n");
+            exit(1);
+        }
+        wd_ed25519_verify_inflight(&b->wd, &infl);
+    }
+
+    double t0 = now_s();
+    for (uint64_t m_seq = 1; m_seq <= b->cnt; m_seq++) {
+        if (r.rob) {
+            while (wd_ed25519_verify_try_req(&b->wd, buf + 96, b->sz, buf, buf + 64,
+                                             m_seq, 0, 0x3, (uint16_t)b->sz)) {
+                if (inline_dev)
+                    wd_emu_poll(&b->emu);
+                resp_poll(b, &r);
+            }
+        } else {
+            while (wd_ed25519_verify_req(&b->wd, buf + 96, b->sz, buf, buf + 64,
+                                         m_seq, 0, 0x3, (uint16_t)b->sz))
+                ;
+        }
+        if (!(m_seq & 63))
+            resp_poll(b, &r);
+    }
+    double t_last = now_s();
+    while (r.done < b->cnt) {
+        if (inline_dev)
+            wd_emu_poll(&b->emu);
+        if (resp_poll(b, &r))
+            t_last = now_s();
+        else if (now_s() - t_last > 1.0)
+            break;
+    }
+    report("verified", r.done, r.done * req_bytes(b->sz), now_s() - t0);
+    if (r.done < b->cnt)
+        printf("  %-10s   %10lu never completed\n", "", (unsigned long)(b->cnt - r.done));
+    printf("  %-10s   %10lu pass, %lu lost\n", "",
+           (unsigned long)r.pass, (unsigned long)b->wd.sv.n_lost);
+    report_credit(&b->wd.sub, r.done);
+    int rc = r.done < b->cnt && !(b->drop_pct > 0 && b->deadline_us <= 0);
+    if (b->deadline_us > 0) {
+        report_infl(&infl);
+        rc |= b->wd.sv.n_lost || infl.n_give_up;
+        wd_ed25519_verify_inflight(&b->wd, NULL);
+        wd_infl_free(&infl);
+        wd_sub_fini(&rsub);
+    }
+    if (r.rob) {
+        report_rob(&b->wd, &r);
+        rc |= r.n_order || rob.n_over;
+        wd_ed25519_verify_rob(&b->wd, NULL);
+        wd_rob_free(&rob);
+    }
+    if (b->wd.lat)
+        report_lat(&b->wd);
+
+    free(buf);
+    if (rc)
+        printf("resp: FAILED\n");
+    return rc;
+}
+
+/* -------------- proc --------------------------------------------------- */
+
+typedef struct {
+    uint64_t   done;
+    uint64_t   pass;
+    uint64_t   lost;
+    uint64_t   n_wait;
+    uint64_t   n_full;
+    double     t1;
+    int        ok;
+} proc_res_t;
+
+/* shared with the members */
+typedef struct {
+    uint32_t   ready;
+    uint32_t   go;
+    double     t0;
+    proc_res_t res[WD_N_PCI_STREAMS];
+} proc_ctl_t;
+
+static void proc_poll(wd_shm_mbr_t *m, proc_res_t *r) {
+    wd_ed25519_verify_resp_t resp[64];
+    ulong n = wd_shm_poll(m, resp, 64);
+    for (ulong i = 0; i < n; i++)
+        r->pass += resp[i].res == WD_ED25519_RES_PASS;
+    r->done += n;
+}
+
+/* one member process: join, submit cnt requests on its own stream and
+   poll its own results */
+static void proc_main(bench_t *b, char const *name, proc_ctl_t *ctl, uint32_t idx, uint64_t cnt) {
+    proc_res_t *r = &ctl->res[idx];
+    wd_shm_mbr_t m;
+    if (wd_shm_join(&m, wd_shm_open(name), &b->wd, (fd_frag_meta_t *)b->hp)) {
+        fprintf(stderr, "proc %u: wd_shm_join failed\n", idx);
+        _exit(1);
+    }
+    wd_sub_sched(&m.sub, b->sched);
+    uint8_t *buf = aligned_alloc(64, b->sz + 96 + 64);
+    memset(buf, idx, b->sz + 96);
+
+    __atomic_add_fetch(&ctl->ready, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&ctl->go, __ATOMIC_ACQUIRE))
+        _mm_pause();
+
+    for (uint64_t i = 0; i < cnt; i++) {
+        uint64_t m_seq;
+        while (wd_shm_req(&m, buf + 96, b->sz, buf, buf + 64, 0, 0x3, (uint16_t)b->sz, &m_seq))
+            proc_poll(&m, r);
+        if (!(i & 63))
+            proc_poll(&m, r);
+    }
+    double t_last = now_s();
+    while (r->done < cnt) {
+        uint64_t done = r->done;
+        proc_poll(&m, r);
+        if (r->done != done)
+            t_last = now_s();
+        else if (now_s() - t_last > 1.0)
+            break;
+    }
+    r->t1     = now_s();
+    r->lost   = m.n_lost;
+    r->n_wait = m.sub.n_wait;
+    r->n_full = m.n_full;
+    r->ok     = 1;
+    wd_shm_leave(&m);
+    /* the device and the mcache stay with the parent */
+    _exit(0);
+}
+
+/* aggregate end-to-end rate of 1, 2, 4, ... member processes sharing
+   the slots through a wd_shm_t, each submitting on a stream of its own
+   and polling its own results from the common mcache, against the one
+   member run */
+static void bench_proc(bench_t *b) {
+    char name[32];
+    snprintf(name, sizeof(name), "wd_bench_%d", (int)getpid());
+    wd_shm_t *shm = wd_shm_create(name, &b->wd, 1000000000L);
+    proc_ctl_t *ctl = mmap(NULL, sizeof(proc_ctl_t), PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (!shm || ctl == MAP_FAILED) {
+        fprintf(stderr, "wd_shm_create failed\n");
+        exit(1);
+    }
+    printf("proc: %lu msgs of %lu B per run, emu\n",
+           (unsigned long)b->cnt, (unsigned long)b->sz);
+
+    double rate1 = 0;
+    for (uint32_t n = 1; n <= b->producers && n < WD_N_PCI_STREAMS; n <<= 1) {
+        memset(ctl, 0, sizeof(proc_ctl_t));
+        pid_t *pid = malloc(n * sizeof(pid_t));
+        for (uint32_t i = 0; i < n; i++) {
+            fflush(stdout);
+            pid[i] = fork();
+            if (pid[i] < 0) { perror("fork"); exit(1); }
+            if (!pid[i])
+                proc_main(b, name, ctl, i, b->cnt / n);
+        }
+        while (__atomic_load_n(&ctl->ready, __ATOMIC_ACQUIRE) < n)
+            usleep(100);
+        double t0 = now_s(), t1 = t0;
+        __atomic_store_n(&ctl->go, 1, __ATOMIC_RELEASE);
+
+        proc_res_t sum = { 0 };
+        int failed = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            int status;
+            waitpid(pid[i], &status, 0);
+            proc_res_t const *r = &ctl->res[i];
+            failed |= !WIFEXITED(status) || WEXITSTATUS(status) || !r->ok;
+            if (r->t1 > t1) t1 = r->t1;
+            sum.done   += r->done;
+            sum.pass   += r->pass;
+            sum.lost   += r->lost;
+            sum.n_wait += r->n_wait;
+            sum.n_full += r->n_full;
+        }
+        if (failed) {
+            fprintf(stderr, "proc: a member failed\n");
+            exit(1);
+        }
+
+        char label[32];
+        snprintf(label, sizeof(label), "%u proc", n);
+        report(label, sum.done, sum.done * req_bytes(b->sz), t1 - t0);
+        double rate = (double)sum.done / (t1 - t0);
+        if (n == 1)
+            rate1 = rate;
+        printf("  %-10s   %10lu pass, %lu lost, %lu never completed, %.2fx one process\n", "",
+               (unsigned long)sum.pass, (unsigned long)sum.lost,
+               (unsigned long)((b->cnt / n) * n - sum.done), rate / rate1);
+        printf("  %-10s   %10lu credit waits, %lu window full\n", "",
+               (unsigned long)sum.n_wait, (unsigned long)sum.n_full);
+        free(pid);
+    }
+
+    munmap(ctl, sizeof(proc_ctl_t));
+    wd_shm_close(shm);
+    wd_shm_unlink(name);
+}
+
+/* -------------- scan --------------------------------------------------- */
+
+/* write the next lap of result lines, as the device would */
+static void scan_fill(wd_ed25519_verify_t *sv) {
+    for (uint64_t i = 0; i < sv->req_depth; i++) {
+        uint64_t seq = sv->resp_seq + i;
+        fd_frag_meta_t *m = sv->mcache + fd_mcache_line_idx(seq, sv->req_depth);
+        m->sig    = WD_ED25519_RES_PASS;
+        m->chunk  = (uint32_t)i;
+        m->tsorig = m->tspub = (uint32_t)i;
+        m->seq    = seq;
+    }
+}
+
+/* the smoke test's way: flush the whole region, then look at every line */
+static uint64_t scan_page(void const *base, uint64_t bytes) {
+    uint8_t const *p = (uint8_t const *)base;
+    uint64_t n = 0;
+    for (uint64_t off = 0; off < bytes; off += 64)
+        _mm_clflush(p + off);
+    _mm_mfence();
+    for (uint64_t off = 0; off < bytes; off += 32) {
+        __m256i v = _mm256_load_si256((__m256i const *)(p + off));
+        n += !_mm256_testz_si256(v, v);
+    }
+    return n;
+}
+
+/* lines/ns reading full laps of the result ring: full-page flush and
+   scan, wd_ed25519_verify_poll_resp, and the watermark scanner with and
+   without per-line flushes */
+static void bench_scan(bench_t *b) {
+    wd_ed25519_verify_t *sv = &b->wd.sv;
+    uint64_t depth = sv->req_depth;
+    uint64_t laps  = b->cnt / depth ? b->cnt / depth : 1;
+    wd_ed25519_verify_resp_t resp[64];
+
+    printf("scan: %lu laps of %lu lines\n", (unsigned long)laps, (unsigned long)depth);
+    for (int m = 0; m < 4; m++) {
+        static char const *name[4] = { "full page", "poll_resp", "scan", "scan+flush" };
+        sv->resp_flush = m == 3;
+        double dt = 0.;
+        uint64_t lines = 0;
+        for (uint64_t lap = 0; lap < laps; lap++) {
+            scan_fill(sv);
+            double t0 = now_s();
+            uint64_t n = 0;
+            if (m == 0)
+                n = scan_page(sv->mcache, depth * sizeof(fd_frag_meta_t));
+            else if (m == 1)
+                for (ulong k; (k = wd_ed25519_verify_poll_resp(&b->wd, resp, 64)); )
+                    n += k;
+            else
+                for (ulong k; (k = wd_ed25519_verify_scan(&b->wd, 256)); n += k)
+                    wd_ed25519_verify_scan_done(&b->wd, k);
+            dt += now_s() - t0;
+            lines += n;
+            if (m == 0)
+                wd_ed25519_verify_scan_done(&b->wd, depth);
+        }
+        printf("  %-10s : %10.3f lines/ns  %8.2f ns/line  (%lu lines in %.3f s)\n",
+               name[m], (double)lines / (dt * 1e9), dt * 1e9 / (double)lines,
+               (unsigned long)lines, dt);
+    }
+    sv->resp_flush = 0;
+}
+
+/* -------------- replay ------------------------------------------------- */
+
+/* send the requests of a --record'ed trace again, as fast as the slots
+   take them or (--paced) at the recorded rate, and drain the results */
+static void bench_replay(bench_t *b) {
+    wd_trace_t tr;
+    if (!b->trace || wd_trace_load(&tr, b->trace)) {
+        fprintf(stderr, "replay: no trace (--trace=FILE)\n");
+        exit(1);
+    }
+    printf("replay: %lu beats from %s, %s, %s\n",
+           (unsigned long)tr.n_rec, b->trace, b->paced ? "paced" : "max speed",
+           b->use_emu ? "emu" : "f1");
+
+    wd_ed25519_verify_init_resp(&b->wd, wd_trace_first_seq(&tr));
+    int inline_dev = b->use_emu && !b->emu.running;
+    double t0 = now_s();
+    uint64_t sent = wd_trace_replay(&tr, &b->wd.sub, b->paced ? WD_TRACE_PACED : 0);
+    double t_sub = now_s() - t0;
+
+    wd_ed25519_verify_resp_t resp[64];
+    uint64_t done = 0, pass = 0;
+    double t_drain = now_s() + 1.;
+    while (done < sent && now_s() < t_drain) {
+        if (inline_dev)
+            wd_emu_poll(&b->emu);
+        ulong n = wd_ed25519_verify_poll_resp(&b->wd, resp, 64);
+        for (ulong i = 0; i < n; i++)
+            pass += resp[i].res == WD_ED25519_RES_PASS;
+        done += n;
+    }
+
+    report("submitted", sent, tr.n_rec * 32, t_sub);
+    printf("  %-10s   %10lu completed, %lu pass, %lu lost\n", "",
+           (unsigned long)done, (unsigned long)pass, (unsigned long)b->wd.sv.n_lost);
+    printf("  %-10s   %10lu stray beats, %lu requests too long\n", "",
+           (unsigned long)tr.n_bad, (unsigned long)tr.n_skip);
+    report_credit(&b->wd.sub, sent);
+    wd_trace_close(&tr);
+}
+
+/* -------------- load --------------------------------------------------- */
+
+#define POOL      4096            /* distinct pre-signed requests */
+#define N_KEYS    16
+
+typedef struct {
+    uint8_t const *msg;
+    ulong          sz;
+    uint8_t        sig[64];
+    uint8_t const *pub;
+    int            bad;
+} load_req_t;
+
+static uint64_t rng_next(uint64_t *x) {
+    *x ^= *x << 13; *x ^= *x >> 7; *x ^= *x << 17;
+    return *x;
+}
+
+/* rough shape of mainnet transaction messages: mostly votes, with a
+   tail up to the 1232-byte packet limit */
+static ulong solana_sz(uint64_t *x) {
+    static struct { uint32_t pct, lo, hi; } const shape[] = {
+        {  70, 180,  240 },
+        {  85, 240,  500 },
+        {  95, 500,  900 },
+        { 100, 900, 1232 },
+    };
+    uint32_t p = (uint32_t)(rng_next(x) % 100);
+    uint32_t i = 0;
+    while (p >= shape[i].pct) i++;
+    return shape[i].lo + rng_next(x) % (shape[i].hi - shape[i].lo + 1);
+}
+
+static ulong load_sz(bench_t *b, uint64_t *x) {
+    if (!strcmp(b->dist, "uniform"))
+        return b->sz_min + rng_next(x) % (b->sz_max - b->sz_min + 1);
+    if (!strcmp(b->dist, "solana"))
+        return solana_sz(x);
+    return b->sz;
+}
+
+/* POOL signed requests with sizes from the distribution, bad_pct% of
+   them with a corrupted signature */
+static load_req_t *load_pool(bench_t *b, uint8_t **_arena, uint8_t **_keys) {
+    void *sha_mem;
+    if (posix_memalign(&sha_mem, FD_SHA512_ALIGN, FD_SHA512_FOOTPRINT)) exit(1);
+    fd_sha512_t *sha = fd_sha512_join(fd_sha512_new(sha_mem));
+
+    uint64_t x = 0x9e3779b97f4a7c15UL;
+    uint8_t *keys = malloc(N_KEYS * 64);
+    for (uint32_t k = 0; k < N_KEYS; k++) {
+        uint8_t *sk = keys + k * 64;
+        for (uint32_t i = 0; i < 32; i++) sk[i] = (uint8_t)rng_next(&x);
+        fd_ed25519_public_from_private(sk + 32, sk, sha);
+    }
+
+    load_req_t *pool = malloc(POOL * sizeof(load_req_t));
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < POOL; i++) {
+        pool[i].sz = load_sz(b, &x);
+        total += (pool[i].sz + 63) & ~63UL;
+    }
+    uint8_t *arena = aligned_alloc(64, total + 64);
+    uint8_t *p = arena;
+    for (uint32_t i = 0; i < POOL; i++) {
+        load_req_t *r = &pool[i];
+        uint8_t *sk = keys + (i % N_KEYS) * 64;
+        for (ulong j = 0; j < r->sz; j++) p[j] = (uint8_t)rng_next(&x);
+        fd_ed25519_sign(r->sig, p, r->sz, sk + 32, sk, sha);
+        r->msg = p;
+        r->pub = sk + 32;
+        r->bad = (rng_next(&x) % 100) < b->bad_pct;
+        if (r->bad) r->sig[rng_next(&x) % 64] ^= 1;
+        p += (r->sz + 63) & ~63UL;
+    }
+
+    free(sha_mem);
+    *_arena = arena;
+    *_keys  = keys;
+    return pool;
+}
+
+typedef struct {
+    uint64_t done, pass, fail, lost;
+} load_cnt_t;
+
+static void load_drain(bench_t *b, load_cnt_t *c) {
+    wd_ed25519_verify_resp_t resp[64];
+    ulong n = wd_ed25519_verify_poll_resp(&b->wd, resp, 64);
+    for (ulong i = 0; i < n; i++) {
+        c->pass += resp[i].res == WD_ED25519_RES_PASS;
+        c->fail += resp[i].res == WD_ED25519_RES_FAIL;
+        c->lost += resp[i].res == WD_ED25519_RES_LOST;
+    }
+    c->done += n;
+}
+
+/* open-loop (or paced to --rate) load from the request pool for --time
+   seconds or -n requests, whichever ends first */
+static void bench_load(bench_t *b) {
+    uint8_t *arena, *keys;
+    load_req_t *pool = load_pool(b, &arena, &keys);
+
+    printf("load: %s sizes, %u%% bad, %s, slots 0x%lx, %s\n",
+           b->dist, b->bad_pct, b->rate > 0 ? "paced" : "open loop",
+           (unsigned long)b->slots, b->use_emu ? "emu" : "f1");
+    if (b->rate > 0)
+        printf("  target     : %10.3f Mmsg/s\n", b->rate * 1e-6);
+
+    /* hybrid: spill what the device has no room for to CPU workers */
+    if (b->cpu_threads) {
+        if (wd_cpu_init(&b->cpu, b->wd.sv.mcache, b->depth, 1) ||
+            wd_cpu_start(&b->cpu, b->cpu_threads)) {
+            fprintf(stderr, "wd_cpu_init failed\n");
+            exit(1);
+        }
+        wd_sub_spill(&b->wd.sub, &b->cpu, 0);
+        if (b->spill_at[0] || b->spill_at[1])
+            wd_sub_spill_at(&b->wd.sub, b->spill_at[0] ? b->spill_at[0] : WD_BP_PEND_MAX,
+                            b->spill_at[1] ? b->spill_at[1] : WD_BP_DMA_MAX);
+        printf("  spill      : %u cpu threads, above %ld pending / %ld dma\n", b->cpu_threads,
+               (long)b->wd.sub.spill_pend, (long)b->wd.sub.spill_dma);
+    }
+    /* the pool repeats every POOL requests: repeats hit the cache */
+    if (b->cache_cap) {
+        if (wd_cache_init(&b->cache, b->cache_cap, b->depth)) {
+            fprintf(stderr, "wd_cache_init failed\n");
+            exit(1);
+        }
+        wd_ed25519_verify_cache(&b->wd, &b->cache);
+        printf("  cache      : %lu entries\n", (unsigned long)b->cache_cap);
+    }
+
+    int inline_dev = b->use_emu && !b->emu.running;
+    load_cnt_t c = { 0 };
+    uint64_t sent = 0, bytes = 0, bad = 0, busy = 0;
+    uint64_t sent_1 = 0, done_1 = 0;
+    double t0 = now_s(), t_end = b->secs > 0 ? t0 + b->secs : 1e300, t_1 = t0;
+    double now = t0;
+
+    b->wd.sub.n_mmio = b->wd.sub.n_stall = 0;
+    while (sent < b->cnt) {
+        /* check the clock, pacing and progress every 16 requests */
+        if (!(sent & 15)) {
+            now = now_s();
+            if (now >= t_end)
+                break;
+            if (now - t_1 >= 1.) {
+                printf("  %6.1f s   : %10.3f Mmsg/s submitted %10.3f Mmsg/s completed\n",
+                       now - t0, (double)(sent - sent_1) / (now - t_1) * 1e-6,
+                       (double)(c.done - done_1) / (now - t_1) * 1e-6);
+                sent_1 = sent; done_1 = c.done; t_1 = now;
+            }
+            if (b->rate > 0 && (double)sent >= b->rate * (now - t0)) {
+                if (inline_dev)
+                    wd_emu_poll(&b->emu);
+                load_drain(b, &c);
+                continue;
+            }
+        }
+
+        load_req_t const *r = &pool[sent & (POOL - 1)];
+        uint64_t m_seq = sent + 1;
+        /* every slot full: drain results instead of waiting */
+        if (wd_ed25519_verify_try_req(&b->wd, r->msg, r->sz, r->sig, r->pub,
+                                      m_seq, (uint32_t)(sent & (POOL - 1)), 0x3, (uint16_t)r->sz)) {
+            busy++;
+            load_drain(b, &c);
+            continue;
+        }
+        sent++;
+        bytes += req_bytes(r->sz);
+        bad   += (uint64_t)r->bad;
+        if (!(sent & 63))
+            load_drain(b, &c);
+    }
+    double t_sub = now_s() - t0;
+
+    /* drain for up to a second */
+    double t_drain = now_s() + 1.;
+    while (c.done < sent && now_s() < t_drain) {
+        if (inline_dev)
+            wd_emu_poll(&b->emu);
+        load_drain(b, &c);
+    }
+    double t_done = now_s() - t0;
+
+    report("submitted", sent, bytes, t_sub);
+    report("completed", c.done, c.done ? bytes / sent * c.done : 0, t_done);
+    printf("  %-10s   %10lu pass, %lu fail, %lu lost, %lu missing (%lu sent bad)\n", "",
+           (unsigned long)c.pass, (unsigned long)c.fail, (unsigned long)c.lost,
+           (unsigned long)(sent - c.done), (unsigned long)bad);
+    if (b->use_emu && (b->emu_flags & WD_EMU_NO_VERIFY))
+        printf("  %-10s   (emulator does not verify, use --verify)\n", "");
+    printf("  %-10s   %10lu EAGAIN\n", "", (unsigned long)busy);
+    if (b->cpu_threads) {
+        printf("  %-10s   %10lu spilled to cpu (%.1f%%), %lu pool full\n", "",
+               (unsigned long)b->wd.sub.n_spill,
+               sent ? 100. * (double)b->wd.sub.n_spill / (double)sent : 0.,
+               (unsigned long)b->cpu.n_full);
+        wd_sub_spill(&b->wd.sub, NULL, 0);
+        wd_cpu_free(&b->cpu);
+    }
+    if (b->cache_cap) {
+        wd_sub_t const *s = &b->wd.sub;
+        printf("  %-10s   %10lu cache hits (%.1f%%), %lu misses, %lu inserted, %lu evicted\n", "",
+               (unsigned long)s->n_hit,
+               s->n_hit + s->n_miss ? 100. * (double)s->n_hit / (double)(s->n_hit + s->n_miss) : 0.,
+               (unsigned long)s->n_miss, (unsigned long)b->cache.n_insert,
+               (unsigned long)b->cache.n_evict);
+        wd_ed25519_verify_cache(&b->wd, NULL);
+        wd_cache_free(&b->cache);
+    }
+    report_credit(&b->wd.sub, sent);
+    report_slots(&b->wd.sub);
+    report_lat(&b->wd);
+
+    free(pool); free(arena); free(keys);
+}
+
+/* -------------- cpu ---------------------------------------------------- */
+
+/* the CPU verify pool alone, 1, 2, 4, ... up to -p workers, on requests
+   from the load pool; no device */
+static void bench_cpu(bench_t *b) {
+    uint8_t *arena, *keys;
+    load_req_t *pool = load_pool(b, &arena, &keys);
+    void *mcache = aligned_alloc(64, b->depth * sizeof(fd_frag_meta_t));
+    memset(mcache, 0, b->depth * sizeof(fd_frag_meta_t));
+
+    printf("cpu: %lu msgs, %s sizes, %u%% bad\n", (unsigned long)b->cnt, b->dist, b->bad_pct);
+    for (uint32_t n = 1; n <= b->producers && n <= WD_CPU_THREAD_MAX; n <<= 1) {
+        if (wd_cpu_init(&b->cpu, mcache, b->depth, 1) || wd_cpu_start(&b->cpu, n)) {
+            fprintf(stderr, "wd_cpu_init failed\n");
+            exit(1);
+        }
+        uint64_t bytes = 0;
+        double t0 = now_s();
+        for (uint64_t i = 0; i < b->cnt; i++) {
+            load_req_t const *r = &pool[i & (POOL - 1)];
+            while (wd_cpu_req(&b->cpu, r->msg, r->sz, r->sig, r->pub, i + 1,
+                              (uint32_t)(i & (POOL - 1)), 0x3, (uint16_t)r->sz))
+                _mm_pause();
+            bytes += r->sz;
+        }
+        while (FD_VOLATILE_CONST(b->cpu.n_pass) + FD_VOLATILE_CONST(b->cpu.n_fail) < b->cnt)
+            _mm_pause();
+        double dt = now_s() - t0;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%u thr", n);
+        report(name, b->cnt, bytes, dt);
+        printf("  %-10s   %10lu pass, %lu fail\n", "",
+               (unsigned long)b->cpu.n_pass, (unsigned long)b->cpu.n_fail);
+        wd_cpu_free(&b->cpu);
+    }
+
+    free(mcache);
+    free(pool); free(arena); free(keys);
+}
+
+/* -------------- init --------------------------------------------------- */
+
+#define INIT_RUNS 4
+
+/* restart-to-first-verify against the emulator with bring-up latency
+   injected (--init-lat): a cold start on a card that was never
+   programmed, then process restarts against the card as the run before
+   left it.  A run attaches the slots, programs them, waits until they
+   are ready and sends one request per slot through to its result
+   line. */
+static void bench_init(bench_t *b) {
+    if (wd_emu_init(&b->emu, WD_EMU_NO_VERIFY)) {
+        fprintf(stderr, "wd_emu_init failed\n");
+        exit(1);
+    }
+    b->emu.attach_ns = b->init_lat[0];
+    b->emu.mgmt_ns   = b->init_lat[1];
+    b->emu.mmio_ns   = b->init_lat[2];
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 1 && wd_emu_start(&b->emu)) {
+        fprintf(stderr, "wd_emu_start failed\n");
+        exit(1);
+    }
+    alloc_dma(b, -1);
+
+    uint8_t msg[64] = {0}, sig[64] = {0}, pub[32] = {0};
+    uint32_t n_slot = (uint32_t)__builtin_popcountl(b->slots);
+    uint64_t seq = 1;
+
+    printf("init: %u slots, attach %.0f us, vDIP/vLED %.0f us, register read %.0f us\n",
+           n_slot, 1e-3 * (double)b->init_lat[0], 1e-3 * (double)b->init_lat[1],
+           1e-3 * (double)b->init_lat[2]);
+    printf("  %-6s %9s %9s %9s %9s %9s   %s\n", "ms", "attach", "program", "ready",
+           "verify", "total", "vDIP bytes written/skipped");
+    for (int run = 0; run < INIT_RUNS; run++) {
+        memset(&b->wd, 0, sizeof(b->wd));
+        double t0 = now_s();
+        if (wd_init_dev(&b->wd, b->slots, &wd_dev_emu, &b->emu)) {
+            fprintf(stderr, "wd_init_dev failed\n");
+            exit(1);
+        }
+        double t1 = now_s();
+        wd_ed25519_verify_init_req(&b->wd, 1, b->depth, b->hp);
+        wd_ed25519_verify_init_resp(&b->wd, seq);
+        double t2 = now_s();
+        int rc = wd_ed25519_verify_ready(&b->wd, WD_TIMEOUT_DFLT);
+        double t3 = now_s();
+
+        /* round robin: one request lands on each slot */
+        for (uint32_t i = 0; i < n_slot; i++)
+            wd_ed25519_verify_req(&b->wd, msg, sizeof(msg), sig, pub, seq + i, 0, 0x3, sizeof(msg));
+        wd_ed25519_verify_resp_t resp[WD_N_PCI_SLOTS];
+        uint64_t got = 0;
+        while (got < n_slot && now_s() - t3 < 5.) {
+            if (!b->emu.running)
+                wd_emu_poll(&b->emu);
+            got += wd_ed25519_verify_poll_resp(&b->wd, resp, n_slot - got);
+        }
+        double t4 = now_s();
+        seq += n_slot;
+
+        uint32_t n_wr = 0, n_skip = 0;
+        for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++) {
+            n_wr   += b->wd.pci[slot].n_vdip_wr;
+            n_skip += b->wd.pci[slot].n_vdip_skip;
+        }
+        printf("  %-6s %9.2f %9.2f %9.2f %9.2f %9.2f   %u/%u%s%s\n", run ? "warm" : "cold",
+               1e3 * (t1 - t0), 1e3 * (t2 - t1), 1e3 * (t3 - t2), 1e3 * (t4 - t3),
+               1e3 * (t4 - t0), n_wr, n_skip, rc ? ", not ready" : "",
+               got < n_slot ? ", results missing" : "");
+        wd_free_pci(&b->wd);
+    }
+
+    wd_emu_free(&b->emu);
+    if (b->hp_heap)
+        free(b->hp);
+    else
+        wd_hp_free(b->hp, b->hp_sz);
+}
+
+/* -------------- top ---------------------------------------------------- */
+
+/* follow the telemetry another wd_bench (or any process running a
+   wd_tel_t) publishes under name, without touching the device */
+static int bench_top(char const *name) {
+    wd_tel_shm_t const *shm = wd_tel_join(name);
+    if (!shm) {
+        fprintf(stderr, "no telemetry published as %s\n", name);
+        return 1;
+    }
+
+    static wd_tel_shm_t snap;
+    uint64_t last = 0;
+    for (;;) {
+        wd_tel_read(shm, &snap);
+        if (snap.n_sample == last) {
+            usleep(10000);
+            continue;
+        }
+        last = snap.n_sample;
+
+        printf("\nsample %lu, %.1f ms\n", (unsigned long)snap.n_sample,
+               (double)snap.dt_ns * 1e-6);
+        for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++) {
+            wd_tel_slot_t const *ts = &snap.slot[slot];
+            if (!ts->active)
+                continue;
+            printf("  slot %u%s%s%s%s\n", slot,
+                   ts->flags & WD_TEL_INPUT_DROP  ? "  INPUT DROPS"  : "",
+                   ts->flags & WD_TEL_RESULT_DROP ? "  RESULT DROPS" : "",
+                   ts->flags & WD_TEL_INPUT_SAT   ? "  INPUT FULL"   : "",
+                   ts->flags & WD_TEL_RESULT_SAT  ? "  RESULT FULL"  : "");
+            for (uint32_t i = 0; i < WD_TEL_N_CNTR; i++) {
+                if (wd_cntr_desc[i].kind == WD_TEL_FILL)
+                    printf("    %-18s %10u\n", wd_cntr_desc[i].name, ts->c[i].raw);
+                else
+                    printf("    %-18s %10u %12.3f M/s\n", wd_cntr_desc[i].name,
+                           ts->c[i].raw, ts->c[i].rate * 1e-6);
+            }
+        }
+        fflush(stdout);
+    }
+}
+
+/* -------------- main --------------------------------------------------- */
+
+static void usage(void) {
+    puts("usage: wd_bench <mode> [options]\n"
+         "modes:\n"
+         "  batch          per-call submit loop vs wd_ed25519_verify_req_batch\n"
+         "  encode         rdtsc cycles/request, staged vs generic vs sized encoder\n"
+         "  mp             submit scaling over 1..P producer threads\n"
+         "  ring           the same through one submission ring and submitter\n"
+         "  resp           end-to-end rate, submit and drain the mcache\n"
+         "  proc           resp over 1..P processes sharing the slots (emu)\n"
+         "  scan           lines/ns reading the result ring, full page vs scanner\n"
+         "  replay         send the requests of a --record'ed trace again\n"
+         "  load           load generator: size mix, bad signatures, pacing\n"
+         "  cpu            software verify pool alone, 1..P worker threads\n"
+         "  init           restart-to-first-verify on the emulator, cold and warm\n"
+         "  top            follow the counters published with --tel\n"
+         "options:\n"
+         "  --emu          run against the software device model\n"
+         "  --lat[=LG]     record the latency of every 2^LG-th request (default\n"
+         "                 every one), resp mode prints it\n"
+         "  --tel=NAME     sample the pipeline counters every 100 ms into\n"
+         "                 shared memory NAME (top: the one to follow)\n"
+         "  -m MASK        slot mask (default 0x1)\n"
+         "  --sched=P      slot policy over -m: rr (default), least, p2c\n"
+         "  --slow=MASK    emulated slots in MASK verify at 1/8 the rate\n"
+         "  -n CNT         requests per run (default 1000000)\n"
+         "  -s SZ          message size in bytes (default 256)\n"
+         "  -b BATCH       batch size (default 256)\n"
+         "  -p P           max producer threads, or processes (default 8)\n"
+         "  -d DEPTH       mcache depth, 2 MiB pages as needed (default 65536)\n"
+         "  --ordered=N    resp: drain through an N entry reorder buffer and\n"
+         "                 check that results come out in m_seq order\n"
+         "  --shuffle      have the emulator complete requests out of order\n"
+         "  --drop=PCT     have the emulator lose PCT% of the results\n"
+         "  --deadline=US  resp: resubmit requests outstanding for US us\n"
+         "load options:\n"
+         "  --dist=D       message sizes: fixed (-s), uniform, solana\n"
+         "  --sz-min=N     smallest uniform size (default 0)\n"
+         "  --sz-max=N     largest uniform size (default 1232)\n"
+         "  --bad=PCT      percent of requests with a corrupted signature\n"
+         "  --rate=R       target msgs/s (default: open loop)\n"
+         "  --time=SEC     run time, -n still caps the request count\n"
+         "  --verify       have the emulator verify signatures\n"
+         "  --cpu=N        spill to N CPU verify threads when no slot has room\n"
+         "  --spill-at=P,D spill once a slot has P requests pending or D in\n"
+         "                 its DMA buffer (default: the backpressure limits)\n"
+         "  --cache=N      verified-signature cache of N entries in front of load\n"
+         "  --core=C       ring: pin the submitter thread to core C\n"
+         "  --numa=W       put the mcache and the bench threads on the slots'\n"
+         "                 node (local) or another one (remote)\n"
+         "  --record=FILE  capture the BAR4 stream of the run into FILE\n"
+         "  --trace=FILE   replay: the trace to send\n"
+         "  --evt=FILE     log every request's lifecycle, dumped to FILE at\n"
+         "                 the end (wd_evt2json makes a Chrome trace of it)\n"
+         "  --paced        replay: keep the recorded gaps between requests\n"
+         "  --init-lat=A,M,R  init: emulated attach, vDIP/vLED and register\n"
+         "                 read latency in us (default 2000,100,1)");
+}
+
+int main(int argc, char **argv) {
+    bench_t b = {0};
+    b.slots = 1;
+    b.cnt   = 1000000;
+    b.sz    = 256;
+    b.batch = 256;
+    b.producers = 8;
+    b.depth = DEPTH;
+    b.emu_flags = WD_EMU_NO_VERIFY;
+    b.dist   = "fixed";
+    b.sz_max = 1232;
+    b.core   = -1;
+    b.init_lat[0] = 2000000;
+    b.init_lat[1] = 100000;
+    b.init_lat[2] = 1000;
+    int n_set = 0;
+
+    static struct option const longopts[] = {
+        { "emu", no_argument, NULL, 'e' },
+        { "lat", optional_argument, NULL, 'l' },
+        { "tel", required_argument, NULL, 't' },
+        { "dist",    required_argument, NULL, 'D' },
+        { "sz-min",  required_argument, NULL, 'L' },
+        { "sz-max",  required_argument, NULL, 'H' },
+        { "bad",     required_argument, NULL, 'B' },
+        { "rate",    required_argument, NULL, 'R' },
+        { "time",    required_argument, NULL, 'T' },
+        { "verify",  no_argument,       NULL, 'V' },
+        { "sched",   required_argument, NULL, 'S' },
+        { "slow",    required_argument, NULL, 'W' },
+        { "cpu",     required_argument, NULL, 'C' },
+        { "cache",   required_argument, NULL, 'K' },
+        { "core",    required_argument, NULL, 'P' },
+        { "numa",    required_argument, NULL, 'N' },
+        { "record",  required_argument, NULL, 'r' },
+        { "trace",   required_argument, NULL, 'x' },
+        { "paced",   no_argument,       NULL, 'z' },
+        { "init-lat", required_argument, NULL, 'I' },
+        { "ordered", required_argument, NULL, 'O' },
+        { "shuffle", no_argument,       NULL, 'Q' },
+        { "drop",    required_argument, NULL, 'U' },
+        { "deadline", required_argument, NULL, 'A' },
+        { "spill-at", required_argument, NULL, 'F' },
+        { "evt",     required_argument, NULL, 'E' },
+        { 0, 0, 0, 0 }
+    };
+
+    if (argc < 2) { usage(); return 1; }
+    char const *mode = argv[1];
+    argc--; argv++;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "m:n:s:b:p:d:", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'e': b.use_emu = 1;                          break;
+        case 'l': b.lat     = 1;
+                  b.lat_lg  = optarg ? (uint32_t)strtoul(optarg, NULL, 0) : 0;
+                  break;
+        case 't': b.tel_name = optarg;                    break;
+        case 'D': b.dist    = optarg;                     break;
+        case 'L': b.sz_min  = strtoull(optarg, NULL, 0);  break;
+        case 'H': b.sz_max  = strtoull(optarg, NULL, 0);  break;
+        case 'B': b.bad_pct = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'R': b.rate    = strtod(optarg, NULL);       break;
+        case 'T': b.secs    = strtod(optarg, NULL);       break;
+        case 'V': b.emu_flags &= ~WD_EMU_NO_VERIFY;       break;
+        case 'O': b.ordered = strtoull(optarg, NULL, 0);  break;
+        case 'Q': b.emu_flags |= WD_EMU_SHUFFLE;          break;
+        case 'U': b.drop_pct = strtod(optarg, NULL);      break;
+        case 'A': b.deadline_us = strtod(optarg, NULL);   break;
+        case 'S': if      (!strcmp(optarg, "rr"))    b.sched = WD_SCHED_RR;
+                  else if (!strcmp(optarg, "least")) b.sched = WD_SCHED_LEAST;
+                  else if (!strcmp(optarg, "p2c"))   b.sched = WD_SCHED_P2C;
+                  else { usage(); return 1; }
+                  break;
+        case 'W': b.slow    = strtoull(optarg, NULL, 0);  break;
+        case 'C': b.cpu_threads = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'F': {
+                  char *p = optarg;
+                  for (int i = 0; i < 2 && *p; i++) {
+                      b.spill_at[i] = strtol(p, &p, 0);
+                      if (*p == ',') p++;
+                  }
+                  break;
+        }
+        case 'K': b.cache_cap = strtoull(optarg, NULL, 0); break;
+        case 'P': b.core    = (int)strtol(optarg, NULL, 0);  break;
+        case 'r': b.record  = optarg;                     break;
+        case 'x': b.trace   = optarg;                     break;
+        case 'E': b.evt_path = optarg;                    break;
+        case 'z': b.paced   = 1;                          break;
+        case 'I': {
+                  char *p = optarg;
+                  for (int i = 0; i < 3 && *p; i++) {
+                      b.init_lat[i] = (uint64_t)(strtod(p, &p) * 1e3);
+                      if (*p == ',') p++;
+                  }
+                  break;
+        }
+        case 'N': if      (!strcmp(optarg, "local"))  b.numa = 1;
+                  else if (!strcmp(optarg, "remote")) b.numa = 2;
+                  else { usage(); return 1; }
+                  break;
+        case 'm': b.slots   = strtoull(optarg, NULL, 0);  break;
+        case 'n': b.cnt     = strtoull(optarg, NULL, 0);  n_set = 1; break;
+        case 's': b.sz      = strtoull(optarg, NULL, 0);  break;
+        case 'b': b.batch   = strtoull(optarg, NULL, 0);  break;
+        case 'p': b.producers = strtoull(optarg, NULL, 0); break;
+        case 'd': b.depth   = strtoull(optarg, NULL, 0);  break;
+        default : usage(); return 1;
+        }
+    }
+    if (!b.batch) b.batch = 1;
+    if (!strcmp(mode, "top"))
+        return bench_top(b.tel_name ? b.tel_name : "wd_tel");
+    if (!strcmp(mode, "init")) {
+        if (!b.use_emu) {
+            fprintf(stderr, "init: needs --emu\n");
+            return 1;
+        }
+        bench_init(&b);
+        return 0;
+    }
+    if (!strcmp(mode, "cpu")) {
+        if (!n_set) b.cnt = 20000;
+        bench_cpu(&b);
+        return 0;
+    }
+    if (!strcmp(mode, "encode") || !strcmp(mode, "mp") || !strcmp(mode, "ring"))
+        b.emu_flags |= WD_EMU_SINK;
+    if (!strcmp(mode, "proc")) {
+        if (!b.use_emu) {
+            fprintf(stderr, "proc: needs --emu\n");
+            return 1;
+        }
+        b.shared = 1;
+    }
+    if (!strcmp(mode, "load")) {
+        if (strcmp(b.dist, "fixed") && strcmp(b.dist, "uniform") && strcmp(b.dist, "solana")) {
+            usage();
+            return 1;
+        }
+        if (b.sz_min > b.sz_max) b.sz_max = b.sz_min;
+        if (b.secs > 0 && !n_set) b.cnt = ~0UL;
+        /* latency percentiles are part of the report */
+        if (!b.lat) { b.lat = 1; b.lat_lg = 4; }
+    }
+    /* the clock calibration converts head-of-line stalls to us */
+    if (!strcmp(mode, "resp") && b.ordered && !b.lat) { b.lat = 1; b.lat_lg = 16; }
+
+    bench_open(&b);
+
+    int rc = 0;
+    if      (!strcmp(mode, "batch"))  bench_batch(&b);
+    else if (!strcmp(mode, "encode")) bench_encode(&b);
+    else if (!strcmp(mode, "mp"))     bench_mp(&b);
+    else if (!strcmp(mode, "ring"))   bench_ring(&b);
+    else if (!strcmp(mode, "resp"))   rc = bench_resp(&b);
+    else if (!strcmp(mode, "proc"))   bench_proc(&b);
+    else if (!strcmp(mode, "scan"))   bench_scan(&b);
+    else if (!strcmp(mode, "replay")) bench_replay(&b);
+    else if (!strcmp(mode, "load"))   bench_load(&b);
+    else { usage(); bench_close(&b); return 1; }
+
+    bench_close(&b);
+    return rc;
+}
@@ -0,0 +1,224 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <sys/random.h>
+
+#include "wd_cache.h"
+
+/* SipHash-1-3 (one compression round, three finalization rounds), the
+   variant hash tables use where SipHash-2-4 is more than they need */
+
+#define WD_SIP_ROTL(x, b)       (((x) << (b)) | ((x) >> (64 - (b))))
+#define WD_SIP_ROUND(v0, v1, v2, v3)                                      \
+    do {                                                                  \
+        v0 += v1; v1 = WD_SIP_ROTL(v1, 13); v1 ^= v0; v0 = WD_SIP_ROTL(v0, 32); \
+        v2 += v3; v3 = WD_SIP_ROTL(v3, 16); v3 ^= v2;                     \
+        v0 += v3; v3 = WD_SIP_ROTL(v3, 21); v3 ^= v0;                     \
+        v2 += v1; v1 = WD_SIP_ROTL(v1, 17); v1 ^= v2; v2 = WD_SIP_ROTL(v2, 32); \
+    } while (0)
+
+typedef struct {
+    uint64_t v0, v1, v2, v3;
+} _wd_sip_t;
+
+static inline void
+_wd_sip_init(_wd_sip_t* s, uint64_t const* k)
+{
+    s->v0 = k[0] ^ 0x736f6d6570736575UL;
+    s->v1 = k[1] ^ 0x646f72616e646f6dUL;
+    s->v2 = k[0] ^ 0x6c7967656e657261UL;
+    s->v3 = k[1] ^ 0x7465646279746573UL;
+}
+
+static inline void
+_wd_sip_word(_wd_sip_t* s, uint64_t m)
+{
+    s->v3 ^= m;
+    WD_SIP_ROUND(s->v0, s->v1, s->v2, s->v3);
+    s->v0 ^= m;
+}
+
+static inline uint64_t
+_wd_sip_fini(_wd_sip_t* s)
+{
+    s->v2 ^= 0xff;
+    WD_SIP_ROUND(s->v0, s->v1, s->v2, s->v3);
+    WD_SIP_ROUND(s->v0, s->v1, s->v2, s->v3);
+    WD_SIP_ROUND(s->v0, s->v1, s->v2, s->v3);
+    return s->v0 ^ s->v1 ^ s->v2 ^ s->v3;
+}
+
+/* keyed hash of the sz bytes at p */
+static uint64_t
+_wd_sip(uint64_t const* k, uint8_t const* p, ulong sz)
+{
+    _wd_sip_t s;
+    _wd_sip_init(&s, k);
+    ulong i;
+    uint64_t m;
+    for (i = 0; i + 8 <= sz; i += 8)
+    {
+        memcpy(&m, p + i, 8);
+        _wd_sip_word(&s, m);
+    }
+    m = (uint64_t)sz << 56;
+    for (ulong j = 0; i + j < sz; j ++)
+        m |= (uint64_t)p[i + j] << (8 * j);
+    _wd_sip_word(&s, m);
+    return _wd_sip_fini(&s);
+}
+
+/* keyed hash of sig || public_key (96 bytes, no partial word) */
+static uint64_t
+_wd_sip_sigpub(uint64_t const* k, uint8_t const* sig, uint8_t const* pub)
+{
+    _wd_sip_t s;
+    _wd_sip_init(&s, k);
+    uint64_t m;
+    for (uint32_t i = 0; i < 64; i += 8)
+    {
+        memcpy(&m, sig + i, 8);
+        _wd_sip_word(&s, m);
+    }
+    for (uint32_t i = 0; i < 32; i += 8)
+    {
+        memcpy(&m, pub + i, 8);
+        _wd_sip_word(&s, m);
+    }
+    _wd_sip_word(&s, 96UL << 56);
+    return _wd_sip_fini(&s);
+}
+
+//    SSSSSSSSSSSSSSS  IIIIIIIIII         GGGGGGGGGGGGG
+//  SS:::::::::::::::S I::::::::I      GGG::::::::::::G
+// S:::::SSSSSS::::::S I::::::::I    GG:::::::::::::::G
+// S:::::S     SSSSSSS II::::::II   G:::::GGGGGGGG::::G
+// S:::::S               I::::I    G:::::G       GGGGGG
+// S:::::S               I::::I   G:::::G
+//  S::::SSSS            I::::I   G:::::G
+//   SS::::::SSSSS       I::::I   G:::::G    GGGGGGGGGG
+//     SSS::::::::SS     I::::I   G:::::G    G::::::::G
+//        SSSSSS::::S    I::::I   G:::::G    GGGGG::::G
+//             S:::::S   I::::I   G:::::G        G::::G
+//             S:::::S   I::::I    G:::::G       G::::G
+// SSSSSSS     S:::::S II::::::II   G:::::GGGGGGGG::::G
+// S::::::SSSSSS:::::S I::::::::I    GG:::::::::::::::G
+// S:::::::::::::::SS  I::::::::I      GGG::::::GGG:::G
+//  SSSSSSSSSSSSSSS    IIIIIIIIII         GGGGGG   GGGG
+
+int wd_cache_init(wd_cache_t* cache, uint64_t capacity, uint64_t depth)
+{
+    memset(cache, 0, sizeof(*cache));
+
+    uint64_t n_bucket = 1;
+    while (n_bucket * WD_CACHE_WAYS < capacity)
+        n_bucket <<= 1;
+    cache->bucket_mask = n_bucket - 1;
+    cache->depth       = depth;
+
+    if (getrandom(cache->key, sizeof(cache->key), 0) != (ssize_t)sizeof(cache->key))
+        return -1;
+
+    cache->ent  = aligned_alloc(64, n_bucket * WD_CACHE_WAYS * sizeof(wd_cache_ent_t));
+    cache->pend = calloc(depth, sizeof(wd_cache_pend_t));
+    if (!cache->ent || !cache->pend)
+    {
+        wd_cache_free(cache);
+        return -1;
+    }
+    memset(cache->ent, 0, n_bucket * WD_CACHE_WAYS * sizeof(wd_cache_ent_t));
+    return 0;
+}
+
+void wd_cache_free(wd_cache_t* cache)
+{
+    free(cache->ent);
+    free(cache->pend);
+    cache->ent  = NULL;
+    cache->pend = NULL;
+}
+
+int
+wd_cache_query( wd_cache_t const *  cache,
+                void const *        msg,
+                ulong               sz,
+                void const *        sig,
+                void const *        public_key,
+                uint64_t *          _tag,
+                uint64_t *          _chk)
+{
+    uint64_t tag = _wd_sip_sigpub(cache->key, (uint8_t const*)sig, (uint8_t const*)public_key);
+    uint64_t chk = _wd_sip(cache->key + 2, (uint8_t const*)msg, sz);
+    tag += !tag;
+    *_tag = tag;
+    *_chk = chk;
+
+    wd_cache_ent_t * b = cache->ent + (tag & cache->bucket_mask) * WD_CACHE_WAYS;
+    for (uint32_t w = 0; w < WD_CACHE_WAYS; w ++)
+    {
+        if (__atomic_load_n(&b[w].tag, __ATOMIC_ACQUIRE) != tag)
+            continue;
+        uint64_t c = __atomic_load_n(&b[w].chk, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // rewritten while we were reading it
+        if (__atomic_load_n(&b[w].tag, __ATOMIC_RELAXED) != tag)
+            continue;
+        if (c == chk)
+            return 1;
+    }
+    return 0;
+}
+
+void wd_cache_insert(wd_cache_t* cache, uint64_t tag, uint64_t chk)
+{
+    wd_cache_ent_t * b = cache->ent + (tag & cache->bucket_mask) * WD_CACHE_WAYS;
+    wd_cache_ent_t * e = NULL;
+    for (uint32_t w = 0; w < WD_CACHE_WAYS; w ++)
+    {
+        if (b[w].tag == tag && b[w].chk == chk)
+        {
+            cache->n_dup ++;
+            return;
+        }
+        if (!e && !b[w].tag)
+            e = b + w;
+    }
+    if (!e)
+    {
+        e = b + (cache->n_insert & (WD_CACHE_WAYS - 1));
+        cache->n_evict ++;
+    }
+
+    __atomic_store_n(&e->tag, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&e->chk, chk, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->tag, tag, __ATOMIC_RELEASE);
+    cache->n_insert ++;
+}
+
+void wd_cache_note(wd_cache_t* cache, uint64_t m_seq, uint64_t tag, uint64_t chk)
+{
+    wd_cache_pend_t * p = &cache->pend[fd_mcache_line_idx(m_seq, cache->depth)];
+    // the poller must never pair the previous seq with these hashes
+    __atomic_store_n(&p->seq, ~0UL, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&p->tag, tag, __ATOMIC_RELAXED);
+    __atomic_store_n(&p->chk, chk, __ATOMIC_RELAXED);
+    __atomic_store_n(&p->seq, m_seq, __ATOMIC_RELEASE);
+}
+
+void wd_cache_done(wd_cache_t* cache, uint64_t m_seq)
+{
+    wd_cache_pend_t const * p = &cache->pend[fd_mcache_line_idx(m_seq, cache->depth)];
+    if (__atomic_load_n(&p->seq, __ATOMIC_ACQUIRE) != m_seq)
+        return;
+    uint64_t tag = __atomic_load_n(&p->tag, __ATOMIC_RELAXED);
+    uint64_t chk = __atomic_load_n(&p->chk, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    // noted again for a later request on the same line
+    if (__atomic_load_n(&p->seq, __ATOMIC_RELAXED) != m_seq)
+        return;
+    wd_cache_insert(cache, tag, chk);
+}
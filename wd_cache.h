@@ -0,0 +1,87 @@
+#ifndef HEADER_fd_src_wiredancer_wd_cache_h
+#define HEADER_fd_src_wiredancer_wd_cache_h
+
+#include "wd_f1.h"
+
+/* Verified-signature cache.  Remembers (signature, public key, message)
+   tuples the device (or the CPU pool) has verified, so a retransmitted
+   copy completes on the host without going over PCIe:
+
+     wd_cache_t cache;
+     wd_cache_init(&cache, 1UL << 20, wd.sv.req_depth);
+     wd_ed25519_verify_cache(&wd, &cache);
+
+   An entry is a 64-bit tag, keyed SipHash of signature and public key,
+   and a 64-bit check, keyed SipHash of the message.  The keys are drawn
+   from getrandom at init, so a sender cannot aim for a collision: a
+   forged message passes for a cached one with probability 2^-64.  Only
+   passing results are cached.
+   The table is open addressed in 64-byte buckets of WD_CACHE_WAYS
+   entries; a lookup hashes, loads one cache line and compares.  A full
+   bucket evicts in turn.  Lookups from any number of threads run
+   concurrently with inserts from the poller without a lock: an entry is
+   invalidated before it is rewritten and a reader checks its tag
+   before and after reading the check.
+
+   Requests are noted under their m_seq when submitted (depth entries,
+   the mcache's) and inserted when wd_ed25519_verify_poll_resp sees
+   them pass. */
+
+#define WD_CACHE_WAYS           4
+
+typedef struct {
+
+    uint64_t            tag;            /* 0: empty                    */
+    uint64_t            chk;
+
+} wd_cache_ent_t;
+
+typedef struct {
+
+    uint64_t            seq;
+    uint64_t            tag;
+    uint64_t            chk;
+
+} wd_cache_pend_t;
+
+struct wd_cache {
+
+    wd_cache_ent_t *    ent;            /* n_bucket * WD_CACHE_WAYS    */
+    uint64_t            bucket_mask;
+    wd_cache_pend_t *   pend;
+    uint64_t            depth;
+    uint64_t            key[4];         /* tag key, check key          */
+
+    /* poller */
+    uint64_t            n_insert        __attribute__((aligned(64)));
+    uint64_t            n_evict;
+    uint64_t            n_dup;
+
+};
+
+/* wd_cache_init sizes the cache for capacity entries (rounded up to a
+   power of 2 number of buckets) and depth pending requests.  Returns
+   -1 on failure. */
+int                     wd_cache_init   (wd_cache_t* cache, uint64_t capacity, uint64_t depth);
+void                    wd_cache_free   (wd_cache_t* cache);
+
+/* wd_cache_query hashes a request and returns 1 if it is cached.  The
+   hashes are returned in tag/chk for wd_cache_note. */
+int
+wd_cache_query( wd_cache_t const *  cache,
+                void const *        msg,
+                ulong               sz,
+                void const *        sig,
+                void const *        public_key,
+                uint64_t *          tag,
+                uint64_t *          chk);
+
+/* wd_cache_note remembers that the request hashed to tag/chk went out
+   as m_seq; wd_cache_done caches it once its result line shows it
+   passed.  wd_cache_insert caches tag/chk directly.  Insertion is
+   single writer. */
+void                    wd_cache_note   (wd_cache_t* cache, uint64_t m_seq, uint64_t tag, uint64_t chk);
+void                    wd_cache_done   (wd_cache_t* cache, uint64_t m_seq);
+void                    wd_cache_insert (wd_cache_t* cache, uint64_t tag, uint64_t chk);
+
+#endif
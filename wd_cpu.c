@@ -0,0 +1,266 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+
+#include "wd_cpu.h"
+#include "../../ballet/ed25519/fd_ed25519.h"
+
+/* The queue is a bounded MPMC ring (Vyukov): entry i is free for the
+   producer at queue position pos when its qseq == pos, holds a request
+   for the consumer at pos when qseq == pos+1, and is handed back for
+   the next lap by setting qseq = pos + WD_CPU_QUEUE_DEPTH. */
+
+static inline uint32_t
+_wd_cpu_ts(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec) >> 2);
+}
+
+//         CCCCCCCCCCCCC PPPPPPPPPPPPPPPPP    UUUUUUUU     UUUUUUUU
+//      CCC::::::::::::C P::::::::::::::::P   U::::::U     U::::::U
+//    CC:::::::::::::::C P::::::PPPPPP:::::P  U::::::U     U::::::U
+//   C:::::CCCCCCCC::::C PP:::::P     P:::::P UU:::::U     U:::::UU
+//  C:::::C       CCCCCC   P::::P     P:::::P  U:::::U     U:::::U
+// C:::::C                 P::::P     P:::::P  U:::::D     D:::::U
+// C:::::C                 P::::PPPPPP:::::P   U:::::D     D:::::U
+// C:::::C                 P:::::::::::::PP    U:::::D     D:::::U
+// C:::::C                 P::::PPPPPPPPP      U:::::D     D:::::U
+// C:::::C                 P::::P              U:::::D     D:::::U
+// C:::::C                 P::::P              U:::::D     D:::::U
+//  C:::::C       CCCCCC   P::::P              U::::::U   U::::::U
+//   C:::::CCCCCCCC::::C PP::::::PP            U:::::::UUU:::::::U
+//    CC:::::::::::::::C P::::::::P             UU:::::::::::::UU
+//      CCC::::::::::::C P::::::::P               UU:::::::::UU
+//         CCCCCCCCCCCCC PPPPPPPPPP                 UUUUUUUUU
+
+static void*
+_wd_cpu_sha_new(void)
+{
+    void* mem;
+    if (posix_memalign(&mem, FD_SHA512_ALIGN, FD_SHA512_FOOTPRINT))
+        return NULL;
+    return fd_sha512_join(fd_sha512_new(mem));
+}
+
+int wd_cpu_init(wd_cpu_t* cpu, void* mcache, uint64_t depth, uint8_t send_fails)
+{
+    memset(cpu, 0, sizeof(*cpu));
+    cpu->mcache     = (fd_frag_meta_t*)mcache;
+    cpu->depth      = depth;
+    cpu->send_fails = send_fails;
+
+    cpu->q = aligned_alloc(64, WD_CPU_QUEUE_DEPTH * sizeof(wd_cpu_req_t));
+    if (!cpu->q)
+        return -1;
+    for (uint64_t i = 0; i < WD_CPU_QUEUE_DEPTH; i ++)
+        cpu->q[i].qseq = i;
+
+    cpu->sha = _wd_cpu_sha_new();
+    if (!cpu->sha)
+    {
+        free(cpu->q);
+        return -1;
+    }
+    return 0;
+}
+
+void wd_cpu_free(wd_cpu_t* cpu)
+{
+    wd_cpu_stop(cpu);
+    free(cpu->sha);
+    free(cpu->q);
+    cpu->sha = NULL;
+    cpu->q   = NULL;
+}
+
+int
+wd_cpu_req( wd_cpu_t *    cpu,
+            void const *  msg,
+            ulong         sz,
+            void const *  sig,
+            void const *  public_key,
+            uint64_t      m_seq,
+            uint32_t      m_chunk,
+            uint16_t      m_ctrl,
+            uint16_t      m_sz)
+{
+    if (sz > WD_CPU_MSG_MAX)
+        return EAGAIN;
+
+    wd_cpu_req_t * e;
+    uint64_t pos = __atomic_load_n(&cpu->tail, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        e = &cpu->q[pos & (WD_CPU_QUEUE_DEPTH - 1)];
+        int64_t d = (int64_t)(__atomic_load_n(&e->qseq, __ATOMIC_ACQUIRE) - pos);
+        if (!d)
+        {
+            if (__atomic_compare_exchange_n(&cpu->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (d < 0)
+        {
+            __atomic_fetch_add(&cpu->n_full, 1, __ATOMIC_RELAXED);
+            return EAGAIN;
+        }
+        else
+            pos = __atomic_load_n(&cpu->tail, __ATOMIC_RELAXED);
+    }
+
+    e->m_seq   = m_seq;
+    e->m_chunk = m_chunk;
+    e->m_ctrl  = m_ctrl;
+    e->m_sz    = m_sz;
+    e->sz      = (uint32_t)sz;
+    e->tsorig  = _wd_cpu_ts();
+    memcpy(e->sig, sig, 64);
+    memcpy(e->pub, public_key, 32);
+    if (sz)
+        memcpy(e->msg, msg, sz);
+    __atomic_store_n(&e->qseq, pos + 1, __ATOMIC_RELEASE);
+
+    __atomic_fetch_add(&cpu->n_req, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/* publish e's result into its mcache line the way the device does */
+static void
+_wd_cpu_result(wd_cpu_t* cpu, wd_cpu_req_t const* e, uint64_t res)
+{
+    fd_frag_meta_t* meta = cpu->mcache + fd_mcache_line_idx(e->m_seq, cpu->depth);
+
+    /* same publication order as fd_mcache_publish */
+    FD_COMPILER_MFENCE();
+    FD_VOLATILE(meta->seq) = fd_seq_dec(e->m_seq, 1UL);
+    FD_COMPILER_MFENCE();
+    meta->sig    = res;
+    meta->chunk  = e->m_chunk;
+    meta->sz     = e->m_sz;
+    meta->ctl    = e->m_ctrl;
+    meta->tsorig = e->tsorig;
+    meta->tspub  = _wd_cpu_ts();
+    FD_COMPILER_MFENCE();
+    FD_VOLATILE(meta->seq) = e->m_seq;
+    FD_COMPILER_MFENCE();
+}
+
+/* dequeue and verify up to max requests with sha */
+static uint64_t
+_wd_cpu_work(wd_cpu_t* cpu, fd_sha512_t* sha, uint64_t max)
+{
+    uint64_t n = 0, pass = 0;
+    while (n < max)
+    {
+        wd_cpu_req_t * e;
+        uint64_t pos = __atomic_load_n(&cpu->head, __ATOMIC_RELAXED);
+        for (;;)
+        {
+            e = &cpu->q[pos & (WD_CPU_QUEUE_DEPTH - 1)];
+            int64_t d = (int64_t)(__atomic_load_n(&e->qseq, __ATOMIC_ACQUIRE) - (pos + 1));
+            if (!d)
+            {
+                if (__atomic_compare_exchange_n(&cpu->head, &pos, pos + 1, 1,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    break;
+            }
+            else if (d < 0)
+            {
+                e = NULL;
+                break;
+            }
+            else
+                pos = __atomic_load_n(&cpu->head, __ATOMIC_RELAXED);
+        }
+        if (!e)
+            break;
+
+        int ok = fd_ed25519_verify(e->msg, e->sz, e->sig, e->pub, sha) == FD_ED25519_SUCCESS;
+        if (ok || cpu->send_fails)
+            _wd_cpu_result(cpu, e, ok ? WD_ED25519_RES_PASS : WD_ED25519_RES_FAIL);
+        pass += (uint64_t)ok;
+        n ++;
+
+        __atomic_store_n(&e->qseq, pos + WD_CPU_QUEUE_DEPTH, __ATOMIC_RELEASE);
+    }
+    if (n)
+    {
+        __atomic_fetch_add(&cpu->n_pass, pass,     __ATOMIC_RELAXED);
+        __atomic_fetch_add(&cpu->n_fail, n - pass, __ATOMIC_RELAXED);
+    }
+    return n;
+}
+
+uint64_t wd_cpu_poll(wd_cpu_t* cpu, uint64_t max)
+{
+    return _wd_cpu_work(cpu, (fd_sha512_t*)cpu->sha, max);
+}
+
+static void* _wd_cpu_main(void* arg)
+{
+    wd_cpu_worker_t* w   = (wd_cpu_worker_t*)arg;
+    wd_cpu_t*        cpu = w->cpu;
+    uint32_t         idle = 0;
+    for (;;)
+    {
+        if (_wd_cpu_work(cpu, (fd_sha512_t*)w->sha, WD_CPU_BURST))
+        {
+            idle = 0;
+            continue;
+        }
+        if (!FD_VOLATILE_CONST(cpu->running))
+            break;
+        // spill comes in bursts: stay hot for a while, then nap
+        if (++ idle < 4096)
+            _mm_pause();
+        else
+        {
+            struct timespec ts = { .tv_sec = 0, .tv_nsec = 20000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+int wd_cpu_start(wd_cpu_t* cpu, uint32_t n_thread)
+{
+    if (cpu->running)
+        return 0;
+    if (n_thread > WD_CPU_THREAD_MAX)
+        n_thread = WD_CPU_THREAD_MAX;
+
+    cpu->running  = 1;
+    cpu->n_thread = 0;
+    for (uint32_t i = 0; i < n_thread; i ++)
+    {
+        wd_cpu_worker_t* w = &cpu->w[i];
+        w->cpu = cpu;
+        w->sha = _wd_cpu_sha_new();
+        if (!w->sha || pthread_create(&w->thread, NULL, _wd_cpu_main, w))
+        {
+            free(w->sha);
+            wd_cpu_stop(cpu);
+            return -1;
+        }
+        cpu->n_thread ++;
+    }
+    return 0;
+}
+
+void wd_cpu_stop(wd_cpu_t* cpu)
+{
+    if (!cpu->running)
+        return;
+    FD_VOLATILE(cpu->running) = 0;
+    for (uint32_t i = 0; i < cpu->n_thread; i ++)
+    {
+        pthread_join(cpu->w[i].thread, NULL);
+        free(cpu->w[i].sha);
+        cpu->w[i].sha = NULL;
+    }
+    cpu->n_thread = 0;
+}
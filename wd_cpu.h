@@ -0,0 +1,109 @@
+#ifndef HEADER_fd_src_wiredancer_wd_cpu_h
+#define HEADER_fd_src_wiredancer_wd_cpu_h
+
+#include <pthread.h>
+
+#include "wd_f1.h"
+
+/* Software ED25519 verify pool.  Requests are copied into a bounded
+   multi-producer multi-consumer queue and verified by worker threads,
+   which write each result into the mcache line the device would have
+   written, in the same publication order and with the same fields
+   (seq, sig = WD_ED25519_RES_*, chunk, sz, ctl), so a consumer of the
+   mcache cannot tell the two paths apart.  tsorig/tspub are 250 MHz
+   ticks of CLOCK_MONOTONIC at queueing and at publication instead of
+   device clock ticks.
+
+   On its own it is a CPU verifier with the request interface of the
+   device.  Attached to a submit handle (wd_sub_spill) it takes the
+   requests that would otherwise wait for the FPGA:
+
+     wd_cpu_t cpu;
+     wd_cpu_init (&cpu, wd.sv.mcache, wd.sv.req_depth, 1);
+     wd_cpu_start(&cpu, 4);
+     wd_sub_spill(&wd.sub, &cpu, 0);
+
+   Requests whose message is larger than WD_CPU_MSG_MAX are never
+   queued. */
+
+#define WD_CPU_QUEUE_DEPTH      4096            /* power of 2           */
+#define WD_CPU_MSG_MAX          1280            /* > 1232 packet limit  */
+#define WD_CPU_THREAD_MAX       64
+#define WD_CPU_BURST            16              /* dequeued per pass    */
+
+typedef struct {
+
+    uint64_t            qseq;           /* queue sequence, see wd_cpu.c */
+    uint64_t            m_seq;
+    uint32_t            m_chunk;
+    uint16_t            m_ctrl;
+    uint16_t            m_sz;
+    uint32_t            sz;
+    uint32_t            tsorig;
+    uint8_t             sig[64];
+    uint8_t             pub[32];
+    uint8_t             msg[WD_CPU_MSG_MAX];
+
+} __attribute__((aligned(64))) wd_cpu_req_t;
+
+typedef struct {
+
+    wd_cpu_t *          cpu;
+    void *              sha;
+    pthread_t           thread;
+
+} wd_cpu_worker_t;
+
+struct wd_cpu {
+
+    fd_frag_meta_t *    mcache;
+    uint64_t            depth;
+    uint8_t             send_fails;
+    wd_cpu_req_t *      q;
+    void *              sha;            /* wd_cpu_poll's               */
+
+    /* producers */
+    uint64_t            tail            __attribute__((aligned(64)));
+    uint64_t            n_req;
+    uint64_t            n_full;
+    /* workers */
+    uint64_t            head            __attribute__((aligned(64)));
+    uint64_t            n_pass;
+    uint64_t            n_fail;
+
+    uint32_t            n_thread        __attribute__((aligned(64)));
+    volatile int        running;
+    wd_cpu_worker_t     w[WD_CPU_THREAD_MAX];
+
+};
+
+/* wd_cpu_init sets cpu up to publish results into the depth line
+   mcache; with send_fails 0 failing requests get no line, as on the
+   device.  wd_cpu_start starts n_thread workers (up to
+   WD_CPU_THREAD_MAX), wd_cpu_stop stops them after the queue is empty.
+   wd_cpu_free stops them and frees the queue. */
+int                     wd_cpu_init     (wd_cpu_t* cpu, void* mcache, uint64_t depth, uint8_t send_fails);
+void                    wd_cpu_free     (wd_cpu_t* cpu);
+int                     wd_cpu_start    (wd_cpu_t* cpu, uint32_t n_thread);
+void                    wd_cpu_stop     (wd_cpu_t* cpu);
+
+/* wd_cpu_req queues a request, arguments as for wd_ed25519_verify_req;
+   msg, sig and public_key are copied.  Returns EAGAIN if the queue is
+   full or the message too large.  Any thread. */
+int
+wd_cpu_req( wd_cpu_t *    cpu,
+            void const *  msg,
+            ulong         sz,
+            void const *  sig,
+            void const *  public_key,
+            uint64_t      m_seq,
+            uint32_t      m_chunk,
+            uint16_t      m_ctrl,
+            uint16_t      m_sz);
+
+/* wd_cpu_poll verifies up to max queued requests on the calling thread
+   and returns how many it did, for use without worker threads.  One
+   polling thread at a time. */
+uint64_t                wd_cpu_poll     (wd_cpu_t* cpu, uint64_t max);
+
+#endif
@@ -0,0 +1,585 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <sched.h>
+
+#include "wd_emu.h"
+#include "../../ballet/ed25519/fd_ed25519.h"
+
+/* requests verified per slot per wd_emu_poll pass */
+#define WD_EMU_VERIFY_BURST     64
+
+uint64_t wd_emu_ts(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec) >> 2;
+}
+
+static void _wd_emu_delay(uint64_t ns)
+{
+    if (!ns)
+        return;
+    struct timespec ts = { .tv_sec = (time_t)(ns / 1000000000UL), .tv_nsec = (long)(ns % 1000000000UL) };
+    nanosleep(&ts, NULL);
+}
+
+static inline wd_emu_slot_t* _wd_emu_slot(wd_pci_t* pci)
+{
+    return ((wd_emu_t*)pci->dev_ctx)->slot[pci->slot];
+}
+
+static inline uint8_t* _wd_emu_win(wd_emu_slot_t* es, uint32_t si)
+{
+    return es->bar4 + (uint64_t)si * WD_EMU_STREAM_SZ;
+}
+
+/* copy sz bytes starting at stream position pos out of the window */
+static void _wd_emu_copy(wd_emu_slot_t* es, uint32_t si, uint64_t pos, void* dst, uint64_t sz)
+{
+    uint8_t* win = _wd_emu_win(es, si);
+    uint64_t off = pos & (WD_EMU_STREAM_SZ - 1);
+    uint64_t n0  = WD_EMU_STREAM_SZ - off;
+    if (n0 >= sz)
+    {
+        memcpy(dst, win + off, sz);
+        return;
+    }
+    memcpy(dst, win + off, n0);
+    memcpy((uint8_t*)dst + n0, win, sz - n0);
+}
+
+// DDDDDDDDDDDDD         EEEEEEEEEEEEEEEEEEEEEE VVVVVVVV           VVVVVVVV
+// D::::::::::::DDD      E::::::::::::::::::::E V::::::V           V::::::V
+// D:::::::::::::::DD    E::::::::::::::::::::E V::::::V           V::::::V
+// DDD:::::DDDDD:::::D   EE::::::EEEEEEEEE::::E V::::::V           V::::::V
+//   D:::::D    D:::::D    E:::::E       EEEEEE  V:::::V           V:::::V
+//   D:::::D     D:::::D   E:::::E                V:::::V         V:::::V
+//   D:::::D     D:::::D   E::::::EEEEEEEEEE       V:::::V       V:::::V
+//   D:::::D     D:::::D   E:::::::::::::::E        V:::::V     V:::::V
+//   D:::::D     D:::::D   E:::::::::::::::E         V:::::V   V:::::V
+//   D:::::D     D:::::D   E::::::EEEEEEEEEE          V:::::V V:::::V
+//   D:::::D     D:::::D   E:::::E                     V:::::V:::::V
+//   D:::::D    D:::::D    E:::::E       EEEEEE         V:::::::::V
+// DDD:::::DDDDD:::::D   EE::::::EEEEEEEE:::::E          V:::::::V
+// D:::::::::::::::DD    E::::::::::::::::::::E           V:::::V
+// D::::::::::::DDD      E::::::::::::::::::::E            V:::V
+// DDDDDDDDDDDDD         EEEEEEEEEEEEEEEEEEEEEE             VVV
+
+static int
+_wd_emu_attach(wd_pci_t* pci)
+{
+    wd_emu_t* emu = (wd_emu_t*)pci->dev_ctx;
+
+    if (emu->slot[pci->slot])
+    {
+        FD_LOG_WARNING(( "emulated slot %u already attached", pci->slot ));
+        return -1;
+    }
+
+    /* shared, like the BAR4, so processes forked once the slot is up
+       drive the same device */
+    wd_emu_slot_t* es = mmap(NULL, sizeof(wd_emu_slot_t),
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS,
+                             -1, 0);
+    if (es == MAP_FAILED)
+        return -1;
+
+    es->bar4 = mmap(NULL, WD_N_PCI_STREAMS * WD_EMU_STREAM_SZ,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE,
+                    -1, 0);
+    if (es->bar4 == MAP_FAILED)
+    {
+        FD_LOG_WARNING(( "unable to map emulated BAR4 for slot %u", pci->slot ));
+        munmap(es, sizeof(wd_emu_slot_t));
+        return -1;
+    }
+
+    es->fifo = calloc(WD_EMU_FIFO_DEPTH, sizeof(wd_emu_req_t));
+    if (!es->fifo)
+    {
+        munmap(es->bar4, WD_N_PCI_STREAMS * WD_EMU_STREAM_SZ);
+        munmap(es, sizeof(wd_emu_slot_t));
+        return -1;
+    }
+
+    pci->bar4_addr = es->bar4;
+
+    wd_emu_cfg_t const* cfg = &emu->cfg[pci->slot];
+    memcpy(es->thr,  cfg->thr,  sizeof(es->thr));
+    memcpy(es->vdip, cfg->vdip, sizeof(es->vdip));
+    es->send_fails = cfg->send_fails;
+    _wd_emu_delay(emu->attach_ns);
+
+    FD_COMPILER_MFENCE();
+    FD_VOLATILE(emu->slot[pci->slot]) = es;
+
+    return 0;
+}
+
+static void
+_wd_emu_detach(wd_pci_t* pci)
+{
+    wd_emu_t* emu = (wd_emu_t*)pci->dev_ctx;
+    wd_emu_slot_t* es = emu->slot[pci->slot];
+    if (!es)
+        return;
+
+    FD_VOLATILE(emu->slot[pci->slot]) = NULL;
+    FD_COMPILER_MFENCE();
+
+    /* wait out a device pass that may still hold the slot: once we get
+       the pass guard, any later pass finds the slot gone */
+    while (__atomic_exchange_n(&emu->polling, 1, __ATOMIC_ACQUIRE))
+        sched_yield();
+    __atomic_store_n(&emu->polling, 0, __ATOMIC_RELEASE);
+
+    wd_emu_cfg_t* cfg = &emu->cfg[pci->slot];
+    memcpy(cfg->thr,  es->thr,  sizeof(cfg->thr));
+    memcpy(cfg->vdip, es->vdip, sizeof(cfg->vdip));
+    cfg->send_fails = es->send_fails;
+
+    munmap(es->bar4, WD_N_PCI_STREAMS * WD_EMU_STREAM_SZ);
+    free(es->fifo);
+    munmap(es, sizeof(wd_emu_slot_t));
+    pci->bar4_addr = 0;
+}
+
+static uint32_t
+_wd_emu_fill(wd_emu_slot_t* es)
+{
+    uint64_t beats = 0;
+    for (uint32_t si = 0; si < WD_N_PCI_STREAMS; si ++)
+        beats += (FD_VOLATILE_CONST(es->st[si].head_pub) - FD_VOLATILE_CONST(es->st[si].tail)) >> 5;
+    uint64_t pend = FD_VOLATILE_CONST(es->fifo_wr) - FD_VOLATILE_CONST(es->fifo_rd);
+
+    uint32_t fill = 0;
+    fill |= (uint32_t)fd_ulong_min(beats, 0xfff);
+    fill |= (uint32_t)fd_ulong_min(pend,  0x3ff) << 12;
+    /* results are written back synchronously, the DMA buffer is empty */
+    return fill;
+}
+
+static uint32_t
+_wd_emu_read_32(wd_pci_t* pci, uint32_t addr)
+{
+    wd_emu_t*      emu = (wd_emu_t*)pci->dev_ctx;
+    wd_emu_slot_t* es  = emu->slot[pci->slot];
+
+    _wd_emu_delay(emu->mmio_ns);
+
+    /* without a device thread the device advances on fill reads */
+    if ((addr >> 2) == 0x21 && !emu->running)
+        wd_emu_poll(emu);
+
+    switch (addr >> 2)
+    {
+    case 0x11: return (uint32_t)(wd_emu_ts() >>  0);
+    case 0x12: return (uint32_t)(wd_emu_ts() >> 32);
+    case 0x20: return FD_VOLATILE_CONST(es->snap[es->sel % WD_EMU_N_CNTRS]);
+    case 0x21: return _wd_emu_fill(es);
+    default:   return 0;
+    }
+}
+
+static void
+_wd_emu_write_32(wd_pci_t* pci, uint32_t addr, uint32_t v)
+{
+    wd_emu_slot_t* es = _wd_emu_slot(pci);
+    switch (addr >> 2)
+    {
+    case 0x10: es->sel = v; break;
+    case 0x11: FD_VOLATILE(es->send_fails) = v; break;
+    case 0x13: break;
+    case 0x14: es->thr[es->sel & 7] = v; break;
+    case 0x20:
+        if (v == 1)
+        {
+            for (uint32_t ci = 0; ci < WD_EMU_N_CNTRS; ci ++)
+                FD_VOLATILE(es->cntr[ci]) = 0;
+        }
+        else if (v == 2)
+        {
+            for (uint32_t ci = 0; ci < WD_EMU_N_CNTRS; ci ++)
+                FD_VOLATILE(es->snap[ci]) = FD_VOLATILE_CONST(es->cntr[ci]);
+        }
+        break;
+    default: break;
+    }
+}
+
+static void
+_wd_emu_flush(wd_pci_t* pci, uint32_t si)
+{
+    wd_emu_st_t* st = &_wd_emu_slot(pci)->st[si];
+    _mm_sfence();
+    FD_VOLATILE(st->head_pub) = st->head;
+}
+
+static void
+_wd_emu_write_256(wd_pci_t* pci, uint64_t off, __m256i v)
+{
+    wd_emu_t*      emu = (wd_emu_t*)pci->dev_ctx;
+    wd_emu_slot_t* es  = emu->slot[pci->slot];
+    uint32_t       si  = (uint32_t)(off >> 32) - 1;
+    wd_emu_st_t*   st  = &es->st[si];
+
+    /* a full window stalls the writer, like exhausted PCIe credits */
+    if (FD_UNLIKELY(st->head - FD_VOLATILE_CONST(st->tail) >= WD_EMU_STREAM_SZ))
+    {
+        _wd_emu_flush(pci, si);
+        while (st->head - FD_VOLATILE_CONST(st->tail) >= WD_EMU_STREAM_SZ)
+        {
+            if (emu->running)
+                _mm_pause();
+            else
+                wd_emu_poll(emu);
+        }
+    }
+
+    /* beats land in arrival order, as in the card's stream fifo: a
+       handle that starts over at the window base (a new process on a
+       stream another one used) lines up with the device */
+    uint8_t* dst = _wd_emu_win(es, si) + (st->head & (WD_EMU_STREAM_SZ - 1));
+    _mm256_store_si256((__m256i*)dst, v);
+    st->head += 32;
+}
+
+static int
+_wd_emu_set_vdip(wd_pci_t* pci, uint16_t v)
+{
+    wd_emu_slot_t* es = _wd_emu_slot(pci);
+    _wd_emu_delay(((wd_emu_t*)pci->dev_ctx)->mgmt_ns);
+    if ((v & 0xf) == 0xf)
+        FD_VOLATILE(es->vdip[(v >> 4) & 0xf]) = (uint8_t)(v >> 8);
+    else
+    {
+        uint16_t data = (v & 0xf) ? 0 : FD_VOLATILE_CONST(es->vdip[(v >> 4) & 0xf]);
+        FD_VOLATILE(es->vled) = (uint16_t)((v & 0xff) | (data << 8));
+    }
+    return 0;
+}
+
+static int
+_wd_emu_get_vled(wd_pci_t* pci, uint16_t* v)
+{
+    _wd_emu_delay(((wd_emu_t*)pci->dev_ctx)->mgmt_ns);
+    *v = FD_VOLATILE_CONST(_wd_emu_slot(pci)->vled);
+    return 0;
+}
+
+static uint64_t
+_wd_emu_pin_hugepage(void* dev_ctx, void* hp_addr, uint64_t page_sz)
+{
+    wd_emu_t* emu = (wd_emu_t*)dev_ctx;
+
+    /* pinning a page twice returns the same IOVA */
+    for (uint32_t i = 0; i < emu->n_map; i ++)
+        if (emu->map[i].va == (uint8_t*)hp_addr)
+            return emu->map[i].iova;
+
+    if (emu->n_map == WD_DMA_PAGE_MAX)
+        FD_LOG_ERR(("wd_emu: too many pinned pages"));
+
+    uint64_t iova = (emu->iova_next + page_sz - 1) & ~(page_sz - 1);
+    emu->map[emu->n_map++] = (wd_emu_map_t){ iova, (uint8_t*)hp_addr, page_sz };
+    emu->iova_next = iova + page_sz;
+    return iova;
+}
+
+/* host address of the sz bytes at iova, NULL unless one pinned page
+   holds all of them */
+static void*
+_wd_emu_dma_ptr(wd_emu_t* emu, uint64_t iova, uint64_t sz)
+{
+    for (uint32_t i = 0; i < emu->n_map; i ++)
+    {
+        wd_emu_map_t const* m = &emu->map[i];
+        if (iova - m->iova < m->sz && iova - m->iova + sz <= m->sz)
+            return m->va + (iova - m->iova);
+    }
+    return NULL;
+}
+
+wd_dev_t const wd_dev_emu = {
+    .name         = "emu",
+    .attach       = _wd_emu_attach,
+    .detach       = _wd_emu_detach,
+    .read_32      = _wd_emu_read_32,
+    .write_32     = _wd_emu_write_32,
+    .write_256    = _wd_emu_write_256,
+    .flush        = _wd_emu_flush,
+    .set_vdip     = _wd_emu_set_vdip,
+    .get_vled     = _wd_emu_get_vled,
+    .pin_hugepage = _wd_emu_pin_hugepage,
+};
+
+// PPPPPPPPPPPPPPPPP    IIIIIIIIII PPPPPPPPPPPPPPPPP    EEEEEEEEEEEEEEEEEEEEEE
+// P::::::::::::::::P   I::::::::I P::::::::::::::::P   E::::::::::::::::::::E
+// P::::::PPPPPP:::::P  I::::::::I P::::::PPPPPP:::::P  E::::::::::::::::::::E
+// PP:::::P     P:::::P II::::::II PP:::::P     P:::::P EE::::::EEEEEEEEE::::E
+//   P::::P     P:::::P   I::::I     P::::P     P:::::P   E:::::E       EEEEEE
+//   P::::P     P:::::P   I::::I     P::::P     P:::::P   E:::::E
+//   P::::PPPPPP:::::P    I::::I     P::::PPPPPP:::::P    E::::::EEEEEEEEEE
+//   P:::::::::::::PP     I::::I     P:::::::::::::PP     E:::::::::::::::E
+//   P::::PPPPPPPPP       I::::I     P::::PPPPPPPPP       E:::::::::::::::E
+//   P::::P               I::::I     P::::P               E::::::EEEEEEEEEE
+//   P::::P               I::::I     P::::P               E:::::E
+//   P::::P               I::::I     P::::P               E:::::E       EEEEEE
+// PP::::::PP           II::::::II PP::::::PP           EE::::::EEEEEEEE:::::E
+// P::::::::P           I::::::::I P::::::::P           E::::::::::::::::::::E
+// P::::::::P           I::::::::I P::::::::P           E::::::::::::::::::::E
+// PPPPPPPPPP           IIIIIIIIII PPPPPPPPPP           EEEEEEEEEEEEEEEEEEEEEE
+
+/* move every complete request of stream si into the input fifo */
+static uint64_t
+_wd_emu_parse(wd_emu_slot_t* es, uint32_t si)
+{
+    wd_emu_st_t* st   = &es->st[si];
+    uint64_t     head = FD_VOLATILE_CONST(st->head_pub);
+    uint64_t     tail = st->tail;
+    uint64_t     n    = 0;
+
+    while (head - tail >= 32)
+    {
+        if (es->fifo_wr - es->fifo_rd >= WD_EMU_FIFO_DEPTH)
+            break;
+
+        uint32_t hdr[8];
+        _wd_emu_copy(es, si, tail, hdr, 32);
+        if (hdr[0] != WD_PCI_MAGIC)
+        {
+            /* out of sync, drop beats until the next header */
+            es->cntr[WD_CNTR_INPUT_DROPS] ++;
+            tail += 32;
+            continue;
+        }
+
+        uint64_t sz    = (uint64_t)(hdr[1] >> 16) - 64;
+        uint64_t nb    = (sz + 31) >> 5;
+        uint64_t beats = 4 + nb + (nb & 1);
+        if (head - tail < beats * 32)
+            break;
+
+        es->cntr[WD_CNTR_INPUT_COUNT] ++;
+        if (sz > WD_EMU_MSG_MAX)
+        {
+            es->cntr[WD_CNTR_INPUT_DROPS] ++;
+            tail += beats * 32;
+            continue;
+        }
+
+        wd_emu_req_t* req = &es->fifo[es->fifo_wr % WD_EMU_FIFO_DEPTH];
+        memcpy(req->hdr, hdr, 32);
+        _wd_emu_copy(es, si, tail + 32,  req->sig, 64);
+        _wd_emu_copy(es, si, tail + 96,  req->pub, 32);
+        _wd_emu_copy(es, si, tail + 128, req->msg, sz);
+        req->ts = (uint32_t)wd_emu_ts();
+
+        tail += beats * 32;
+        FD_VOLATILE(es->fifo_wr) = es->fifo_wr + 1;
+        n ++;
+    }
+
+    FD_VOLATILE(st->tail) = tail;
+    return n;
+}
+
+static void
+_wd_emu_result(wd_emu_t* emu, wd_emu_slot_t* es, wd_emu_req_t const* req, uint64_t res)
+{
+    uint64_t base = 0, mask = 0;
+    for (uint32_t i = 0; i < 8; i ++)
+    {
+        base |= ((uint64_t)FD_VOLATILE_CONST(es->vdip[i+0])) << (i*8);
+        mask |= ((uint64_t)FD_VOLATILE_CONST(es->vdip[i+8])) << (i*8);
+    }
+    if (!base)
+    {
+        es->cntr[WD_CNTR_RESULT_DROPS] ++;
+        return;
+    }
+
+    uint64_t dma_addr = ((uint64_t)req->hdr[4] << 32) | req->hdr[3];
+    uint64_t seq      = ((uint64_t)req->hdr[6] << 32) | req->hdr[5];
+    fd_frag_meta_t* meta = _wd_emu_dma_ptr(emu, base + (dma_addr & mask), sizeof(fd_frag_meta_t));
+    if (!meta)
+    {
+        es->cntr[WD_CNTR_RESULT_DROPS] ++;
+        return;
+    }
+
+    /* same publication order as fd_mcache_publish */
+    FD_COMPILER_MFENCE();
+    FD_VOLATILE(meta->seq) = fd_seq_dec(seq, 1UL);
+    FD_COMPILER_MFENCE();
+    meta->sig    = res;
+    meta->chunk  = req->hdr[7];
+    meta->sz     = (ushort)(req->hdr[2] & 0xffff);
+    meta->ctl    = (ushort)(req->hdr[2] >> 16);
+    meta->tsorig = req->ts;
+    meta->tspub  = (uint32_t)wd_emu_ts();
+    FD_COMPILER_MFENCE();
+    FD_VOLATILE(meta->seq) = seq;
+    FD_COMPILER_MFENCE();
+
+    es->cntr[WD_CNTR_RESULT_DMA] ++;
+}
+
+/* xorshift64 */
+static inline uint64_t
+_wd_emu_rand(wd_emu_t* emu)
+{
+    uint64_t x = emu->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    emu->rng = x;
+    return x;
+}
+
+/* WD_EMU_SHUFFLE: swap the request at the head of the fifo with one of
+   the next WD_EMU_SHUFFLE_SPAN pending */
+static void
+_wd_emu_shuffle(wd_emu_t* emu, wd_emu_slot_t* es)
+{
+    uint64_t span = es->fifo_wr - es->fifo_rd;
+    if (span > WD_EMU_SHUFFLE_SPAN)
+        span = WD_EMU_SHUFFLE_SPAN;
+
+    uint64_t j = _wd_emu_rand(emu) % span;
+    if (!j)
+        return;
+    wd_emu_req_t  tmp;
+    wd_emu_req_t* a = &es->fifo[ es->fifo_rd      % WD_EMU_FIFO_DEPTH];
+    wd_emu_req_t* b = &es->fifo[(es->fifo_rd + j) % WD_EMU_FIFO_DEPTH];
+    tmp = *a;
+    *a  = *b;
+    *b  = tmp;
+}
+
+/* verify up to burst requests from the input fifo */
+static uint64_t
+_wd_emu_verify(wd_emu_t* emu, wd_emu_slot_t* es, uint64_t burst)
+{
+    uint64_t n = 0;
+    while (n < burst && es->fifo_rd != es->fifo_wr)
+    {
+        if (emu->flags & WD_EMU_SHUFFLE)
+            _wd_emu_shuffle(emu, es);
+        wd_emu_req_t const* req = &es->fifo[es->fifo_rd % WD_EMU_FIFO_DEPTH];
+        uint64_t sz = (uint64_t)(req->hdr[1] >> 16) - 64;
+
+        es->cntr[WD_CNTR_PAD_IN] ++;
+        es->cntr[WD_CNTR_PAD_OUT] ++;
+        es->cntr[WD_CNTR_SHA_OUT] ++;
+        es->cntr[WD_CNTR_SV0_OUT] ++;
+
+        int ok = 1;
+        if (!(emu->flags & WD_EMU_NO_VERIFY))
+            ok = fd_ed25519_verify(req->msg, sz, req->sig, req->pub, (fd_sha512_t*)emu->sha) == FD_ED25519_SUCCESS;
+
+        if (!ok)
+            es->cntr[WD_CNTR_SV2_F] ++;
+        es->cntr[WD_CNTR_SV2_OUT] ++;
+        es->cntr[WD_CNTR_ECC_OUT] ++;
+        es->cntr[WD_CNTR_RESULT_COUNT] ++;
+
+        if (emu->drop_ppm && _wd_emu_rand(emu) % 1000000 < emu->drop_ppm)
+            es->cntr[WD_CNTR_RESULT_DROPS] ++;
+        else if (ok || FD_VOLATILE_CONST(es->send_fails))
+            _wd_emu_result(emu, es, req, ok ? WD_ED25519_RES_PASS : WD_ED25519_RES_FAIL);
+
+        FD_VOLATILE(es->fifo_rd) = es->fifo_rd + 1;
+        n ++;
+    }
+    return n;
+}
+
+uint64_t wd_emu_poll(wd_emu_t* emu)
+{
+    /* one device pass at a time, whoever drives it */
+    if (__atomic_exchange_n(&emu->polling, 1, __ATOMIC_ACQUIRE))
+        return 0;
+
+    uint64_t n = 0;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+    {
+        wd_emu_slot_t* es = FD_VOLATILE_CONST(emu->slot[slot]);
+        if (!es)
+            continue;
+        for (uint32_t si = 0; si < WD_N_PCI_STREAMS; si ++)
+        {
+            uint64_t head = FD_VOLATILE_CONST(es->st[si].head_pub);
+            if (head == es->st[si].tail)
+                continue;
+            if (emu->flags & WD_EMU_SINK)
+                FD_VOLATILE(es->st[si].tail) = head;
+            else
+                n += _wd_emu_parse(es, si);
+        }
+        n += _wd_emu_verify(emu, es, emu->burst[slot] ? emu->burst[slot] : WD_EMU_VERIFY_BURST);
+        es->cntr[WD_CNTR_INPUT_FILL]  = (uint32_t)(es->fifo_wr - es->fifo_rd);
+        es->cntr[WD_CNTR_RESULT_FILL] = 0;
+    }
+
+    __atomic_store_n(&emu->polling, 0, __ATOMIC_RELEASE);
+    return n;
+}
+
+static void* _wd_emu_main(void* arg)
+{
+    wd_emu_t* emu = (wd_emu_t*)arg;
+    while (FD_VOLATILE_CONST(emu->running))
+    {
+        if (!wd_emu_poll(emu))
+            _mm_pause();
+    }
+    return NULL;
+}
+
+int wd_emu_init(wd_emu_t* emu, uint32_t flags)
+{
+    memset(emu, 0, sizeof(*emu));
+    emu->flags     = flags;
+    emu->iova_next = WD_EMU_IOVA_BASE;
+    emu->rng       = 0x9e3779b97f4a7c15UL;
+
+    void* sha;
+    if (posix_memalign(&sha, FD_SHA512_ALIGN, FD_SHA512_FOOTPRINT))
+        return -1;
+    emu->sha = fd_sha512_join(fd_sha512_new(sha));
+    return 0;
+}
+
+void wd_emu_free(wd_emu_t* emu)
+{
+    wd_emu_stop(emu);
+    free(emu->sha);
+    emu->sha = NULL;
+}
+
+int wd_emu_start(wd_emu_t* emu)
+{
+    if (emu->running)
+        return 0;
+    emu->running = 1;
+    if (pthread_create(&emu->thread, NULL, _wd_emu_main, emu))
+    {
+        emu->running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void wd_emu_stop(wd_emu_t* emu)
+{
+    if (!emu->running)
+        return;
+    FD_VOLATILE(emu->running) = 0;
+    pthread_join(emu->thread, NULL);
+}
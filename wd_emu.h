@@ -0,0 +1,164 @@
+#ifndef HEADER_fd_src_wiredancer_wd_emu_h
+#define HEADER_fd_src_wiredancer_wd_emu_h
+
+#include <pthread.h>
+
+#include "wd_f1.h"
+
+/* Software model of the Wiredancer ED25519 pipeline.  It plugs in as a
+   wd_dev_t, so everything above _wd_read_32/_wd_write_32/_wd_write_256
+   runs unmodified:
+
+     wd_emu_t emu;
+     wd_emu_init (&emu, 0);
+     wd_emu_start(&emu);
+     wd_init_dev (&wd, slots, &wd_dev_emu, &emu);
+
+   Each attached slot gets a shared-memory "BAR4" with one window per
+   wd_pci_st_t stream.  Beats become visible to the device on flush.
+   The device side (wd_emu_poll, or the thread started by wd_emu_start)
+   parses WD_PCI_MAGIC requests out of those windows into an input
+   fifo, verifies the signature in software and writes the result line
+   to the mcache address programmed through vDIP 0/1.  The fill register
+   (0x21), the pipeline counters (0x10/0x20), send_fails (0x11) and the
+   device timestamp (0x11/0x12) follow the hardware register map.  vDIP
+   commands other than register writes (function 0xf) are vLED queries:
+   vLED echoes function and select, with vDIP register byte select as
+   data for function 0.
+   pin_hugepage stands in for /dev/wd_dma: pages get IOVAs from their
+   own address space (from WD_EMU_IOVA_BASE, each aligned to its page
+   size, handed out in pin order) and the device translates result
+   writes through that table, so a wrong IOVA from the host shows up
+   as a result drop rather than going unnoticed.
+   A slot's registers and stream state are shared memory too: processes
+   forked after the slot is attached (see wd_shm.h) submit to the same
+   device, which runs in the process that started it (wd_emu_start).
+   A slot keeps its registers and vDIP bytes when detached, as a card
+   does when the host process restarts; wd_emu_init starts from a card
+   that has never been programmed. */
+
+#define WD_EMU_STREAM_SZ        (1UL << 20)     /* == wd_pci_st_t.m     */
+#define WD_EMU_FIFO_DEPTH       1024            /* input fifo entries   */
+#define WD_EMU_MSG_MAX          2048            /* larger msgs dropped  */
+#define WD_EMU_N_CNTRS          32
+#define WD_EMU_IOVA_BASE        (1UL << 40)
+
+/* wd_emu_init flags */
+#define WD_EMU_NO_VERIFY        (1U << 0)       /* every request passes */
+#define WD_EMU_SINK             (1U << 1)       /* discard the stream   */
+#define WD_EMU_SHUFFLE          (1U << 2)       /* complete out of order */
+
+/* with WD_EMU_SHUFFLE, each request is verified in place of one picked
+   at random among the next WD_EMU_SHUFFLE_SPAN pending in its slot's
+   fifo, so results come back in an order no real pipeline keeps to */
+#define WD_EMU_SHUFFLE_SPAN     64
+
+typedef struct {
+
+    uint32_t            hdr[8];
+    uint8_t             sig[64];
+    uint8_t             pub[32];
+    uint8_t             msg[WD_EMU_MSG_MAX];
+    uint32_t            ts;
+
+} wd_emu_req_t;
+
+typedef struct {
+
+    /* written by the host on every beat */
+    uint64_t            head            __attribute__((aligned(64)));
+    /* written by the host on flush, read by the device */
+    uint64_t            head_pub        __attribute__((aligned(64)));
+    /* written by the device */
+    uint64_t            tail            __attribute__((aligned(64)));
+
+} wd_emu_st_t;
+
+typedef struct {
+
+    uint8_t *           bar4;           /* WD_N_PCI_STREAMS windows   */
+    wd_emu_st_t         st[WD_N_PCI_STREAMS];
+
+    /* host visible registers */
+    uint32_t            sel;
+    uint32_t            thr[8];
+    uint32_t            send_fails;
+    uint8_t             vdip[16];
+    uint16_t            vled;
+    uint32_t            cntr[WD_EMU_N_CNTRS];
+    uint32_t            snap[WD_EMU_N_CNTRS];
+
+    /* input fifo, device private */
+    wd_emu_req_t *      fifo;
+    uint64_t            fifo_wr;
+    uint64_t            fifo_rd;
+
+} wd_emu_slot_t;
+
+typedef struct {
+
+    uint64_t            iova;
+    uint8_t *           va;
+    uint64_t            sz;
+
+} wd_emu_map_t;
+
+/* what a card keeps across host process restarts */
+typedef struct {
+
+    uint32_t            thr[8];
+    uint32_t            send_fails;
+    uint8_t             vdip[16];
+
+} wd_emu_cfg_t;
+
+typedef struct {
+
+    uint32_t            flags;
+    wd_emu_slot_t *     slot[WD_N_PCI_SLOTS];
+    wd_emu_cfg_t        cfg[WD_N_PCI_SLOTS];    /* of detached slots   */
+    /* injected latency, for bring-up: every attach, every register
+       read and every vDIP/vLED access takes this long.  The caller
+       sleeps, so slots brought up on threads of their own overlap as
+       they do on hardware. */
+    uint64_t            attach_ns;
+    uint64_t            mmio_ns;
+    uint64_t            mgmt_ns;
+    /* requests each slot verifies per pass, 0 for the default
+       burst; lower it to model a slower card */
+    uint32_t            burst[WD_N_PCI_SLOTS];
+    /* requests per million verified and then lost, as a card that
+       drops results does (counted in result drops) */
+    uint32_t            drop_ppm;
+    void *              sha;
+    uint64_t            rng;            /* shuffle and drop picks      */
+
+    /* IOMMU */
+    wd_emu_map_t        map[WD_DMA_PAGE_MAX];
+    uint32_t            n_map;
+    uint64_t            iova_next;
+
+    pthread_t           thread;
+    volatile int        running;
+    int                 polling;
+
+} wd_emu_t;
+
+extern wd_dev_t const   wd_dev_emu;
+
+int                     wd_emu_init     (wd_emu_t* emu, uint32_t flags);
+void                    wd_emu_free     (wd_emu_t* emu);
+
+/* wd_emu_poll runs one pass of the device model over every attached
+   slot and returns the number of requests it moved forward.
+   wd_emu_start/wd_emu_stop run it on a background thread instead.
+   Without the thread, the host drives the device implicitly: every
+   fill register read and every write into a full window does a pass. */
+uint64_t                wd_emu_poll     (wd_emu_t* emu);
+int                     wd_emu_start    (wd_emu_t* emu);
+void                    wd_emu_stop     (wd_emu_t* emu);
+
+/* wd_emu_ts returns the emulated device clock (250 MHz ticks). */
+uint64_t                wd_emu_ts       (void);
+
+#endif
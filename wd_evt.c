@@ -0,0 +1,168 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+
+#include "wd_evt.h"
+
+/* the calling thread's ring of the last log it wrote to; the
+   generation tells a log from one initialized later at the same
+   address */
+static __thread wd_evt_t *      _wd_evt_tls_evt;
+static __thread uint64_t        _wd_evt_tls_gen;
+static __thread wd_evt_ring_t * _wd_evt_tls_ring;
+
+static uint64_t                 _wd_evt_gen;
+
+// EEEEEEEEEEEEEEEEEEEEEE VVVVVVVV           VVVVVVVV TTTTTTTTTTTTTTTTTTTTTTT
+// E::::::::::::::::::::E V::::::V           V::::::V T:::::::::::::::::::::T
+// E::::::::::::::::::::E V::::::V           V::::::V T:::::::::::::::::::::T
+// EE::::::EEEEEEEEE::::E V::::::V           V::::::V T:::::TT:::::::TT:::::T
+//   E:::::E       EEEEEE  V:::::V           V:::::V  TTTTTT  T:::::T  TTTTTT
+//   E:::::E                V:::::V         V:::::V           T:::::T
+//   E::::::EEEEEEEEEE       V:::::V       V:::::V            T:::::T
+//   E:::::::::::::::E        V:::::V     V:::::V             T:::::T
+//   E:::::::::::::::E         V:::::V   V:::::V              T:::::T
+//   E::::::EEEEEEEEEE          V:::::V V:::::V               T:::::T
+//   E:::::E                     V:::::V:::::V                T:::::T
+//   E:::::E       EEEEEE         V:::::::::V                 T:::::T
+// EE::::::EEEEEEEE:::::E          V:::::::V                TT:::::::TT
+// E::::::::::::::::::::E           V:::::V                 T:::::::::T
+// E::::::::::::::::::::E            V:::V                  T:::::::::T
+// EEEEEEEEEEEEEEEEEEEEEE             VVV                   TTTTTTTTTTT
+
+int wd_evt_init(wd_evt_t* evt, uint64_t depth)
+{
+    if (!depth || (depth & (depth - 1)))
+        return -1;
+
+    memset(evt, 0, sizeof(*evt));
+    evt->depth  = depth;
+    evt->tsc_hz = wd_tsc_hz();
+    evt->gen    = __atomic_add_fetch(&_wd_evt_gen, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void wd_evt_free(wd_evt_t* evt)
+{
+    for (uint32_t i = 0; i < evt->n_ring && i < WD_EVT_RING_MAX; i ++)
+    {
+        if (!evt->ring[i])
+            continue;
+        free(evt->ring[i]->rec);
+        free(evt->ring[i]);
+        evt->ring[i] = NULL;
+    }
+    evt->n_ring = 0;
+}
+
+wd_evt_ring_t* wd_evt_ring(wd_evt_t* evt)
+{
+    if (FD_LIKELY(_wd_evt_tls_evt == evt && _wd_evt_tls_gen == evt->gen))
+        return _wd_evt_tls_ring;
+
+    int32_t tid = (int32_t)syscall(SYS_gettid);
+
+    // a ring this thread registered before it wrote to another log
+    uint32_t n = __atomic_load_n(&evt->n_ring, __ATOMIC_ACQUIRE);
+    wd_evt_ring_t * r = NULL;
+    for (uint32_t i = 0; i < n && i < WD_EVT_RING_MAX && !r; i ++)
+    {
+        wd_evt_ring_t * ri = __atomic_load_n(&evt->ring[i], __ATOMIC_ACQUIRE);
+        if (ri && ri->tid == tid)
+            r = ri;
+    }
+
+    if (!r)
+    {
+        uint32_t i = __atomic_fetch_add(&evt->n_ring, 1, __ATOMIC_ACQ_REL);
+        if (i >= WD_EVT_RING_MAX)
+        {
+            __atomic_fetch_add(&evt->n_nothr, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        r = aligned_alloc(64, sizeof(wd_evt_ring_t));
+        if (r)
+        {
+            memset(r, 0, sizeof(*r));
+            r->mask = evt->depth - 1;
+            r->tid  = tid;
+            r->rec  = aligned_alloc(64, evt->depth * sizeof(wd_evt_rec_t));
+            if (!r->rec)
+            {
+                free(r);
+                r = NULL;
+            }
+        }
+        // the index stays taken, a NULL slot is skipped
+        __atomic_store_n(&evt->ring[i], r, __ATOMIC_RELEASE);
+        if (!r)
+            return NULL;
+    }
+
+    _wd_evt_tls_evt  = evt;
+    _wd_evt_tls_gen  = evt->gen;
+    _wd_evt_tls_ring = r;
+    return r;
+}
+
+int wd_evt_dump(wd_evt_t* evt, char const* path)
+{
+    FILE * f = fopen(path, "wb");
+    if (!f)
+        return -1;
+
+    uint32_t n_ring = __atomic_load_n(&evt->n_ring, __ATOMIC_ACQUIRE);
+    if (n_ring > WD_EVT_RING_MAX)
+        n_ring = WD_EVT_RING_MAX;
+
+    wd_evt_ring_t * ring[WD_EVT_RING_MAX];
+    wd_evt_file_t   fh = { 0 };
+    fh.magic  = WD_EVT_MAGIC;
+    fh.tsc_hz = evt->tsc_hz;
+    for (uint32_t i = 0; i < n_ring; i ++)
+    {
+        ring[i]    = __atomic_load_n(&evt->ring[i], __ATOMIC_ACQUIRE);
+        fh.n_ring += !!ring[i];
+    }
+    int ok = fwrite(&fh, sizeof(fh), 1, f) == 1;
+
+    wd_evt_rec_t * tmp = aligned_alloc(64, evt->depth * sizeof(wd_evt_rec_t));
+    ok &= !!tmp;
+    for (uint32_t i = 0; ok && i < n_ring; i ++)
+    {
+        wd_evt_ring_t * r = ring[i];
+        if (!r)
+            continue;
+
+        // copy the last depth records, then drop the ones the writer
+        // lapped meanwhile
+        uint64_t n1 = __atomic_load_n(&r->n, __ATOMIC_ACQUIRE);
+        uint64_t lo = n1 > evt->depth ? n1 - evt->depth : 0;
+        for (uint64_t k = lo; k < n1; k ++)
+            tmp[k - lo] = r->rec[k & r->mask];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // index k was overwritten once k + depth was being written,
+        // and n2 may be being written now
+        uint64_t n2    = __atomic_load_n(&r->n, __ATOMIC_ACQUIRE);
+        uint64_t first = n2 + 1 > evt->depth ? n2 + 1 - evt->depth : 0;
+        uint64_t skip  = first > lo ? first - lo : 0;
+        if (skip > n1 - lo)
+            skip = n1 - lo;
+
+        wd_evt_file_ring_t rh = { 0 };
+        rh.n   = n1;
+        rh.cnt = n1 - lo - skip;
+        rh.tid = r->tid;
+        ok &= fwrite(&rh, sizeof(rh), 1, f) == 1;
+        if (rh.cnt)
+            ok &= fwrite(tmp + skip, sizeof(wd_evt_rec_t), rh.cnt, f) == rh.cnt;
+    }
+    free(tmp);
+
+    ok &= !fclose(f);
+    return ok ? 0 : -1;
+}
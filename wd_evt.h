@@ -0,0 +1,138 @@
+#ifndef HEADER_fd_src_wiredancer_wd_evt_h
+#define HEADER_fd_src_wiredancer_wd_evt_h
+
+#include <x86intrin.h>
+
+#include "wd_f1.h"
+
+/* Request lifecycle events.  Counters tell how much, not which request
+   waited where: with an event log on the workspace, every thread that
+   submits or polls through it appends fixed-size binary records to a
+   ring of its own, stamped with the TSC:
+
+     wd_evt_t evt;
+     wd_evt_init(&evt, 1UL << 16);             // records per thread
+     wd_ed25519_verify_evt(&wd, &evt);
+     ...
+     wd_ed25519_verify_evt(&wd, NULL);
+     wd_evt_dump(&evt, "run.wde");             // wd_evt2json run.wde
+     wd_evt_free(&evt);
+
+   A request shows up as the submit call (WD_EVT_REQ), the backpressure
+   wait inside it if there was one (WD_EVT_WAIT, with the slot it ended
+   on), the beats streamed to the slot it chose (WD_EVT_SEND), the fence
+   after them (WD_EVT_FENCE), or the host path that took it instead
+   (WD_EVT_HOST), and the completion seen by the poller (WD_EVT_DONE).
+   wd_ed25519_verify_req_batch logs a run as one SEND and one FENCE.
+   A ring is registered on a thread's first event, up to
+   WD_EVT_RING_MAX threads (later ones are counted in n_nothr and not
+   logged), and only that thread writes it, so appending is a 32-byte
+   store and a release store of the count, no atomics.  A full ring
+   overwrites its oldest records: the dump holds each thread's last
+   depth events.
+   Without an event log the submit path is compiled once without any of
+   it and costs one predictable branch; the poller pays one per
+   completion. */
+
+#define WD_EVT_MAGIC            0x57445f4556543031UL    /* "WD_EVT01" */
+#define WD_EVT_RING_MAX         64              /* threads          */
+#define WD_EVT_SLOT_NONE        0xff
+
+/* record types */
+#define WD_EVT_REQ              1       /* submit call, arg: msg size       */
+#define WD_EVT_WAIT             2       /* backpressure, arg: 0 or errno    */
+#define WD_EVT_SEND             3       /* beats streamed, arg: beats       */
+#define WD_EVT_FENCE            4       /* write-combining flush            */
+#define WD_EVT_HOST             5       /* arg: 0 cache hit, 1 CPU spill    */
+#define WD_EVT_DONE             6       /* result seen, arg: WD_ED25519_RES_* */
+
+typedef struct {
+
+    uint64_t            tsc;            /* start                       */
+    uint64_t            dur;            /* TSC cycles, 0: instant      */
+    uint64_t            seq;            /* m_seq, the first of a run   */
+    uint32_t            arg;
+    uint8_t             type;           /* WD_EVT_*                    */
+    uint8_t             slot;           /* WD_EVT_SLOT_NONE: none      */
+    uint16_t            cnt;            /* requests, 1 but for runs    */
+
+} __attribute__((aligned(32))) wd_evt_rec_t;
+
+typedef struct {
+
+    wd_evt_rec_t *      rec;
+    uint64_t            mask;
+    int32_t             tid;
+    /* written by the owning thread only */
+    uint64_t            n               __attribute__((aligned(64)));
+
+} wd_evt_ring_t;
+
+struct wd_evt {
+
+    uint64_t            depth;          /* records per ring, power of 2 */
+    double              tsc_hz;
+    uint64_t            gen;            /* unique per wd_evt_init      */
+    wd_evt_ring_t *     ring[WD_EVT_RING_MAX];
+    uint32_t            n_ring;
+    uint32_t            n_nothr;        /* threads past WD_EVT_RING_MAX */
+
+};
+
+/* dump file: a wd_evt_file_t, then per ring a wd_evt_file_ring_t and
+   its cnt records, oldest first */
+typedef struct {
+
+    uint64_t            magic;
+    double              tsc_hz;
+    uint32_t            n_ring;
+    uint32_t            _pad[11];
+
+} wd_evt_file_t;
+
+typedef struct {
+
+    uint64_t            n;              /* ever written                */
+    uint64_t            cnt;            /* records that follow         */
+    int32_t             tid;
+    uint32_t            _pad[3];
+
+} wd_evt_file_ring_t;
+
+/* wd_evt_init sets up for depth (a power of 2) records per thread and
+   calibrates the TSC (10 ms) for the dump.  Returns -1 on failure.
+   wd_evt_free frees the rings; remove the log from the workspace and
+   stop its threads first. */
+int                     wd_evt_init     (wd_evt_t* evt, uint64_t depth);
+void                    wd_evt_free     (wd_evt_t* evt);
+
+/* wd_evt_ring returns the calling thread's ring, registering one on the
+   first call.  NULL if WD_EVT_RING_MAX threads already have one or the
+   ring could not be allocated. */
+wd_evt_ring_t *         wd_evt_ring     (wd_evt_t* evt);
+
+/* wd_evt_dump writes every ring to path.  Threads may still be logging:
+   records they overwrite while the dump copies are left out.  Returns
+   -1 on failure. */
+int                     wd_evt_dump     (wd_evt_t* evt, char const* path);
+
+/* append one record, see wd_evt_ring */
+static inline void
+wd_evt_add( wd_evt_ring_t *  r,
+            uint8_t          type,
+            uint32_t         slot,
+            uint64_t         seq,
+            uint64_t         tsc,
+            uint64_t         dur,
+            uint32_t         arg,
+            uint16_t         cnt)
+{
+    uint64_t n = r->n;
+    _mm256_store_si256((__m256i*)(r->rec + (n & r->mask)),
+                       _mm256_setr_epi64x((long)tsc, (long)dur, (long)seq,
+                                          (long)((uint64_t)arg | (uint64_t)type << 32 |
+                                                 (uint64_t)(slot & 0xff) << 40 | (uint64_t)cnt << 48)));
+    __atomic_store_n(&r->n, n + 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,260 @@
+/* wd_evt2json.c – convert a wd_evt_dump file to Chrome trace JSON, for
+   chrome://tracing or ui.perfetto.dev */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "wd_evt.h"
+
+/* -------------- load --------------------------------------------------- */
+
+typedef struct {
+    wd_evt_file_ring_t  hdr;
+    wd_evt_rec_t       *rec;
+} ring_t;
+
+/* first submit of each m_seq, to pair completions with */
+typedef struct {
+    uint64_t seq;
+    uint64_t tsc;
+    uint32_t slot;
+    uint32_t done;
+} req_t;
+
+static int req_cmp(void const *_a, void const *_b) {
+    req_t const *a = _a, *b = _b;
+    if (a->seq != b->seq) return a->seq < b->seq ? -1 : 1;
+    return a->tsc < b->tsc ? -1 : a->tsc > b->tsc;
+}
+
+static req_t *req_find(req_t *req, uint64_t n, uint64_t seq) {
+    uint64_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (req[mid].seq < seq) lo = mid + 1;
+        else                    hi = mid;
+    }
+    return lo < n && req[lo].seq == seq ? &req[lo] : NULL;
+}
+
+static ring_t *load(char const *path, wd_evt_file_t *fh) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    if (fread(fh, sizeof(*fh), 1, f) != 1 || fh->magic != WD_EVT_MAGIC) {
+        fprintf(stderr, "%s: not an event dump\n", path);
+        fclose(f);
+        return NULL;
+    }
+    ring_t *ring = calloc(fh->n_ring ? fh->n_ring : 1, sizeof(ring_t));
+    for (uint32_t i = 0; i < fh->n_ring; i++) {
+        ring_t *r = &ring[i];
+        if (fread(&r->hdr, sizeof(r->hdr), 1, f) != 1)
+            goto trunc;
+        r->rec = aligned_alloc(64, (r->hdr.cnt ? r->hdr.cnt : 1) * sizeof(wd_evt_rec_t));
+        if (!r->rec) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        if (fread(r->rec, sizeof(wd_evt_rec_t), r->hdr.cnt, f) != r->hdr.cnt)
+            goto trunc;
+    }
+    fclose(f);
+    return ring;
+
+trunc:
+    fprintf(stderr, "%s: truncated\n", path);
+    fclose(f);
+    return NULL;
+}
+
+/* -------------- json --------------------------------------------------- */
+
+static FILE      *out;
+static double     us_per_tsc;
+static uint64_t   tsc0;
+static int        first = 1;
+
+static void ev_begin(char const *ph, char const *name, int pid, long tid, uint64_t tsc) {
+    fprintf(out, "%s\n{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%ld,\"ts\":%.3f",
+            first ? "" : ",", ph, name, pid, tid, (double)(tsc - tsc0) * us_per_tsc);
+    first = 0;
+}
+
+static void ev_dur(uint64_t dur) {
+    fprintf(out, ",\"dur\":%.3f", (double)dur * us_per_tsc);
+}
+
+static void meta(char const *what, int pid, long tid, char const *name) {
+    fprintf(out, "%s\n{\"ph\":\"M\",\"name\":\"%s\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",", what, pid, tid, name);
+    first = 0;
+}
+
+static char const *res_name(uint32_t res) {
+    switch (res) {
+    case WD_ED25519_RES_PASS: return "pass";
+    case WD_ED25519_RES_FAIL: return "fail";
+    case WD_ED25519_RES_LOST: return "lost";
+    default:                  return "?";
+    }
+}
+
+static char const *err_name(uint32_t err) {
+    return !err ? "ok" : err == EAGAIN ? "EAGAIN" : err == ETIMEDOUT ? "ETIMEDOUT" : "?";
+}
+
+/* the track of a slot's in-flight requests */
+static void slot_name(char *buf, size_t sz, uint32_t slot) {
+    if (slot == WD_EVT_SLOT_NONE) snprintf(buf, sz, "host");
+    else                          snprintf(buf, sz, "slot %u", slot);
+}
+
+/* pid 1 has a track per thread that logged, pid 2 one per slot (and
+   one for requests the cache or the CPU pool took): beats sent to it,
+   and each request from its submit to its completion as an async
+   slice */
+static void convert(wd_evt_file_t const *fh, ring_t *ring) {
+    uint64_t n_req = 0, n_rec = 0;
+    uint32_t slots = 0;
+    tsc0 = UINT64_MAX;
+    for (uint32_t i = 0; i < fh->n_ring; i++) {
+        for (uint64_t k = 0; k < ring[i].hdr.cnt; k++) {
+            wd_evt_rec_t const *e = &ring[i].rec[k];
+            if (e->tsc < tsc0) tsc0 = e->tsc;
+            n_req += e->type == WD_EVT_REQ || e->type == WD_EVT_HOST;
+            if (e->slot < 32) slots |= 1U << e->slot;
+        }
+        n_rec += ring[i].hdr.cnt;
+    }
+    us_per_tsc = 1e6 / fh->tsc_hz;
+
+    req_t *req = malloc((n_req ? n_req : 1) * sizeof(req_t));
+    uint64_t m = 0;
+    for (uint32_t i = 0; i < fh->n_ring; i++)
+        for (uint64_t k = 0; k < ring[i].hdr.cnt; k++) {
+            wd_evt_rec_t const *e = &ring[i].rec[k];
+            if (e->type == WD_EVT_REQ || e->type == WD_EVT_HOST)
+                req[m++] = (req_t){ e->seq, e->tsc, e->slot, 0 };
+        }
+    qsort(req, m, sizeof(req_t), req_cmp);
+    /* a resubmit starts no second slice */
+    uint64_t n_uniq = 0;
+    for (uint64_t k = 0; k < m; k++)
+        if (!n_uniq || req[k].seq != req[n_uniq - 1].seq)
+            req[n_uniq++] = req[k];
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    meta("process_name", 1, 0, "threads");
+    meta("process_name", 2, 0, "slots");
+    char name[32];
+    for (uint32_t i = 0; i < fh->n_ring; i++) {
+        snprintf(name, sizeof(name), "thread %d", ring[i].hdr.tid);
+        meta("thread_name", 1, ring[i].hdr.tid, name);
+    }
+    for (uint32_t slot = 0; slot < 32; slot++)
+        if (slots & (1U << slot)) {
+            slot_name(name, sizeof(name), slot);
+            meta("thread_name", 2, slot, name);
+        }
+    meta("thread_name", 2, WD_EVT_SLOT_NONE, "host");
+
+    for (uint64_t k = 0; k < n_uniq; k++) {
+        slot_name(name, sizeof(name), req[k].slot);
+        ev_begin("b", name, 2, req[k].slot, req[k].tsc);
+        fprintf(out, ",\"cat\":\"req\",\"id\":%lu}", (unsigned long)req[k].seq);
+    }
+
+    uint64_t n_done = 0, n_orphan = 0;
+    for (uint32_t i = 0; i < fh->n_ring; i++) {
+        long tid = ring[i].hdr.tid;
+        for (uint64_t k = 0; k < ring[i].hdr.cnt; k++) {
+            wd_evt_rec_t const *e = &ring[i].rec[k];
+            unsigned long seq = (unsigned long)e->seq;
+            switch (e->type) {
+            case WD_EVT_REQ:
+                ev_begin("X", "req", 1, tid, e->tsc);
+                ev_dur(e->dur);
+                fprintf(out, ",\"args\":{\"seq\":%lu,\"sz\":%u,\"slot\":%u}}", seq, e->arg, e->slot);
+                break;
+            case WD_EVT_WAIT:
+                ev_begin("X", "backpressure", 1, tid, e->tsc);
+                ev_dur(e->dur);
+                fprintf(out, ",\"args\":{\"seq\":%lu,\"slot\":%d,\"err\":\"%s\"}}", seq,
+                        e->slot == WD_EVT_SLOT_NONE ? -1 : (int)e->slot, err_name(e->arg));
+                break;
+            case WD_EVT_SEND:
+                ev_begin("X", "send", 1, tid, e->tsc);
+                ev_dur(e->dur);
+                fprintf(out, ",\"args\":{\"seq\":%lu,\"cnt\":%u,\"beats\":%u,\"slot\":%u}}",
+                        seq, e->cnt, e->arg, e->slot);
+                ev_begin("X", "send", 2, e->slot, e->tsc);
+                ev_dur(e->dur);
+                fprintf(out, ",\"args\":{\"seq\":%lu,\"cnt\":%u,\"beats\":%u,\"thread\":%ld}}",
+                        seq, e->cnt, e->arg, tid);
+                break;
+            case WD_EVT_FENCE:
+                ev_begin("X", "fence", 1, tid, e->tsc);
+                ev_dur(e->dur);
+                fprintf(out, ",\"args\":{\"seq\":%lu,\"slot\":%u}}", seq, e->slot);
+                break;
+            case WD_EVT_HOST:
+                ev_begin("i", e->arg ? "cpu spill" : "cache hit", 1, tid, e->tsc);
+                fprintf(out, ",\"s\":\"t\",\"args\":{\"seq\":%lu}}", seq);
+                break;
+            case WD_EVT_DONE: {
+                ev_begin("i", "done", 1, tid, e->tsc);
+                fprintf(out, ",\"s\":\"t\",\"args\":{\"seq\":%lu,\"res\":\"%s\"}}", seq, res_name(e->arg));
+                req_t *r = req_find(req, n_uniq, e->seq);
+                if (!r || r->done) {
+                    n_orphan++;
+                    break;
+                }
+                r->done = 1;
+                n_done++;
+                slot_name(name, sizeof(name), r->slot);
+                ev_begin("e", name, 2, r->slot, e->tsc < r->tsc ? r->tsc : e->tsc);
+                fprintf(out, ",\"cat\":\"req\",\"id\":%lu,\"args\":{\"res\":\"%s\"}}",
+                        seq, res_name(e->arg));
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    fprintf(stderr, "%u threads, %lu events, %lu requests, %lu completed, %lu never, "
+            "%lu completions without their submit\n",
+            fh->n_ring, (unsigned long)n_rec, (unsigned long)n_uniq, (unsigned long)n_done,
+            (unsigned long)(n_uniq - n_done), (unsigned long)n_orphan);
+    free(req);
+}
+
+/* -------------- main --------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: wd_evt2json DUMP [OUT.json]   (default: stdout)\n");
+        return 1;
+    }
+    wd_evt_file_t fh;
+    ring_t *ring = load(argv[1], &fh);
+    if (!ring)
+        return 1;
+    out = stdout;
+    if (argc == 3 && !(out = fopen(argv[2], "w"))) {
+        perror(argv[2]);
+        return 1;
+    }
+    convert(&fh, ring);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -2,15 +2,31 @@
 #define _DEFAULT_SOURCE
 #endif
 
+#include <x86intrin.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
 #include "wd_f1.h"
+#include "wd_cpu.h"
+#include "wd_cache.h"
+#include "wd_rob.h"
+#include "wd_infl.h"
+#include "wd_trace.h"
+#include "wd_evt.h"
 
 // private functions
 uint32_t            _wd_read_32             (wd_pci_t* pci, uint32_t addr);
 void                _wd_write_32            (wd_pci_t* pci, uint32_t addr, uint32_t v);
-void                _wd_write_256           (wd_pci_t* pci, uint64_t off, void const* buf);
-inline void         _wd_stream_256          (wd_wksp_t* wd, uint32_t slot, void const* buf);
-void                _wd_stream_flush        (wd_wksp_t* wd, uint32_t slot);
-uint32_t            _wd_next_slot           (wd_wksp_t* wd, uint32_t slot);
+void                _wd_write_256           (wd_pci_t* pci, uint64_t off, __m256i v);
+static inline void  _wd_stream_256          (wd_sub_t* sub, uint32_t slot, __m256i v);
+void                _wd_pci_locate          (wd_pci_t* pci, uint16_t domain, uint8_t bus, uint8_t dev, uint8_t func);
+void                _wd_stream_flush        (wd_sub_t* sub, uint32_t slot);
+uint32_t            _wd_next_slot           (uint64_t slots, uint32_t slot);
+int                 _wd_find_slot           (wd_sub_t* sub, uint32_t* slot, uint64_t n_txn);
+int                 _wd_vled_byte           (wd_pci_t* pci, uint32_t func, uint32_t sel, uint8_t* b);
+int                 _wd_slots_par           (wd_wksp_t* wd, uint64_t slots, int (*fn)(wd_wksp_t*, uint32_t, void*), void* arg);
+static inline int64_t _wd_now_ns            (void);
 
 // PPPPPPPPPPPPPPPPP           CCCCCCCCCCCCCIIIIIIIIII
 // P::::::::::::::::P       CCC::::::::::::CI::::::::I
@@ -31,17 +47,38 @@ uint32_t            _wd_next_slot           (wd_wksp_t* wd, uint32_t slot);
 
 int wd_init_pci(wd_wksp_t* wd, uint64_t slots)
 {
-    wd->pci_slots = slots;
+    return wd_init_dev(wd, slots, &wd_dev_f1, NULL);
+}
+
+/* attach one slot and set its streams up */
+static int
+_wd_attach_slot(wd_wksp_t* wd, uint32_t slot, void* arg)
+{
+    (void)arg;
+    wd_pci_t* pci = &wd->pci[slot];
 
-    /* staging buffer must be 32‑byte aligned for AVX stream stores         */
-    void *tmp;
-    if (posix_memalign(&tmp, 32u, 32u)) {
-        perror("posix_memalign");
+    if (pci->dev->attach(pci))
+    {
+        // nothing to detach
+        pci->dev = NULL;
         return -1;
     }
-    wd->stream_buf = (uint32_t *)tmp;
 
-    fpga_mgmt_state.initialized = true;
+    for (uint32_t si = 0; si < WD_N_PCI_STREAMS; si ++)
+    {
+        pci->stream[si].a = 0x0;
+        pci->stream[si].b = 1+si;
+        pci->stream[si].b <<= 32;
+        pci->stream[si].m = (1L << 20);
+    }
+    return 0;
+}
+
+int wd_init_dev(wd_wksp_t* wd, uint64_t slots, wd_dev_t const* dev, void* dev_ctx)
+{
+    wd->pci_slots = slots;
+    wd->dev       = dev;
+    wd->dev_ctx   = dev_ctx;
 
     for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
     {
@@ -50,38 +87,43 @@ int wd_init_pci(wd_wksp_t* wd, uint64_t slots)
         pci->bar0 = PCI_BAR_HANDLE_INIT;
         pci->bar4 = PCI_BAR_HANDLE_INIT;
         pci->bar4_addr = 0;
-
-        fpga_mgmt_state.slots[slot].handle = PCI_BAR_HANDLE_INIT;
+        pci->dev = NULL;
+        pci->trace = NULL;
+        pci->vdip_dirty = 0;
+        pci->vled_cmd = 0xffff;
+        pci->vled_rb = 0;
+        pci->settle_ns = 0;
 
         if ((wd->pci_slots & (1UL<<slot)) == 0)
             continue;
 
-        int rc;
+        pci->dev     = dev;
+        pci->dev_ctx = dev_ctx;
+        pci->slot    = slot;
+        pci->numa_node = -1;
+        CPU_ZERO(&pci->cpus);
+    }
 
-        rc = fpga_pci_attach((int)slot, FPGA_APP_PF, APP_PF_BAR0, 0, &pci->bar0);
-        if (rc)
-        {
-            FD_LOG_ERR(( "Unable to attach to the AFI on slot id %d", slot ));
-            return -1;
-        }
-        rc = fpga_pci_attach((int)slot, FPGA_APP_PF, APP_PF_BAR4, BURST_CAPABLE, &pci->bar4);
-        if (rc)
-        {
-            FD_LOG_ERR (( "Unable to attach to the AFI on slot id %d", slot ));
-            return -1;
-        }
+    /* attaching is mostly waiting on sysfs (the SDK part is serialized)
+       or on the emulated latency, do all at once; on failure the slots
+       that did attach are detached again */
+    if (_wd_slots_par(wd, wd->pci_slots, _wd_attach_slot, NULL))
+    {
+        wd_free_pci(wd);
+        return -1;
+    }
 
-        fpga_pci_get_address(pci->bar4, 0, 1024*1024, (void**)&pci->bar4_addr);
-        assert(((uintptr_t)pci->bar4_addr & 31u)==0 && "BAR4 not 32‑B aligned");
+    memset(&wd->dma, 0, sizeof(wd->dma));
+    wd->cache = NULL;
+    wd->rob   = NULL;
+    wd->infl  = NULL;
+    wd->evt   = NULL;
 
-        for (uint32_t si = 0; si < WD_N_PCI_STREAMS; si ++)
-        {
-            pci->stream[si].a = 0x0;
-            pci->stream[si].b = 1+si;
-            pci->stream[si].b <<= 32;
-            pci->stream[si].m = (1L << 20);
-        }
-    }
+    /* the workspace's own submit path owns stream 0 */
+    memset(wd->st_own, 0, sizeof(wd->st_own));
+    wd->st_owned = wd->st_own;
+    if (wd->pci_slots && wd_sub_init(&wd->sub, wd, 0, wd->pci_slots))
+        return -1;
 
     return 0;
 }
@@ -89,77 +131,213 @@ int wd_init_pci(wd_wksp_t* wd, uint64_t slots)
 int wd_free_pci (wd_wksp_t* wd)
 {
     for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; ++slot) {
-        if (wd->pci[slot].bar0 != PCI_BAR_HANDLE_INIT)
-            fpga_pci_detach(wd->pci[slot].bar0);
-        if (wd->pci[slot].bar4 != PCI_BAR_HANDLE_INIT)
-            fpga_pci_detach(wd->pci[slot].bar4);
+        if (wd->pci[slot].dev)
+            wd->pci[slot].dev->detach(&wd->pci[slot]);
+        wd->pci[slot].dev = NULL;
     }
 
-    free(wd->stream_buf);
-
     return 0;
 }
 
 uint32_t _wd_read_32(wd_pci_t* pci, uint32_t addr)
 {
-    int rc;
-    uint32_t value;
-    rc = fpga_pci_peek(pci->bar0, addr, &value);
-    if (rc)
-        FD_LOG_ERR (("Unable to read from the fpga !" ));
-    return value;
+    return pci->dev->read_32(pci, addr);
 }
 
 void _wd_write_32(wd_pci_t* pci, uint32_t addr, uint32_t v)
 {
-    fpga_pci_poke(pci->bar0, addr, v);
+    pci->dev->write_32(pci, addr, v);
 }
 
-void _wd_write_256(wd_pci_t* pci, uint64_t off, void const* buf)
+void _wd_write_256(wd_pci_t* pci, uint64_t off, __m256i v)
 {
-    uint32_t* data = (uint32_t*)buf;
-    volatile uint32_t* addr = (volatile uint32_t*)pci->bar4_addr;
-    addr += (off >> 2);
-    if (0)
-    {
-        addr[0] = data[0];
-        addr[1] = data[1];
-        addr[2] = data[2];
-        addr[3] = data[3];
-        addr[4] = data[4];
-        addr[5] = data[5];
-        addr[6] = data[6];
-        addr[7] = data[7];
-    } else
-    {
-        __m256i v;
-        assert(((uintptr_t)data & 31u)==0 && "unaligned _wd_write_256()");
-        v = _mm256_load_si256((__m256i const*)data);
-        _mm256_stream_si256((__m256i*)(addr), v);
-    }
+    if (FD_UNLIKELY(pci->trace))
+        _wd_trace_beat(pci->trace, pci->slot, off, v);
+    pci->dev->write_256(pci, off, v);
 }
 
-inline void _wd_stream_256(wd_wksp_t* wd, uint32_t slot, void const* buf)
+static inline void _wd_stream_256(wd_sub_t* sub, uint32_t slot, __m256i v)
 {
-    wd_pci_st_t* pci_st = &wd->pci[slot].stream[0];
-    _wd_write_256(&wd->pci[slot], pci_st->a | pci_st->b, buf);
+    wd_pci_st_t* pci_st = &sub->st[slot];
+    _wd_write_256(&sub->wd->pci[slot], pci_st->a | pci_st->b, v);
     pci_st->a += 32;
     if (pci_st->a == pci_st->m)
     {
-        _wd_stream_flush(wd, slot);
+        _wd_stream_flush(sub, slot);
         pci_st->a = 0;
     }
     else if ((pci_st->a & 0xFC0) == 0xFC0)
     {
-        _wd_stream_flush(wd, slot);
+        _wd_stream_flush(sub, slot);
     }
 }
 
-void _wd_stream_flush(wd_wksp_t* wd, uint32_t slot)
+void _wd_stream_flush(wd_sub_t* sub, uint32_t slot)
 {
-    (void)wd;
-    (void)slot;
-    _mm_sfence();
+    wd_pci_t* pci = &sub->wd->pci[slot];
+    pci->dev->flush(pci, sub->si);
+}
+
+// NNNNNNNN        NNNNNNNN UUUUUUUU     UUUUUUUU MMMMMMMM               MMMMMMMM                AAA
+// N:::::::N       N::::::N U::::::U     U::::::U M:::::::M             M:::::::M               A:::A
+// N::::::::N      N::::::N U::::::U     U::::::U M::::::::M           M::::::::M              A:::::A
+// N:::::::::N     N::::::N UU:::::U     U:::::UU M:::::::::M         M:::::::::M             A:::::::A
+// N::::::::::N    N::::::N  U:::::U     U:::::U  M::::::::::M       M::::::::::M            A:::::::::A
+// N:::::::::::N   N::::::N  U:::::D     D:::::U  M:::::::::::M     M:::::::::::M           A:::::A:::::A
+// N:::::::N::::N  N::::::N  U:::::D     D:::::U  M:::::::M::::M   M::::M:::::::M          A:::::A A:::::A
+// N::::::N N::::N N::::::N  U:::::D     D:::::U  M::::::M M::::M M::::M M::::::M         A:::::A   A:::::A
+// N::::::N  N::::N:::::::N  U:::::D     D:::::U  M::::::M  M::::M::::M  M::::::M        A:::::A     A:::::A
+// N::::::N   N:::::::::::N  U:::::D     D:::::U  M::::::M   M:::::::M   M::::::M       A:::::AAAAAAAAA:::::A
+// N::::::N    N::::::::::N  U:::::D     D:::::U  M::::::M    M:::::M    M::::::M      A:::::::::::::::::::::A
+// N::::::N     N:::::::::N  U::::::U   U::::::U  M::::::M     MMMMM     M::::::M     A:::::AAAAAAAAAAAAA:::::A
+// N::::::N      N::::::::N  U:::::::UUU:::::::U  M::::::M               M::::::M    A:::::A             A:::::A
+// N::::::N       N:::::::N   UU:::::::::::::UU   M::::::M               M::::::M   A:::::A               A:::::A
+// N::::::N        N::::::N     UU:::::::::UU     M::::::M               M::::::M  A:::::A                 A:::::A
+// NNNNNNNN         NNNNNNN       UUUUUUUUU       MMMMMMMM               MMMMMMMM AAAAAAA                   AAAAAAA
+
+#define _WD_MPOL_BIND           2       // <numaif.h>, without libnuma
+
+/* read the first line of a sysfs attribute, 0 on success */
+static int
+_wd_sysfs_read(char const* path, char* buf, ulong sz)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        return -1;
+    char* line = fgets(buf, (int)sz, f);
+    fclose(f);
+    return line ? 0 : -1;
+}
+
+/* parse a cpulist ("0-15,32-47") into set */
+static void
+_wd_cpulist_parse(char const* s, cpu_set_t* set)
+{
+    CPU_ZERO(set);
+    while (*s && *s != '\n')
+    {
+        char* end;
+        ulong lo = strtoul(s, &end, 10);
+        ulong hi = lo;
+        if (end == s)
+            break;
+        if (*end == '-')
+        {
+            s  = end + 1;
+            hi = strtoul(s, &end, 10);
+        }
+        for (ulong c = lo; c <= hi && c < CPU_SETSIZE; c ++)
+            CPU_SET(c, set);
+        s = end;
+        if (*s == ',')
+            s ++;
+    }
+}
+
+/* _wd_pci_locate fills in the NUMA node and local cores of the PCIe
+   function domain:bus:dev.func.  Left unknown when sysfs has no answer
+   (e.g. a single node host reports node -1). */
+void
+_wd_pci_locate(wd_pci_t* pci, uint16_t domain, uint8_t bus, uint8_t dev, uint8_t func)
+{
+    char path[128], buf[1024];
+    int  n = snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/",
+                      domain, bus, dev, func);
+
+    snprintf(path + n, sizeof(path) - (ulong)n, "numa_node");
+    if (!_wd_sysfs_read(path, buf, sizeof(buf)))
+        pci->numa_node = atoi(buf);
+
+    snprintf(path + n, sizeof(path) - (ulong)n, "local_cpulist");
+    if (!_wd_sysfs_read(path, buf, sizeof(buf)))
+        _wd_cpulist_parse(buf, &pci->cpus);
+
+    FD_LOG_INFO(( "slot %u: %04x:%02x:%02x.%x numa node %d, %d local cores",
+                  pci->slot, domain, bus, dev, func, pci->numa_node, CPU_COUNT(&pci->cpus) ));
+}
+
+int wd_slot_node(wd_wksp_t const* wd, uint32_t slot)
+{
+    if (slot >= WD_N_PCI_SLOTS || !(wd->pci_slots & (1UL << slot)))
+        return -1;
+    return wd->pci[slot].numa_node;
+}
+
+int wd_wksp_node(wd_wksp_t const* wd)
+{
+    int node = -1;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+    {
+        if (!(wd->pci_slots & (1UL << slot)))
+            continue;
+        int n = wd->pci[slot].numa_node;
+        if (n < 0 || (node >= 0 && n != node))
+            return -1;
+        node = n;
+    }
+    return node;
+}
+
+int wd_node_cpus(int node, cpu_set_t* cpus)
+{
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if (node < 0 || _wd_sysfs_read(path, buf, sizeof(buf)))
+    {
+        CPU_ZERO(cpus);
+        return -1;
+    }
+    _wd_cpulist_parse(buf, cpus);
+    return CPU_COUNT(cpus);
+}
+
+int wd_slot_cpus(wd_wksp_t const* wd, uint32_t slot, cpu_set_t* cpus)
+{
+    if (wd_slot_node(wd, slot) >= 0 && CPU_COUNT(&wd->pci[slot].cpus))
+    {
+        *cpus = wd->pci[slot].cpus;
+        return CPU_COUNT(cpus);
+    }
+
+    CPU_ZERO(cpus);
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long c = 0; c < n && c < CPU_SETSIZE; c ++)
+        CPU_SET(c, cpus);
+    return CPU_COUNT(cpus);
+}
+
+void* wd_hp_alloc(uint64_t sz, uint64_t page_sz, int node)
+{
+    if (!sz || (sz & (page_sz - 1)))
+        return NULL;
+
+    int huge = page_sz == WD_DMA_PAGE_1G ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+    void* hp = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | huge, -1, 0);
+    if (hp == MAP_FAILED)
+        return NULL;
+
+    // bind before the first touch, which is what places the pages
+    if (node >= 0)
+    {
+        uint64_t mask[16] = { 0 };
+        if ((ulong)node < 64 * 16)
+            mask[node >> 6] = 1UL << (node & 63);
+        if (syscall(SYS_mbind, hp, sz, _WD_MPOL_BIND, mask, 64 * 16 + 1, 0))
+        {
+            munmap(hp, sz);
+            return NULL;
+        }
+    }
+
+    memset(hp, 0, sz);
+    return hp;
+}
+
+void wd_hp_free(void* hp, uint64_t sz)
+{
+    if (hp)
+        munmap(hp, sz);
 }
 
 // MMMMMMMM               MMMMMMMMIIIIIIIIII   SSSSSSSSSSSSSSS         CCCCCCCCCCCCC
@@ -220,35 +398,108 @@ void wd_zprintf(const char* format, ...)
     va_end(argptr);
 }
 
-uint32_t _wd_next_slot(wd_wksp_t* wd, uint32_t slot)
+uint32_t _wd_next_slot(uint64_t slots, uint32_t slot)
 {
     for (int i = 0; i < WD_N_PCI_SLOTS; i ++)
     {
         slot ++;
         if (slot >= WD_N_PCI_SLOTS)
             slot = 0;
-        if (wd->pci_slots & (1UL << slot))
+        if (slots & (1UL << slot))
             break;
     }
     return slot;
 }
 
-int _wd_set_vdip_64(wd_wksp_t* wd, uint32_t slot, uint32_t vi, uint64_t v)
+/* _wd_vled_byte asks for byte sel of vLED function func (a vDIP
+   command with the function in bits 3:0 and the select in 7:4) and
+   waits for vLED to echo both back with the byte.  A query equal to the
+   previous one would be answered by the stale echo, so another select
+   goes first then; the slot remembers its last query, only the first
+   one after attach has to look.  -1 if the device does not answer
+   within WD_VLED_TIMEOUT_NS. */
+int _wd_vled_byte(wd_pci_t* pci, uint32_t func, uint32_t sel, uint8_t* b)
 {
-    (void)wd;
-    for (uint32_t i = 0; i < 8; i ++)
+    uint16_t cmd = (uint16_t)(((sel & 0xf) << 4) | (func & 0xf));
+    uint16_t v;
+
+    if (pci->vled_cmd == 0xffff)
     {
-        uint32_t vdip = 0xf;
-        vdip |= ((vi * 8) + i) << 4;
-        vdip |= ((uint32_t)(v & 0xffU)) << 8;
-        v >>= 8;
-        if (fpga_mgmt_set_vDIP((int)slot, (uint16_t)vdip))
-        {
-            FD_LOG_ERR (( "Unable to set privileged bytes for slot id %d", slot ));
+        if (pci->dev->get_vled(pci, &v))
+            return -1;
+        pci->vled_cmd = v & 0xff;
+    }
+    if (pci->vled_cmd == cmd && _wd_vled_byte(pci, func, sel ^ 1, b))
+        return -1;
+    pci->vled_cmd = 0xffff;
+    if (pci->dev->set_vdip(pci, cmd))
+        return -1;
+    pci->vled_cmd = cmd;
+
+    int64_t deadline = _wd_now_ns() + WD_VLED_TIMEOUT_NS;
+    for (;;)
+    {
+        if (pci->dev->get_vled(pci, &v))
             return -1;
+        if ((v & 0xff) == cmd)
+        {
+            *b = (uint8_t)(v >> 8);
+            return 0;
         }
+        if (_wd_now_ns() > deadline)
+            return -1;
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = 10000 };
+        nanosleep(&ts, NULL);
     }
-    return 0;
+}
+
+typedef struct {
+
+    wd_wksp_t *         wd;
+    uint32_t            slot;
+    int                 (*fn)(wd_wksp_t*, uint32_t, void*);
+    void *              arg;
+    int                 rc;
+    int                 started;
+    pthread_t           thread;
+
+} _wd_par_t;
+
+static void*
+_wd_par_main(void* _p)
+{
+    _wd_par_t* p = (_wd_par_t*)_p;
+    p->rc = p->fn(p->wd, p->slot, p->arg);
+    return NULL;
+}
+
+/* _wd_slots_par runs fn(wd, slot, arg) for every slot in slots, each on
+   a thread of its own when there is more than one (on the calling
+   thread if one cannot be started), and returns -1 if any of them
+   did. */
+int _wd_slots_par(wd_wksp_t* wd, uint64_t slots, int (*fn)(wd_wksp_t*, uint32_t, void*), void* arg)
+{
+    _wd_par_t p[WD_N_PCI_SLOTS];
+    uint32_t  n = 0;
+
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        if (slots & (1UL << slot))
+            p[n++] = (_wd_par_t){ .wd = wd, .slot = slot, .fn = fn, .arg = arg };
+    if (n == 1)
+        return fn(wd, p[0].slot, arg);
+
+    for (uint32_t i = 0; i < n; i ++)
+        p[i].started = !pthread_create(&p[i].thread, NULL, _wd_par_main, &p[i]);
+    int rc = 0;
+    for (uint32_t i = 0; i < n; i ++)
+    {
+        if (p[i].started)
+            pthread_join(p[i].thread, NULL);
+        else
+            _wd_par_main(&p[i]);
+        rc |= p[i].rc;
+    }
+    return rc ? -1 : 0;
 }
 
 
@@ -269,10 +520,7 @@ int _wd_set_vdip_64(wd_wksp_t* wd, uint32_t slot, uint32_t vi, uint64_t v)
 // D::::::::::::DDD     M::::::M               M::::::M A:::::A                 A:::::A 
 // DDDDDDDDDDDDD        MMMMMMMM               MMMMMMMMAAAAAAA                   AAAAAAA
 
-static int      fd       = -1;
-static void    *hp_base  = NULL;        /* user-pinned hugepage base */
-static size_t   hp_len   = 0;           /* bytes (set after pin)     */
-static uint64_t hp_iova  = 0;           /* IOVA of hugepage          */
+static int      fd       = -1;          /* /dev/wd_dma, one per process */
 
 static void
 wd_dma_init(void) {
@@ -284,185 +532,1937 @@ wd_dma_init(void) {
 }
 
 /* ------------------------------------------------------------------ */
-/* pin one user hugepage and return its IOVA                          */
-static uint64_t
-wd_dma_pin_hugepage(void *hp_addr) {
-    wd_dma_init();
-
-    uint64_t iova = (uint64_t)hp_addr;             /* in: vaddr, out: IOVA */
-    if(ioctl(fd, WD_IOC_MAP_HUGEPAGE, &iova))
-        FD_LOG_ERR(("ioctl WD_IOC_MAP_HUGEPAGE failed"));
+/* pin every hugepage of [addr, addr+sz) and record their IOVAs       */
+int
+wd_dma_map(wd_wksp_t *wd, void *addr, uint64_t sz, uint64_t page_sz) {
+    wd_dma_t *dma = &wd->dma;
 
-    hp_base = hp_addr;
-    hp_len  = 1UL << 21;                           /* assume 2 MiB hugepage */
-    hp_iova = iova;
+    if(page_sz != WD_DMA_PAGE_2M && page_sz != WD_DMA_PAGE_1G)
+        return -1;
+    if(((uintptr_t)addr & (page_sz - 1)) || !sz || (sz & (page_sz - 1)))
+        return -1;
+    if(sz / page_sz > WD_DMA_PAGE_MAX)
+        return -1;
 
-    return iova;
+    dma->base    = (uint8_t *)addr;
+    dma->sz      = sz;
+    dma->page_lg = (uint32_t)__builtin_ctzl(page_sz);
+    dma->n_page  = (uint32_t)(sz >> dma->page_lg);
+    for(uint32_t i = 0; i < dma->n_page; i++)
+        dma->iova[i] = wd->dev->pin_hugepage(wd->dev_ctx,
+                                             dma->base + ((uint64_t)i << dma->page_lg),
+                                             page_sz);
+    return 0;
 }
 
-uint64_t
-_wd_get_phys(void *p) {
-    if(!hp_base)
-        FD_LOG_ERR(("hugepage not pinned"));
+static inline uint64_t
+_wd_get_phys(wd_dma_t const *dma, void const *p) {
+    uint64_t off = (uint64_t)((uintptr_t)p - (uintptr_t)dma->base);
+    if(off >= dma->sz)
+        FD_LOG_ERR(("pointer %p outside the DMA region", p));
 
-    uintptr_t off = (uintptr_t)p - (uintptr_t)hp_base;
-    if(off >= hp_len)
-        FD_LOG_ERR(("pointer %p outside pinned hugepage", p));
+    return dma->iova[off >> dma->page_lg] + (off & ((1UL << dma->page_lg) - 1));
+}
 
-    return hp_iova + off;
+uint64_t
+wd_get_phys(wd_wksp_t *wd, void *p) {
+    return _wd_get_phys(&wd->dma, p);
 }
 
 void *
-wd_dma_base_ptr(void) {
-    return hp_base;
+wd_dma_base_ptr(wd_wksp_t *wd) {
+    return wd->dma.base;
 }
 
 uint64_t
-wd_dma_base_iova(void) {
-    return hp_iova;
+wd_dma_base_iova(wd_wksp_t *wd) {
+    return wd->dma.n_page ? wd->dma.iova[0] : 0;
 }
 
-//    SSSSSSSSSSSSSSS VVVVVVVV           VVVVVVVV
-//  SS:::::::::::::::SV::::::V           V::::::V
-// S:::::SSSSSS::::::SV::::::V           V::::::V
-// S:::::S     SSSSSSSV::::::V           V::::::V
-// S:::::S             V:::::V           V:::::V 
-// S:::::S              V:::::V         V:::::V  
-//  S::::SSSS            V:::::V       V:::::V   
-//   SS::::::SSSSS        V:::::V     V:::::V    
-//     SSS::::::::SS       V:::::V   V:::::V     
-//        SSSSSS::::S       V:::::V V:::::V      
-//             S:::::S       V:::::V:::::V       
-//             S:::::S        V:::::::::V        
-// SSSSSSS     S:::::S         V:::::::V         
-// S::::::SSSSSS:::::S          V:::::V          
-// S:::::::::::::::SS            V:::V           
-//  SSSSSSSSSSSSSSS               VVV            
+// F1 device backend: AWS SDK peek/poke, BAR4 write-combining stream
+// stores, mgmt vDIP and /dev/wd_dma pinning
 
-void
-wd_ed25519_verify_init_req( wd_wksp_t *        wd,
-                            uint8_t            send_fails,
-                            uint64_t           mcache_depth,
-                            void*              mcache_addr)
-{
-    wd->sv.req_slot  = _wd_next_slot(wd, 0);
-    wd->sv.req_depth = mcache_depth;
+/* the SDK's attach and its global fpga_mgmt_state are not known to be
+   thread safe, slots attach one at a time through them */
+static pthread_mutex_t _wd_f1_sdk_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    /* map (pin) the single mcache hugepage and get its IOVA */
-    uint64_t dma_phys = wd_dma_pin_hugepage(mcache_addr);
+static int
+_wd_f1_attach(wd_pci_t* pci)
+{
+    uint32_t slot = pci->slot;
+    int rc;
 
-    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++) {
-        if (!(wd->pci_slots & (1UL << slot)))
-            continue;
+    pthread_mutex_lock(&_wd_f1_sdk_lock);
+    fpga_mgmt_state.initialized = true;
+    fpga_mgmt_state.slots[slot].handle = PCI_BAR_HANDLE_INIT;
 
-        /* setup threshold levels for pipe-chain */
-        for (uint32_t i = 0; i < 5; i++) {
-            _wd_write_32(&wd->pci[slot], 0x10<<2, i);
-            _wd_write_32(&wd->pci[slot], 0x13<<2, 0);
-            _wd_write_32(&wd->pci[slot], 0x14<<2, (200 << 0) | (200 << 12));
+    rc = fpga_pci_attach((int)slot, FPGA_APP_PF, APP_PF_BAR0, 0, &pci->bar0);
+    if (!rc)
+    {
+        rc = fpga_pci_attach((int)slot, FPGA_APP_PF, APP_PF_BAR4, BURST_CAPABLE, &pci->bar4);
+        if (rc)
+        {
+            fpga_pci_detach(pci->bar0);
+            pci->bar0 = PCI_BAR_HANDLE_INIT;
         }
-        /* sha_pad thresholds */
-        _wd_write_32(&wd->pci[slot], 0x10<<2, 0);
-        _wd_write_32(&wd->pci[slot], 0x13<<2, 0);
-        _wd_write_32(&wd->pci[slot], 0x14<<2, 10 | (10 << 12));
-        /* send fails back */
-        _wd_write_32(&wd->pci[slot], 0x11<<2, send_fails);
+    }
+    if (rc)
+    {
+        pthread_mutex_unlock(&_wd_f1_sdk_lock);
+        FD_LOG_WARNING(( "Unable to attach to the AFI on slot id %d", slot ));
+        return -1;
+    }
 
-        _wd_set_vdip_64(wd, slot, 0, dma_phys);
-        _wd_set_vdip_64(wd, slot, 1, ((wd->sv.req_depth - 1) << 5) | 0x1f);
+    fpga_pci_get_address(pci->bar4, 0, 1024*1024, (void**)&pci->bar4_addr);
+    assert(((uintptr_t)pci->bar4_addr & 31u)==0 && "BAR4 not 32‑B aligned");
+
+    struct fpga_slot_spec spec;
+    int have_spec = !fpga_pci_get_slot_spec((int)slot, &spec);
+    pthread_mutex_unlock(&_wd_f1_sdk_lock);
+
+    /* sysfs, the slow part, in parallel */
+    if (have_spec)
+    {
+        struct fpga_pci_resource_map const* map = &spec.map[FPGA_APP_PF];
+        _wd_pci_locate(pci, map->domain, map->bus, map->dev, map->func);
     }
+
+    return 0;
 }
 
-void
-wd_ed25519_verify_init_resp( wd_wksp_t *        wd)
+static void
+_wd_f1_detach(wd_pci_t* pci)
 {
-    (void)wd;
+    if (pci->bar0 != PCI_BAR_HANDLE_INIT)
+        fpga_pci_detach(pci->bar0);
+    if (pci->bar4 != PCI_BAR_HANDLE_INIT)
+        fpga_pci_detach(pci->bar4);
 }
 
-int
-wd_ed25519_verify_req( wd_wksp_t *   wd,
-                       void const *  msg,
-                       ulong         sz,
-                       void const *  sig,
-                       void const *  public_key,
-                       uint64_t      m_seq,
-                       uint32_t      m_chunk,
-                       uint16_t      m_ctrl,
-                       uint16_t      m_sz)
+static uint32_t
+_wd_f1_read_32(wd_pci_t* pci, uint32_t addr)
 {
-    uint32_t slot = wd->sv.req_slot;
-    uint32_t src = 0;
+    int rc;
+    uint32_t value;
+    rc = fpga_pci_peek(pci->bar0, addr, &value);
+    if (rc)
+        FD_LOG_ERR (("Unable to read from the fpga !" ));
+    return value;
+}
 
-    // Every sixteen requests we check for backpressure
-    // this check is one PCIe RTT (~1us), we try to avoid
-    // it as much as possible
-    if (!(m_seq & 0xf))
-    {
-        int i;
-        // we cycle through all PCIe slots available to us
-        // whichever slot is not backpressured we use that next
-        for (i = 0; i < WD_TRY_LIMIT; i ++, slot = _wd_next_slot(wd, slot))
-        {
-            uint32_t fill = _wd_read_32(&wd->pci[slot], (0x21+src)<<2);
-            // PCIe buffer level
-            if ((fill & 0xfff) > 0)
-                continue;
-            // number of pending transactions in pipe-chain
-            if (((fill >> 12) & 0x3ff) > 256)
-                continue;
-            // DMA buffer level
-            if (((fill >> 22) & 0x3ff) > 256)
-                continue;
-            break;
-        }
-        // timeout
-        if (i == WD_TRY_LIMIT)
-        {
-            struct timespec ts = { .tv_sec = 0, .tv_nsec = 100000 }; /* 100 µs */
-            nanosleep(&ts, NULL);
-            return -1;
-        }   
-    }
+static void
+_wd_f1_write_32(wd_pci_t* pci, uint32_t addr, uint32_t v)
+{
+    fpga_pci_poke(pci->bar0, addr, v);
+}
 
-    uint64_t dma_addr = fd_mcache_line_idx(m_seq, wd->sv.req_depth) << 5;
+static void
+_wd_f1_write_256(wd_pci_t* pci, uint64_t off, __m256i v)
+{
+    volatile uint32_t* addr = (volatile uint32_t*)pci->bar4_addr;
+    addr += (off >> 2);
+    _mm256_stream_si256((__m256i*)(addr), v);
+}
+
+static void
+_wd_f1_flush(wd_pci_t* pci, uint32_t si)
+{
+    (void)pci;
+    (void)si;
+    _mm_sfence();
+}
+
+static int
+_wd_f1_set_vdip(wd_pci_t* pci, uint16_t v)
+{
+    return fpga_mgmt_set_vDIP((int)pci->slot, v);
+}
 
-    wd->stream_buf[0] = WD_PCI_MAGIC;
-    wd->stream_buf[1] = src | (((uint32_t)sz + 32 + 32) << 16);
-    wd->stream_buf[2] = (uint32_t)((uint32_t)(m_sz) | (((uint32_t)m_ctrl) << 16));
-    wd->stream_buf[3] = (uint32_t)((dma_addr >>  0) & 0xFFFFFFFF);
-    wd->stream_buf[4] = (uint32_t)((dma_addr >> 32) & 0xFFFFFFFF);
-    wd->stream_buf[5] = (uint32_t)((m_seq >>  0) & 0xFFFFFFFF);
-    wd->stream_buf[6] = (uint32_t)((m_seq >> 32) & 0xFFFFFFFF);
-    wd->stream_buf[7] = m_chunk;
+static int
+_wd_f1_get_vled(wd_pci_t* pci, uint16_t* v)
+{
+    return fpga_mgmt_get_vLED_status((int)pci->slot, v);
+}
 
-    _wd_stream_256(wd, slot, wd->stream_buf);
+static uint64_t
+_wd_f1_pin_hugepage(void* dev_ctx, void* hp_addr, uint64_t page_sz)
+{
+    (void)dev_ctx;
+    (void)page_sz;                                 /* the driver looks it up */
+    wd_dma_init();
 
-    // unfortunately we cannot avoid this copy as we don't
-    // make assumptions about the incoming buffer's
-    // alignment, which is required for avx streaming
-    memcpy(wd->stream_buf, ((uint8_t*)sig)+0, 32);
-    _wd_stream_256(wd, slot, wd->stream_buf);
+    uint64_t iova = (uint64_t)hp_addr;             /* in: vaddr, out: IOVA */
+    if(ioctl(fd, WD_IOC_MAP_HUGEPAGE, &iova))
+        FD_LOG_ERR(("ioctl WD_IOC_MAP_HUGEPAGE failed"));
 
-    memcpy(wd->stream_buf, ((uint8_t*)sig)+32, 32);
-    _wd_stream_256(wd, slot, wd->stream_buf);
+    return iova;
+}
 
-    memcpy(wd->stream_buf, public_key, 32);
-    _wd_stream_256(wd, slot, wd->stream_buf);
-    uint32_t i;
-    for (i = 0; i < sz; i += 32)
-    {
-        memcpy(wd->stream_buf, ((uint8_t*)msg) + i, 32);
-        _wd_stream_256(wd, slot, wd->stream_buf);
-    }
+wd_dev_t const wd_dev_f1 = {
+    .name         = "f1",
+    .attach       = _wd_f1_attach,
+    .detach       = _wd_f1_detach,
+    .read_32      = _wd_f1_read_32,
+    .write_32     = _wd_f1_write_32,
+    .write_256    = _wd_f1_write_256,
+    .flush        = _wd_f1_flush,
+    .set_vdip     = _wd_f1_set_vdip,
+    .get_vled     = _wd_f1_get_vled,
+    .pin_hugepage = _wd_f1_pin_hugepage,
+};
 
-    // pad the stream for the sake of 512-bit wide PCIe endpoint in AWS-F1
-    if ((i / 32) & 1)
-        _wd_stream_256(wd, slot, wd->stream_buf);
+// LLLLLLLLLLL                             AAA                TTTTTTTTTTTTTTTTTTTTTTT
+// L:::::::::L                            A:::A               T:::::::::::::::::::::T
+// L:::::::::L                           A:::::A              T:::::::::::::::::::::T
+// LL:::::::LL                          A:::::::A             T:::::TT:::::::TT:::::T
+//   L:::::L                           A:::::::::A            TTTTTT  T:::::T  TTTTTT
+//   L:::::L                          A:::::A:::::A                   T:::::T
+//   L:::::L                         A:::::A A:::::A                  T:::::T
+//   L:::::L                        A:::::A   A:::::A                 T:::::T
+//   L:::::L                       A:::::A     A:::::A                T:::::T
+//   L:::::L                      A:::::AAAAAAAAA:::::A               T:::::T
+//   L:::::L                     A:::::::::::::::::::::A              T:::::T
+//   L:::::L         LLLLLL     A:::::AAAAAAAAAAAAA:::::A             T:::::T
+// LL:::::::LLLLLLLLL:::::L    A:::::A             A:::::A          TT:::::::TT
+// L::::::::::::::::::::::L   A:::::A               A:::::A         T:::::::::T
+// L::::::::::::::::::::::L  A:::::A                 A:::::A        T:::::::::T
+// LLLLLLLLLLLLLLLLLLLLLLLL AAAAAAA                   AAAAAAA       TTTTTTTTTTT
 
-    // flush write-combining buffers
-    _wd_stream_flush(wd, slot);
+static inline uint32_t
+_wd_lat_bucket(uint64_t v)
+{
+    if (v < (1UL << (WD_LAT_SUB_LG + 1)))
+        return (uint32_t)v;
+    uint32_t sh = (uint32_t)(63 - __builtin_clzl(v)) - WD_LAT_SUB_LG;
+    return ((sh + 1) << WD_LAT_SUB_LG) | (uint32_t)((v >> sh) & ((1UL << WD_LAT_SUB_LG) - 1));
+}
 
-    wd->sv.req_slot = slot;
+static inline uint64_t
+_wd_lat_bucket_max(uint32_t b)
+{
+    if (b < (1U << (WD_LAT_SUB_LG + 1)))
+        return b;
+    uint32_t sh = (b >> WD_LAT_SUB_LG) - 1;
+    uint64_t lo = ((1UL << WD_LAT_SUB_LG) | (b & ((1U << WD_LAT_SUB_LG) - 1))) << sh;
+    return lo + (1UL << sh) - 1;
+}
 
-    return 0;
+static inline uint32_t
+_wd_lat_sz_class(uint64_t sz)
+{
+    return (uint32_t)((sz > 64) + (sz > 256) + (sz > 1024));
+}
+
+/* single writer: plain read-modify-write, published with relaxed
+   stores so a concurrent reader sees whole values */
+static inline void
+_wd_lat_add(wd_lat_hist_t* h, int64_t v)
+{
+    uint64_t u = v > 0 ? (uint64_t)v : 0;
+    uint32_t b = _wd_lat_bucket(u);
+    __atomic_store_n(&h->b[b], h->b[b] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum,  h->sum + u,  __ATOMIC_RELAXED);
+    if (u > h->max)
+        __atomic_store_n(&h->max, u, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->cnt,  h->cnt + 1,  __ATOMIC_RELAXED);
+}
+
+/* called by the submitter once the request's beats are flushed */
+static inline void
+_wd_lat_sent( wd_lat_t *    lat,
+              uint32_t      slot,
+              uint64_t      m_seq,
+              uint64_t      sz,
+              uint64_t      t_sub,
+              uint64_t      t_sent )
+{
+    wd_lat_rec_t * r = &lat->rec[fd_mcache_line_idx(m_seq, lat->depth)];
+    r->t_sub  = t_sub;
+    r->t_sent = t_sent;
+    r->slot   = slot;
+    r->sz     = (uint32_t)sz;
+    __atomic_store_n(&r->seq, m_seq, __ATOMIC_RELEASE);
+}
+
+/* TSC at device timestamp ts (low 32 bits of the device clock), taken
+   to be the one closest to TSC t_ref */
+static inline uint64_t
+_wd_lat_dev_tsc(wd_lat_cal_t const* cal, uint64_t t_ref, uint32_t ts)
+{
+    uint64_t dev_ref = cal->dev0 + (uint64_t)(int64_t)((double)(int64_t)(t_ref - cal->tsc0) * cal->tick_per_tsc);
+    uint64_t dev     = dev_ref + (uint64_t)(int64_t)(int32_t)(ts - (uint32_t)dev_ref);
+    return cal->tsc0 + (uint64_t)(int64_t)((double)(int64_t)(dev - cal->dev0) * cal->tsc_per_tick);
+}
+
+/* called by the poller for every completed result */
+static inline void
+_wd_lat_done( wd_lat_t *                        lat,
+              wd_ed25519_verify_resp_t const *  r,
+              uint64_t                          t_done )
+{
+    wd_lat_rec_t const * rec = &lat->rec[fd_mcache_line_idx(r->seq, lat->depth)];
+    // submitter has not got to it yet, or the line was reused
+    if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != r->seq)
+        return;
+
+    uint64_t        t_sub  = rec->t_sub;
+    uint64_t        t_sent = rec->t_sent;
+    uint32_t        slot   = rec->slot;
+    wd_lat_hist_t * h      = lat->hist[slot][_wd_lat_sz_class(rec->sz)];
+
+    _wd_lat_add(&h[WD_LAT_QUEUE], (int64_t)(t_sent - t_sub));
+    _wd_lat_add(&h[WD_LAT_TOTAL], (int64_t)(t_done - t_sub));
+
+    wd_lat_cal_t const * cal = &lat->cal[slot];
+    if (cal->tsc_per_tick > 0)
+    {
+        uint64_t t_orig = _wd_lat_dev_tsc(cal, t_sent, r->tsorig);
+        uint64_t t_pub  = _wd_lat_dev_tsc(cal, t_done, r->tspub);
+        _wd_lat_add(&h[WD_LAT_PCIE], (int64_t)(t_orig - t_sent));
+        _wd_lat_add(&h[WD_LAT_PIPE], (int64_t)(t_pub  - t_orig));
+        _wd_lat_add(&h[WD_LAT_DMA],  (int64_t)(t_done - t_pub));
+    }
+}
+
+/* the tightest of a few TSC-bracketed reads of slot's device clock */
+static void
+_wd_lat_sample(wd_wksp_t* wd, uint32_t slot, uint64_t* tsc, uint64_t* dev)
+{
+    uint64_t best = ~0UL;
+    *tsc = *dev = 0;
+    for (int i = 0; i < 8; i ++)
+    {
+        uint64_t t0 = __rdtsc();
+        uint64_t d  = wd_rd_ts(wd, slot);
+        uint64_t t1 = __rdtsc();
+        if (t1 - t0 < best)
+        {
+            best = t1 - t0;
+            *tsc = t0 + (t1 - t0) / 2;
+            *dev = d;
+        }
+    }
+}
+
+double wd_tsc_hz(void)
+{
+    struct timespec ts0, ts1, dt = { .tv_sec = 0, .tv_nsec = 10000000 };
+    clock_gettime(CLOCK_MONOTONIC, &ts0);
+    uint64_t t0 = __rdtsc();
+    nanosleep(&dt, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &ts1);
+    uint64_t t1 = __rdtsc();
+    double ns = (double)(ts1.tv_sec - ts0.tv_sec) * 1e9 + (double)(ts1.tv_nsec - ts0.tv_nsec);
+    return (double)(t1 - t0) * 1e9 / ns;
+}
+
+int wd_lat_init(wd_wksp_t* wd, uint32_t sample_lg)
+{
+    wd_lat_t* lat;
+    void*     rec;
+    uint64_t  depth = wd->sv.req_depth;
+
+    if (posix_memalign((void**)&lat, 64, sizeof(wd_lat_t)))
+        return -1;
+    if (posix_memalign(&rec, 64, depth * sizeof(wd_lat_rec_t)))
+    {
+        free(lat);
+        return -1;
+    }
+    memset(lat, 0, sizeof(wd_lat_t));
+    memset(rec, 0xff, depth * sizeof(wd_lat_rec_t));
+    lat->rec         = (wd_lat_rec_t*)rec;
+    lat->depth       = depth;
+    lat->sample_mask = (1UL << sample_lg) - 1;
+
+    lat->tsc_hz      = wd_tsc_hz();
+
+    wd->lat = lat;
+    wd_lat_calibrate(wd);
+    return 0;
+}
+
+void wd_lat_calibrate(wd_wksp_t* wd)
+{
+    wd_lat_t* lat = wd->lat;
+    uint64_t  tsc0[WD_N_PCI_SLOTS], dev0[WD_N_PCI_SLOTS];
+
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        if (wd->pci_slots & (1UL << slot))
+            _wd_lat_sample(wd, slot, &tsc0[slot], &dev0[slot]);
+
+    struct timespec dt = { .tv_sec = 0, .tv_nsec = 10000000 }; /* 10 ms */
+    nanosleep(&dt, NULL);
+
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+    {
+        if (!(wd->pci_slots & (1UL << slot)))
+            continue;
+        uint64_t tsc1, dev1;
+        _wd_lat_sample(wd, slot, &tsc1, &dev1);
+        if (dev1 <= dev0[slot] || tsc1 <= tsc0[slot])
+            continue;
+        lat->cal[slot].tsc0         = tsc1;
+        lat->cal[slot].dev0         = dev1;
+        lat->cal[slot].tsc_per_tick = (double)(tsc1 - tsc0[slot]) / (double)(dev1 - dev0[slot]);
+        lat->cal[slot].tick_per_tsc = 1. / lat->cal[slot].tsc_per_tick;
+    }
+}
+
+void wd_lat_fini(wd_wksp_t* wd)
+{
+    if (!wd->lat)
+        return;
+    free(wd->lat->rec);
+    free(wd->lat);
+    wd->lat = NULL;
+}
+
+void wd_lat_add(wd_lat_hist_t* h, uint64_t v)
+{
+    _wd_lat_add(h, (int64_t)fd_ulong_min(v, (uint64_t)INT64_MAX));
+}
+
+void wd_lat_merge(wd_lat_hist_t* dst, wd_lat_hist_t const* src)
+{
+    for (uint32_t b = 0; b < WD_LAT_N_BUCKET; b ++)
+        dst->b[b] += __atomic_load_n(&src->b[b], __ATOMIC_RELAXED);
+    dst->cnt += __atomic_load_n(&src->cnt, __ATOMIC_RELAXED);
+    dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+    if (max > dst->max)
+        dst->max = max;
+}
+
+uint64_t wd_lat_quantile(wd_lat_hist_t const* h, double q)
+{
+    // count from the buckets so a concurrent writer cannot skew it
+    uint64_t cnt = 0;
+    for (uint32_t b = 0; b < WD_LAT_N_BUCKET; b ++)
+        cnt += __atomic_load_n(&h->b[b], __ATOMIC_RELAXED);
+    if (!cnt)
+        return 0;
+
+    uint64_t rank = (uint64_t)(q * (double)cnt);
+    if (rank >= cnt)
+        rank = cnt - 1;
+    for (uint32_t b = 0; b < WD_LAT_N_BUCKET; b ++)
+    {
+        uint64_t n = __atomic_load_n(&h->b[b], __ATOMIC_RELAXED);
+        if (rank < n)
+            return _wd_lat_bucket_max(b);
+        rank -= n;
+    }
+    return _wd_lat_bucket_max(WD_LAT_N_BUCKET - 1);
+}
+
+double wd_lat_ns(wd_wksp_t* wd, uint64_t cycles)
+{
+    return wd->lat ? (double)cycles * 1e9 / wd->lat->tsc_hz : 0.;
+}
+
+//    SSSSSSSSSSSSSSS VVVVVVVV           VVVVVVVV
+//  SS:::::::::::::::SV::::::V           V::::::V
+// S:::::SSSSSS::::::SV::::::V           V::::::V
+// S:::::S     SSSSSSSV::::::V           V::::::V
+// S:::::S             V:::::V           V:::::V 
+// S:::::S              V:::::V         V:::::V  
+//  S::::SSSS            V:::::V       V:::::V   
+//   SS::::::SSSSS        V:::::V     V:::::V    
+//     SSS::::::::SS       V:::::V   V:::::V     
+//        SSSSSS::::S       V:::::V V:::::V      
+//             S:::::S       V:::::V:::::V       
+//             S:::::S        V:::::::::V        
+// SSSSSSS     S:::::S         V:::::::V         
+// S::::::SSSSSS:::::S          V:::::V          
+// S:::::::::::::::SS            V:::V           
+//  SSSSSSSSSSSSSSS               VVV            
+
+/* byte i of vDIP 0/1 as programmed */
+static inline uint8_t
+_wd_vdip_byte(wd_pci_t const* pci, uint32_t i)
+{
+    return (uint8_t)(pci->vdip[i >> 3] >> ((i & 7) * 8));
+}
+
+/* program one slot, see wd_ed25519_verify_init_req */
+static int
+_wd_init_slot(wd_wksp_t* wd, uint32_t slot, void* arg)
+{
+    wd_pci_t* pci        = &wd->pci[slot];
+    uint8_t   send_fails = *(uint8_t*)arg;
+
+    /* setup threshold levels for pipe-chain */
+    for (uint32_t i = 0; i < 5; i++) {
+        _wd_write_32(pci, 0x10<<2, i);
+        _wd_write_32(pci, 0x13<<2, 0);
+        _wd_write_32(pci, 0x14<<2, (200 << 0) | (200 << 12));
+    }
+    /* sha_pad thresholds */
+    _wd_write_32(pci, 0x10<<2, 0);
+    _wd_write_32(pci, 0x13<<2, 0);
+    _wd_write_32(pci, 0x14<<2, 10 | (10 << 12));
+    /* send fails back */
+    _wd_write_32(pci, 0x11<<2, send_fails);
+
+    /* mcache base (vDIP 0) and mask (vDIP 1), a byte per command.  One
+       readback pass first, up to the first byte that differs: if all
+       16 are in place nothing is written, otherwise all of them are.
+       The first query after attach also probes for readback; without
+       it (the query goes unanswered) every byte is written */
+    pci->vdip_dirty  = 0;
+    pci->settle_ns   = 0;
+    pci->n_vdip_wr   = 0;
+    pci->n_vdip_skip = 0;
+    uint32_t same = 0;
+    for (; pci->vled_rb != 2 && same < 16; same ++)
+    {
+        uint8_t have;
+        if (_wd_vled_byte(pci, 0, same, &have))
+        {
+            if (!pci->vled_rb)
+                pci->vled_rb = 2;
+            break;
+        }
+        pci->vled_rb = 1;
+        if (have != _wd_vdip_byte(pci, same))
+            break;
+    }
+    if (same == 16)
+    {
+        pci->n_vdip_skip = 16;
+        return 0;
+    }
+    for (uint32_t i = 0; i < 16; i ++)
+    {
+        uint8_t want = _wd_vdip_byte(pci, i);
+        if (pci->dev->set_vdip(pci, (uint16_t)(0xf | (i << 4) | ((uint32_t)want << 8))))
+        {
+            FD_LOG_WARNING (( "Unable to set privileged bytes for slot id %d", slot ));
+            return -1;
+        }
+        pci->vdip_dirty |= (uint16_t)(1U << i);
+        pci->n_vdip_wr ++;
+    }
+    if (pci->vled_rb == 2)
+    {
+        pci->vdip_dirty = 0;
+        pci->settle_ns  = _wd_now_ns() + WD_VDIP_SETTLE_NS;
+    }
+    return 0;
+}
+
+void
+wd_ed25519_verify_init_req( wd_wksp_t *        wd,
+                            uint8_t            send_fails,
+                            uint64_t           mcache_depth,
+                            void*              mcache_addr)
+{
+    wd->sub.req_slot = _wd_next_slot(wd->sub.slots, 0);
+    wd->sv.req_depth  = mcache_depth;
+    wd->sv.mcache     = (fd_frag_meta_t *)mcache_addr;
+    wd->sv.send_fails = send_fails;
+
+    /* map (pin) the mcache's hugepages unless the caller has */
+    uint64_t mc_sz = mcache_depth * sizeof(fd_frag_meta_t);
+    if (!wd->dma.n_page &&
+        wd_dma_map(wd, mcache_addr, (mc_sz + WD_DMA_PAGE_2M - 1) & ~(WD_DMA_PAGE_2M - 1), WD_DMA_PAGE_2M))
+        FD_LOG_ERR(("cannot map the mcache for DMA"));
+
+    /* the device writes line i at base + i*32, so the IOVAs must not
+       break anywhere inside the mcache */
+    uint64_t dma_phys = _wd_get_phys(&wd->dma, mcache_addr);
+    uint64_t page_sz  = 1UL << wd->dma.page_lg;
+    for (uint64_t off = page_sz - ((uintptr_t)mcache_addr & (page_sz - 1)); off < mc_sz; off += page_sz)
+        if (_wd_get_phys(&wd->dma, (uint8_t*)mcache_addr + off) != dma_phys + off)
+            FD_LOG_ERR(("mcache is not IOVA-contiguous"));
+
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++) {
+        if (!(wd->pci_slots & (1UL << slot)))
+            continue;
+        wd->pci[slot].vdip[0] = dma_phys;
+        wd->pci[slot].vdip[1] = ((wd->sv.req_depth - 1) << 5) | 0x1f;
+    }
+    if (_wd_slots_par(wd, wd->pci_slots, _wd_init_slot, &send_fails))
+        FD_LOG_ERR(( "Unable to program the slots" ));
+}
+
+static int
+_wd_ready_slot(wd_wksp_t* wd, uint32_t slot, void* arg)
+{
+    wd_pci_t* pci      = &wd->pci[slot];
+    int64_t   deadline = *(int64_t*)arg;
+
+    // no readback: the fixed settle time
+    if (pci->settle_ns)
+    {
+        int64_t now = _wd_now_ns();
+        int64_t end = pci->settle_ns < deadline ? pci->settle_ns : deadline;
+        if (end > now)
+        {
+            struct timespec ts = { .tv_sec = (end - now) / 1000000000L, .tv_nsec = (end - now) % 1000000000L };
+            nanosleep(&ts, NULL);
+        }
+        if (pci->settle_ns > deadline)
+            return -1;
+        pci->settle_ns = 0;
+        return 0;
+    }
+
+    int64_t nap = 10000;
+    for (;;)
+    {
+        for (uint32_t i = 0; i < 16; i ++)
+        {
+            uint8_t have;
+            if ((pci->vdip_dirty & (1U << i)) &&
+                !_wd_vled_byte(pci, 0, i, &have) && have == _wd_vdip_byte(pci, i))
+                pci->vdip_dirty &= (uint16_t)~(1U << i);
+        }
+        if (!pci->vdip_dirty)
+            return 0;
+        if (_wd_now_ns() > deadline)
+            return -1;
+        struct timespec ts = { .tv_sec = 0, .tv_nsec = nap };
+        nanosleep(&ts, NULL);
+        nap = nap * 2 < WD_BACKOFF_SLEEP_MAX_NS ? nap * 2 : WD_BACKOFF_SLEEP_MAX_NS;
+    }
+}
+
+int
+wd_ed25519_verify_ready( wd_wksp_t *        wd,
+                         int64_t            timeout_ns)
+{
+    int64_t  deadline = timeout_ns == WD_TIMEOUT_NONE ? INT64_MAX : _wd_now_ns() + timeout_ns;
+    uint64_t slots    = 0;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++)
+        if ((wd->pci_slots & (1UL << slot)) && (wd->pci[slot].vdip_dirty || wd->pci[slot].settle_ns))
+            slots |= 1UL << slot;
+    return slots ? _wd_slots_par(wd, slots, _wd_ready_slot, &deadline) : 0;
+}
+
+void
+wd_ed25519_verify_init_resp( wd_wksp_t *        wd,
+                             uint64_t           seq0)
+{
+    wd_ed25519_verify_t * sv = &wd->sv;
+    uint64_t depth = sv->req_depth;
+
+    sv->resp_seq = seq0;
+    sv->resp_win = depth < WD_RESP_WINDOW ? depth : WD_RESP_WINDOW;
+    memset(sv->resp_done, 0, sizeof(sv->resp_done));
+    sv->n_resp   = 0;
+    sv->n_lost   = 0;
+
+    for (uint64_t i = 0; i < depth; i++)
+    {
+        uint64_t next = seq0 + ((i - seq0) & (depth - 1));
+        FD_VOLATILE(sv->mcache[i].seq) = fd_seq_dec(next, depth);
+    }
+    FD_COMPILER_MFENCE();
+
+    if (!sv->send_fails)
+        FD_LOG_WARNING(( "send_fails is off: failed verifies will be reported lost" ));
+}
+
+/* seqs of the 4 lines at meta, one per lane */
+static inline __m256i
+_wd_scan_seq4(fd_frag_meta_t const* meta)
+{
+    __m256i l0 = _mm256_load_si256((__m256i const*)(meta + 0));
+    __m256i l1 = _mm256_load_si256((__m256i const*)(meta + 1));
+    __m256i l2 = _mm256_load_si256((__m256i const*)(meta + 2));
+    __m256i l3 = _mm256_load_si256((__m256i const*)(meta + 3));
+    return _mm256_permute2x128_si256(_mm256_unpacklo_epi64(l0, l1),
+                                     _mm256_unpacklo_epi64(l2, l3), 0x20);
+}
+
+ulong
+wd_ed25519_verify_scan( wd_wksp_t *           wd,
+                        ulong                 max)
+{
+    wd_ed25519_verify_t *  sv    = &wd->sv;
+    fd_frag_meta_t const * mc    = sv->mcache;
+    uint64_t               depth = sv->req_depth;
+    uint64_t               seq   = sv->resp_seq;
+    int                    flush = sv->resp_flush;
+    ulong                  n     = 0;
+
+    // the run also ends at a line wd_ed25519_verify_poll_resp already
+    // reported out of order
+    if (max > sv->resp_win)
+        max = sv->resp_win;
+    for (ulong k = 0; k < max; )
+    {
+        uint64_t s = seq + k;
+        uint64_t w = sv->resp_done[(s >> 6) & (WD_RESP_WINDOW/64 - 1)] >> (s & 63);
+        if (w)
+        {
+            k += (ulong)__builtin_ctzl(w);
+            if (k < max)
+                max = k;
+            break;
+        }
+        k += 64 - (s & 63);
+    }
+
+    __m256i const step = _mm256_set1_epi64x(4);
+    __m256i       exp  = _mm256_setr_epi64x((long)seq, (long)seq+1, (long)seq+2, (long)seq+3);
+
+    ulong fl = 0;           // lines of the run flushed so far
+    while (n < max)
+    {
+        uint64_t               idx  = fd_mcache_line_idx(seq + n, depth);
+        fd_frag_meta_t const * meta = mc + idx;
+
+        // flush the next WD_SCAN_PREFETCH lines, one fence for all
+        if (flush && n >= fl)
+        {
+            fl = n + WD_SCAN_PREFETCH < max ? n + WD_SCAN_PREFETCH : max;
+            for (ulong k = n; k < fl; k ++)
+            {
+                uint64_t j = fd_mcache_line_idx(seq + k, depth);
+                if (k == n || !(j & 1))
+                    _mm_clflush(mc + j);
+            }
+            _mm_mfence();
+        }
+
+        // a group of 4 that straddles the end of the ring or max goes
+        // line by line
+        if (n + 4 > max || idx + 4 > depth)
+        {
+            if (__atomic_load_n(&meta->seq, __ATOMIC_ACQUIRE) != seq + n)
+                break;
+            n ++;
+            exp = _mm256_add_epi64(exp, _mm256_set1_epi64x(1));
+            continue;
+        }
+
+        // a flushed line is read from memory anyway
+        if (!flush)
+        {
+            _mm_prefetch((char const*)(mc + ((idx + WD_SCAN_PREFETCH    ) & (depth - 1))), _MM_HINT_T0);
+            _mm_prefetch((char const*)(mc + ((idx + WD_SCAN_PREFETCH + 2) & (depth - 1))), _MM_HINT_T0);
+        }
+
+        __m256i seq4 = _wd_scan_seq4(meta);
+        FD_COMPILER_MFENCE();   // the seqs before anything the caller reads
+        uint32_t ok = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(seq4, exp)));
+        if (ok != 0xf)
+            return n + (ulong)__builtin_ctz(~ok);
+        n  += 4;
+        exp = _mm256_add_epi64(exp, step);
+    }
+    return n;
+}
+
+void
+wd_ed25519_verify_scan_done( wd_wksp_t *      wd,
+                             ulong            n)
+{
+    wd_ed25519_verify_t * sv = &wd->sv;
+    wd_lat_t *            lat = wd->lat;
+    wd_evt_ring_t *       ev  = FD_UNLIKELY(wd->evt) ? wd_evt_ring(wd->evt) : NULL;
+    // the per-result hooks of wd_ed25519_verify_poll_resp, on each line
+    // of the run as the caller left it
+    if (lat || wd->cache || wd->infl || ev)
+    {
+        uint64_t t_done = lat || ev ? __rdtsc() : 0;
+        for (ulong i = 0; i < n; i ++)
+        {
+            uint64_t                 seq  = sv->resp_seq + i;
+            fd_frag_meta_t const *   meta = sv->mcache + fd_mcache_line_idx(seq, sv->req_depth);
+            wd_ed25519_verify_resp_t r;
+            r.seq    = seq;
+            r.chunk  = FD_VOLATILE_CONST(meta->chunk);
+            r.res    = (uint32_t)FD_VOLATILE_CONST(meta->sig);
+            r.tsorig = FD_VOLATILE_CONST(meta->tsorig);
+            r.tspub  = FD_VOLATILE_CONST(meta->tspub);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            // lapped since the scan: the result is gone
+            if (FD_VOLATILE_CONST(meta->seq) != seq)
+                r.res = WD_ED25519_RES_LOST;
+            else
+            {
+                if (lat)
+                    _wd_lat_done(lat, &r, t_done);
+                if (wd->cache && r.res == WD_ED25519_RES_PASS)
+                    wd_cache_done(wd->cache, seq);
+            }
+            if (wd->infl)
+                wd_infl_done(wd->infl, seq);
+            if (ev)
+                wd_evt_add(ev, WD_EVT_DONE, WD_EVT_SLOT_NONE, seq, t_done, 0, r.res, 1);
+        }
+        if (wd->infl)
+            wd_infl_poll(wd->infl);
+    }
+    sv->resp_seq += n;
+    sv->n_resp   += n;
+
+    // and past whatever wd_ed25519_verify_poll_resp resolved behind it
+    for (;;)
+    {
+        uint64_t * w   = &sv->resp_done[(sv->resp_seq >> 6) & (WD_RESP_WINDOW/64 - 1)];
+        uint64_t   bit = 1UL << (sv->resp_seq & 63);
+        if (!(*w & bit))
+            break;
+        *w &= ~bit;
+        sv->resp_seq ++;
+    }
+}
+
+static inline void
+_wd_resp_lost( wd_ed25519_verify_t *       sv,
+               wd_ed25519_verify_resp_t *  r,
+               uint64_t                    seq)
+{
+    r->seq    = seq;
+    r->chunk  = 0;
+    r->res    = WD_ED25519_RES_LOST;
+    r->tsorig = 0;
+    r->tspub  = 0;
+    sv->n_lost ++;
+}
+
+ulong
+wd_ed25519_verify_poll_resp( wd_wksp_t *                 wd,
+                             wd_ed25519_verify_resp_t *  resp,
+                             ulong                       max)
+{
+    wd_ed25519_verify_t * sv = &wd->sv;
+    wd_lat_t *            lat = wd->lat;
+    uint64_t depth  = sv->req_depth;
+    uint64_t win    = sv->resp_win;
+    uint64_t last   = 0;    // offset of the furthest line resolved
+    uint64_t gap    = 0;
+    ulong    cnt    = 0;
+    wd_evt_ring_t * ev = FD_UNLIKELY(wd->evt) ? wd_evt_ring(wd->evt) : NULL;
+    uint64_t t_done = lat || ev ? __rdtsc() : 0;
+
+    for (uint64_t k = 0; k < win && cnt < max && gap < WD_RESP_GAP; k ++)
+    {
+        uint64_t   seq = sv->resp_seq + k;
+        uint64_t * w   = &sv->resp_done[(seq >> 6) & (WD_RESP_WINDOW/64 - 1)];
+        uint64_t   bit = 1UL << (seq & 63);
+        if (*w & bit)
+        {
+            gap  = 0;
+            last = k;
+            continue;
+        }
+
+        fd_frag_meta_t const * meta = sv->mcache + fd_mcache_line_idx(seq, depth);
+        uint64_t seq0 = __atomic_load_n(&meta->seq, __ATOMIC_ACQUIRE);
+        long     diff = fd_seq_diff(seq0, seq);
+        // not written yet
+        if (diff < 0)
+        {
+            gap ++;
+            continue;
+        }
+
+        wd_ed25519_verify_resp_t * r = resp + cnt;
+        if (!diff)
+        {
+            r->seq    = seq;
+            r->chunk  = FD_VOLATILE_CONST(meta->chunk);
+            r->res    = (uint32_t)FD_VOLATILE_CONST(meta->sig);
+            r->tsorig = FD_VOLATILE_CONST(meta->tsorig);
+            r->tspub  = FD_VOLATILE_CONST(meta->tspub);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            // overwritten while we were reading it
+            if (FD_VOLATILE_CONST(meta->seq) != seq0)
+                _wd_resp_lost(sv, r, seq);
+            else
+            {
+                if (lat)
+                    _wd_lat_done(lat, r, t_done);
+                if (wd->cache && r->res == WD_ED25519_RES_PASS)
+                    wd_cache_done(wd->cache, seq);
+            }
+        }
+        else
+            // lapped: the device has already reused this line
+            _wd_resp_lost(sv, r, seq);
+        if (wd->infl)
+            wd_infl_done(wd->infl, seq);
+        if (ev)
+            wd_evt_add(ev, WD_EVT_DONE, WD_EVT_SLOT_NONE, seq, t_done, 0, r->res, 1);
+
+        *w  |= bit;
+        gap  = 0;
+        last = k;
+        cnt ++;
+    }
+
+    // the window is full behind a request that never completed
+    if (cnt < max && last == win - 1 &&
+        !(sv->resp_done[(sv->resp_seq >> 6) & (WD_RESP_WINDOW/64 - 1)] & (1UL << (sv->resp_seq & 63))))
+    {
+        _wd_resp_lost(sv, resp + cnt, sv->resp_seq);
+        sv->resp_done[(sv->resp_seq >> 6) & (WD_RESP_WINDOW/64 - 1)] |= 1UL << (sv->resp_seq & 63);
+        if (wd->infl)
+            wd_infl_done(wd->infl, sv->resp_seq);
+        if (ev)
+            wd_evt_add(ev, WD_EVT_DONE, WD_EVT_SLOT_NONE, sv->resp_seq, t_done, 0, WD_ED25519_RES_LOST, 1);
+        cnt ++;
+    }
+
+    // retire the resolved prefix
+    for (;;)
+    {
+        uint64_t * w   = &sv->resp_done[(sv->resp_seq >> 6) & (WD_RESP_WINDOW/64 - 1)];
+        uint64_t   bit = 1UL << (sv->resp_seq & 63);
+        if (!(*w & bit))
+            break;
+        *w &= ~bit;
+        sv->resp_seq ++;
+    }
+
+    if (wd->infl)
+        wd_infl_poll(wd->infl);
+
+    sv->n_resp += cnt;
+    return cnt;
+}
+
+/* _wd_credit_refresh reads slot's fill register (one PCIe RTT, ~1us) and
+   sets the handle's credits there to its share of the room below
+   WD_BP_PEND_MAX and WD_BP_DMA_MAX.  A non-empty PCIe buffer grants
+   nothing.  The load estimate restarts from what the register shows
+   queued on the slot. */
+static void
+_wd_credit_refresh( wd_sub_t *    sub,
+                    uint32_t      slot )
+{
+    wd_wksp_t *   wd   = sub->wd;
+    wd_credit_t * cr   = &sub->cr[slot];
+    uint32_t      fill = _wd_read_32(&wd->pci[slot], 0x21<<2);
+    int64_t       room = 0;
+    int64_t       n_pend = (int64_t)((fill >> 12) & 0x3ff);
+    int64_t       n_dma  = (int64_t)((fill >> 22) & 0x3ff);
+    int64_t       pend_max = sub->cpu ? sub->spill_pend : WD_BP_PEND_MAX;
+    int64_t       dma_max  = sub->cpu ? sub->spill_dma  : WD_BP_DMA_MAX;
+    // the slot is split between the handles streaming into it
+    int64_t       n_own    = __builtin_popcount(__atomic_load_n(&wd->st_owned[slot], __ATOMIC_RELAXED));
+
+    sub->n_mmio ++;
+    // PCIe buffer level
+    if (!(fill & 0xfff))
+    {
+        // number of pending transactions in pipe-chain
+        int64_t pend = pend_max - n_pend;
+        // DMA buffer level
+        int64_t dma  = dma_max  - n_dma;
+        room = pend < dma ? pend : dma;
+        if (room < 0)
+            room = 0;
+        room /= n_own;
+    }
+    cr->avail = room;
+    cr->share = (pend_max < dma_max ? pend_max : dma_max) / n_own;
+    cr->since = 0;
+    cr->at    = sub->n_req;
+    cr->load  = (int64_t)(fill & 0xfff) +
+                (n_pend + n_dma) * (int64_t)(cr->n_req ? cr->n_beat / cr->n_req : 4);
+}
+
+static inline int
+_wd_credit_ok( wd_sub_t const * sub,
+               uint32_t         slot,
+               uint64_t         n_txn)
+{
+    wd_credit_t const * cr = &sub->cr[slot];
+    return cr->avail >= (int64_t)n_txn &&
+           (!sub->cr_interval || cr->since < sub->cr_interval);
+}
+
+/* _wd_sched_least returns the least loaded slot in cand (not 0), ties
+   going to the first one in turn after last. */
+static inline uint32_t
+_wd_sched_least( wd_sub_t const * sub,
+                 uint64_t         cand,
+                 uint32_t         last)
+{
+    uint32_t best = WD_N_PCI_SLOTS;
+    for (uint32_t i = 1; i <= WD_N_PCI_SLOTS; i ++)
+    {
+        uint32_t s = (last + i) & (WD_N_PCI_SLOTS - 1);
+        if ((cand & (1UL << s)) &&
+            (best == WD_N_PCI_SLOTS || sub->cr[s].load < sub->cr[best].load))
+            best = s;
+    }
+    return best;
+}
+
+/* _wd_sched_refresh refreshes slot for the scheduler.  A slot that
+   grants fewer than n_txn credits counts as full until its next
+   refresh.  Returns 0 if it granted enough. */
+static int
+_wd_sched_refresh( wd_sub_t *    sub,
+                   uint32_t      slot,
+                   uint64_t      n_txn)
+{
+    wd_credit_t * cr = &sub->cr[slot];
+    _wd_credit_refresh(sub, slot);
+    if (cr->avail >= (int64_t)n_txn)
+        return 0;
+    int64_t full = WD_BP_PEND_MAX * (int64_t)(cr->n_req ? cr->n_beat / cr->n_req : 4);
+    if (cr->load < full)
+        cr->load = full;
+    return -1;
+}
+
+/* _wd_sched_pick picks the least loaded slot in cand.  Estimates
+   older than WD_SCHED_STALE of the handle's requests are refreshed
+   first: they count everything sent since as still queued, which only
+   holds for a slot that is not keeping up.  If the handle does not
+   hold n_txn credits on the pick, every candidate it is out of credit
+   on is refreshed and the least loaded one that grants enough is
+   picked.  Returns -1 if none grants. */
+static int
+_wd_sched_pick( wd_sub_t *    sub,
+                uint64_t      cand,
+                uint32_t *    _slot,
+                uint64_t      n_txn)
+{
+    for (uint64_t m = cand; m; m &= m - 1)
+    {
+        uint32_t s = (uint32_t)__builtin_ctzl(m);
+        if (sub->n_req - sub->cr[s].at >= WD_SCHED_STALE)
+            _wd_sched_refresh(sub, s, n_txn);
+    }
+
+    uint32_t slot = _wd_sched_least(sub, cand, *_slot);
+    if (!_wd_credit_ok(sub, slot, n_txn))
+    {
+        for (uint64_t m = cand; m; m &= m - 1)
+        {
+            uint32_t s = (uint32_t)__builtin_ctzl(m);
+            if (!_wd_credit_ok(sub, s, n_txn) && _wd_sched_refresh(sub, s, n_txn))
+                cand &= ~(1UL << s);
+        }
+        if (!cand)
+            return -1;
+        slot = _wd_sched_least(sub, cand, *_slot);
+    }
+    *_slot = slot;
+    return 0;
+}
+
+/* _wd_sched_rand returns one of the handle's slots at random. */
+static inline uint32_t
+_wd_sched_rand( wd_sub_t *    sub )
+{
+    uint64_t x = sub->rng;
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    sub->rng = x;
+
+    uint64_t m = sub->slots;
+    for (uint32_t k = (uint32_t)((x >> 32) % (uint64_t)__builtin_popcountl(m)); k; k --)
+        m &= m - 1;
+    return (uint32_t)__builtin_ctzl(m);
+}
+
+/* _wd_find_slot finds a slot the handle holds at least n_txn credits
+   on, per its scheduling policy, given the slot it used last in *slot.
+   RR starts at the one after it and cycles through the handle's slots
+   once, refreshing each one it has run out on; LEAST and P2C choose
+   among all of them or among two random ones (as many pairs as the
+   handle has slots).  Credits already held are used without touching
+   the device.  Returns -1 if no slot had enough. */
+int
+_wd_find_slot( wd_sub_t *    sub,
+               uint32_t *    _slot,
+               uint64_t      n_txn)
+{
+    uint32_t slot = *_slot;
+    int      rr   = sub->sched == WD_SCHED_RR || !(sub->slots & (sub->slots - 1));
+    int      n    = sub->sched == WD_SCHED_LEAST && !rr ? 1 : __builtin_popcountl(sub->slots);
+    int i;
+    if (rr)
+        slot = _wd_next_slot(sub->slots, slot);
+    // whichever slot is not backpressured we use that next
+    for (i = 0; i < n; i ++)
+    {
+        if (rr)
+        {
+            if (_wd_credit_ok(sub, slot, n_txn))
+                break;
+            _wd_credit_refresh(sub, slot);
+            if (sub->cr[slot].avail >= (int64_t)n_txn)
+                break;
+            slot = _wd_next_slot(sub->slots, slot);
+        }
+        else
+        {
+            uint64_t cand = sub->slots;
+            if (sub->sched == WD_SCHED_P2C)
+                cand = (1UL << _wd_sched_rand(sub)) | (1UL << _wd_sched_rand(sub));
+            if (!_wd_sched_pick(sub, cand, &slot, n_txn))
+                break;
+        }
+        sub->n_stall ++;
+    }
+    if (i == n)
+        return -1;
+    *_slot = slot;
+    return 0;
+}
+
+static inline int64_t
+_wd_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000L + (int64_t)ts.tv_nsec;
+}
+
+/* _wd_wait_slot is _wd_find_slot retried until it succeeds or
+   timeout_ns (WD_TIMEOUT_NONE: never) has passed.  Between tries it
+   backs off according to how long stalls have been taking to clear
+   (sub->drain_ns): it spins with pause for the first quarter of that
+   (at most WD_BACKOFF_SPIN_MAX_NS), yields the core for the rest of it,
+   then sleeps, doubling the sleep up to WD_BACKOFF_SLEEP_MAX_NS.  Returns 0, EAGAIN if timeout_ns is 0
+   and no slot had enough credits, or ETIMEDOUT.  A wait is logged to
+   ev (if not NULL) as one WD_EVT_WAIT for m_seq. */
+static int
+_wd_wait_slot( wd_sub_t *        sub,
+               uint32_t *        _slot,
+               uint64_t          n_txn,
+               int64_t           timeout_ns,
+               uint64_t          m_seq,
+               wd_evt_ring_t *   ev)
+{
+    if (!_wd_find_slot(sub, _slot, n_txn))
+        return 0;
+    uint64_t t_evt = ev ? __rdtsc() : 0;
+    if (!timeout_ns)
+    {
+        if (ev)
+            wd_evt_add(ev, WD_EVT_WAIT, WD_EVT_SLOT_NONE, m_seq, t_evt, 0, EAGAIN, 1);
+        return EAGAIN;
+    }
+
+    int64_t t0    = _wd_now_ns();
+    int64_t drain = sub->drain_ns;
+    int64_t spin  = drain >> 2 < WD_BACKOFF_SPIN_MAX_NS ? drain >> 2 : WD_BACKOFF_SPIN_MAX_NS;
+    int64_t nap   = drain >> 3;
+    int64_t el;
+    for (;;)
+    {
+        el = _wd_now_ns() - t0;
+        if (timeout_ns > 0 && el >= timeout_ns)
+        {
+            sub->n_timeout ++;
+            if (ev)
+                wd_evt_add(ev, WD_EVT_WAIT, WD_EVT_SLOT_NONE, m_seq, t_evt, __rdtsc() - t_evt, ETIMEDOUT, 1);
+            return ETIMEDOUT;
+        }
+        if (el < spin)
+        {
+            for (int k = 0; k < 64; k ++)
+                _mm_pause();
+        }
+        else if (el < drain)
+            sched_yield();
+        else
+        {
+            int64_t ns = nap;
+            if (timeout_ns > 0 && ns > timeout_ns - el)
+                ns = timeout_ns - el;
+            struct timespec ts = { .tv_sec = ns / 1000000000L, .tv_nsec = ns % 1000000000L };
+            nanosleep(&ts, NULL);
+            nap = nap * 2 < WD_BACKOFF_SLEEP_MAX_NS ? nap * 2 : WD_BACKOFF_SLEEP_MAX_NS;
+        }
+        if (!_wd_find_slot(sub, _slot, n_txn))
+            break;
+    }
+
+    // how long this stall took to clear, averaged over the last few
+    el = _wd_now_ns() - t0;
+    drain += (el - drain) / 8;
+    sub->drain_ns = drain < WD_BACKOFF_DRAIN_MIN_NS ? WD_BACKOFF_DRAIN_MIN_NS :
+                    drain > WD_BACKOFF_DRAIN_MAX_NS ? WD_BACKOFF_DRAIN_MAX_NS : drain;
+    sub->n_wait  ++;
+    sub->wait_ns += (uint64_t)el;
+    if (ev)
+        wd_evt_add(ev, WD_EVT_WAIT, *_slot, m_seq, t_evt, __rdtsc() - t_evt, 0, 1);
+    return 0;
+}
+
+/* _wd_rob_wait waits until m_seq is less than the reorder buffer's
+   depth past its head, which only the poller moves: it spins with
+   pause for WD_BACKOFF_SPIN_MAX_NS, then yields the core between
+   looks.  Returns 0, EAGAIN if timeout_ns is 0 and there is no room,
+   or ETIMEDOUT. */
+static int
+_wd_rob_wait( wd_sub_t *    sub,
+              uint64_t      m_seq,
+              int64_t       timeout_ns)
+{
+    wd_rob_t * rob = sub->wd->rob;
+    if (m_seq - __atomic_load_n(&rob->head, __ATOMIC_ACQUIRE) < rob->depth)
+        return 0;
+    __atomic_fetch_add(&rob->n_full, 1, __ATOMIC_RELAXED);
+    if (!timeout_ns)
+        return EAGAIN;
+
+    int64_t t0 = _wd_now_ns();
+    for (;;)
+    {
+        for (int k = 0; k < 64; k ++)
+            _mm_pause();
+        if (m_seq - __atomic_load_n(&rob->head, __ATOMIC_ACQUIRE) < rob->depth)
+            return 0;
+        int64_t el = _wd_now_ns() - t0;
+        if (timeout_ns > 0 && el >= timeout_ns)
+        {
+            sub->n_timeout ++;
+            return ETIMEDOUT;
+        }
+        if (el >= WD_BACKOFF_SPIN_MAX_NS)
+            sched_yield();
+    }
+}
+
+/* _wd_req_beats is the number of 32-byte stream beats a request with
+   an sz byte message takes: header, signature, public key, message,
+   padded to an even count. */
+static inline uint64_t
+_wd_req_beats(ulong sz)
+{
+    uint64_t nb = (sz + 31) >> 5;
+    return 4 + nb + (nb & 1);
+}
+
+static inline void
+_wd_credit_take( wd_sub_t *    sub,
+                 uint32_t      slot,
+                 uint64_t      n,
+                 uint64_t      beats )
+{
+    wd_credit_t * cr = &sub->cr[slot];
+    cr->avail  -= (int64_t)n;
+    cr->since  += n;
+    cr->load   += (int64_t)beats;
+    cr->n_req  += n;
+    cr->n_beat += beats;
+}
+
+/* _wd_load_partial_256 loads the first n (0<n<32) bytes at p into the
+   low bytes of a zeroed ymm without touching memory past p+n: whole
+   dwords come in through a masked load, the last 1-3 bytes are blended
+   into their lane. */
+static inline __m256i
+_wd_load_partial_256(uint8_t const* p, ulong n)
+{
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i nw   = _mm256_set1_epi32((int)(n >> 2));
+    __m256i v    = _mm256_maskload_epi32((int const*)p, _mm256_cmpgt_epi32(nw, lane));
+    ulong   r    = n & 3;
+    if (r)
+    {
+        uint8_t const* q = p + (n & ~3UL);
+        uint32_t w = q[0];
+        if (r > 1) w |= (uint32_t)q[1] <<  8;
+        if (r > 2) w |= (uint32_t)q[2] << 16;
+        v = _mm256_blendv_epi8(v, _mm256_set1_epi32((int)w), _mm256_cmpeq_epi32(nw, lane));
+    }
+    return v;
+}
+
+/* Sized encoders.  _WD_ENC(NB) is the kernel for messages of NB beats
+   ((NB-1)*32 < sz <= NB*32): the header, signature and public key
+   beats, NB-1 whole message beats, the last (maybe partial) one and,
+   for odd NB, the padding beat, all unrolled.  EMIT(k, v) sends beat k
+   of the request. */
+#define _WD_ENC_BEATS(NB, EMIT)                                                 \
+    EMIT(0, hdr);                                                               \
+    EMIT(1, _mm256_loadu_si256((__m256i const*)(sig +  0)));                    \
+    EMIT(2, _mm256_loadu_si256((__m256i const*)(sig + 32)));                    \
+    EMIT(3, _mm256_loadu_si256((__m256i const*)pub));                           \
+    _Pragma("GCC unroll 64")                                                    \
+    for (int k = 1; k < (NB); k ++)                                             \
+        EMIT(3 + k, _mm256_loadu_si256((__m256i const*)(msg + 32 * (k - 1))));  \
+    if ((NB) > 0)                                                               \
+        EMIT(3 + (NB), (sz & 31) ? _wd_load_partial_256(msg + 32 * ((NB) - 1), sz & 31) \
+                                 : _mm256_loadu_si256((__m256i const*)(msg + 32 * ((NB) - 1)))); \
+    if ((NB) & 1)                                                               \
+        EMIT(4 + (NB), _mm256_setzero_si256());
+
+#define _WD_EMIT_RUN(k, v)      _wd_write_256(pci, off + 32 * (ulong)(k), (v))
+#define _WD_EMIT_STREAM(k, v)   _wd_stream_256(sub, slot, (v))
+
+/* A request of N beats that ends before the stream's next flush point
+   (the last 64 bytes of a 4 KiB page, which the stream window's end
+   also is) needs neither a flush nor a wrap check: its beats go out at
+   fixed offsets from the window position, which moves once. */
+#define _WD_ENC(NB)                                                             \
+static void                                                                     \
+_wd_enc_##NB( wd_sub_t *      sub,                                             \
+              uint32_t        slot,                                            \
+              __m256i         hdr,                                             \
+              uint8_t const * sig,                                             \
+              uint8_t const * pub,                                             \
+              uint8_t const * msg,                                             \
+              ulong           sz)                                              \
+{                                                                               \
+    ulong         n  = 4 + (NB) + ((NB) & 1);                                   \
+    wd_pci_st_t * st = &sub->st[slot];                                          \
+    if ((st->a & 0xFFF) + 32 * n < 0xFC0)                                       \
+    {                                                                           \
+        wd_pci_t * pci = &sub->wd->pci[slot];                                   \
+        uint64_t   off = st->a | st->b;                                         \
+        _WD_ENC_BEATS(NB, _WD_EMIT_RUN)                                         \
+        st->a += 32 * n;                                                        \
+        return;                                                                 \
+    }                                                                           \
+    _WD_ENC_BEATS(NB, _WD_EMIT_STREAM)                                          \
+}
+
+_WD_ENC( 0) _WD_ENC( 1) _WD_ENC( 2) _WD_ENC( 3) _WD_ENC( 4) _WD_ENC( 5) _WD_ENC( 6) _WD_ENC( 7)
+_WD_ENC( 8) _WD_ENC( 9) _WD_ENC(10) _WD_ENC(11) _WD_ENC(12) _WD_ENC(13) _WD_ENC(14) _WD_ENC(15)
+_WD_ENC(16) _WD_ENC(17) _WD_ENC(18) _WD_ENC(19) _WD_ENC(20) _WD_ENC(21) _WD_ENC(22) _WD_ENC(23)
+_WD_ENC(24) _WD_ENC(25) _WD_ENC(26) _WD_ENC(27) _WD_ENC(28) _WD_ENC(29) _WD_ENC(30) _WD_ENC(31)
+_WD_ENC(32) _WD_ENC(33) _WD_ENC(34) _WD_ENC(35) _WD_ENC(36) _WD_ENC(37) _WD_ENC(38) _WD_ENC(39)
+
+typedef void (*_wd_enc_fn_t)(wd_sub_t*, uint32_t, __m256i, uint8_t const*,
+                             uint8_t const*, uint8_t const*, ulong);
+
+static _wd_enc_fn_t const _wd_enc[WD_ENC_NB_MAX + 1] = {
+    _wd_enc_0,  _wd_enc_1,  _wd_enc_2,  _wd_enc_3,  _wd_enc_4,  _wd_enc_5,  _wd_enc_6,  _wd_enc_7,
+    _wd_enc_8,  _wd_enc_9,  _wd_enc_10, _wd_enc_11, _wd_enc_12, _wd_enc_13, _wd_enc_14, _wd_enc_15,
+    _wd_enc_16, _wd_enc_17, _wd_enc_18, _wd_enc_19, _wd_enc_20, _wd_enc_21, _wd_enc_22, _wd_enc_23,
+    _wd_enc_24, _wd_enc_25, _wd_enc_26, _wd_enc_27, _wd_enc_28, _wd_enc_29, _wd_enc_30, _wd_enc_31,
+    _wd_enc_32, _wd_enc_33, _wd_enc_34, _wd_enc_35, _wd_enc_36, _wd_enc_37, _wd_enc_38, _wd_enc_39,
+};
+
+/* _wd_ed25519_verify_stream writes one request to slot's stream without
+   flushing the write-combining buffers. */
+void
+_wd_ed25519_verify_stream( wd_sub_t *    sub,
+                           uint32_t      slot,
+                           void const *  msg,
+                           ulong         sz,
+                           void const *  sig,
+                           void const *  public_key,
+                           uint64_t      m_seq,
+                           uint32_t      m_chunk,
+                           uint16_t      m_ctrl,
+                           uint16_t      m_sz)
+{
+    uint32_t src = 0;
+    uint64_t dma_addr = fd_mcache_line_idx(m_seq, sub->wd->sv.req_depth) << 5;
+
+    // the header is built in a register and every other beat is an
+    // unaligned load straight from the caller's buffers, so nothing
+    // goes through a staging buffer on its way to BAR4
+    __m256i hdr = _mm256_setr_epi32(
+        (int)WD_PCI_MAGIC,
+        (int)(src | (((uint32_t)sz + 32 + 32) << 16)),
+        (int)((uint32_t)(m_sz) | (((uint32_t)m_ctrl) << 16)),
+        (int)((dma_addr >>  0) & 0xFFFFFFFF),
+        (int)((dma_addr >> 32) & 0xFFFFFFFF),
+        (int)((m_seq >>  0) & 0xFFFFFFFF),
+        (int)((m_seq >> 32) & 0xFFFFFFFF),
+        (int)m_chunk);
+
+    // one kernel per message beat count; the rest, or on request, the
+    // generic loop
+    ulong nb_msg = (sz + 31) >> 5;
+    if (FD_LIKELY(nb_msg <= WD_ENC_NB_MAX && sub->enc == WD_ENC_SIZED))
+    {
+        _wd_enc[nb_msg](sub, slot, hdr, (uint8_t const*)sig, (uint8_t const*)public_key,
+                        (uint8_t const*)msg, sz);
+        return;
+    }
+
+    _wd_stream_256(sub, slot, hdr);
+
+    _wd_stream_256(sub, slot, _mm256_loadu_si256((__m256i const*)(((uint8_t const*)sig)+0)));
+    _wd_stream_256(sub, slot, _mm256_loadu_si256((__m256i const*)(((uint8_t const*)sig)+32)));
+    _wd_stream_256(sub, slot, _mm256_loadu_si256((__m256i const*)public_key));
+
+    ulong i;
+    for (i = 0; i + 32 <= sz; i += 32)
+        _wd_stream_256(sub, slot, _mm256_loadu_si256((__m256i const*)(((uint8_t const*)msg) + i)));
+
+    // the last partial beat must not read past the end of msg
+    ulong nb = i / 32;
+    if (i < sz)
+    {
+        _wd_stream_256(sub, slot, _wd_load_partial_256(((uint8_t const*)msg) + i, sz - i));
+        nb ++;
+    }
+
+    // pad the stream for the sake of 512-bit wide PCIe endpoint in AWS-F1
+    if (nb & 1)
+        _wd_stream_256(sub, slot, _mm256_setzero_si256());
+}
+
+/* _wd_cache_check looks a request up in the workspace's verified-
+   signature cache.  On a hit it writes the request's result line the
+   way the device would and returns 1.  On a miss it returns 0 and the
+   request's hashes in tag/chk, for _wd_cache_sent once it has gone
+   out: a request that still fails to find room is not counted. */
+static int
+_wd_cache_check( wd_sub_t *    sub,
+                 void const *  msg,
+                 ulong         sz,
+                 void const *  sig,
+                 void const *  public_key,
+                 uint64_t      m_seq,
+                 uint32_t      m_chunk,
+                 uint16_t      m_ctrl,
+                 uint16_t      m_sz,
+                 uint64_t *    tag,
+                 uint64_t *    chk)
+{
+    wd_wksp_t *  wd    = sub->wd;
+    if (!wd_cache_query(wd->cache, msg, sz, sig, public_key, tag, chk))
+        return 0;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint32_t now = (uint32_t)(((uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec) >> 2);
+    fd_frag_meta_t * meta = wd->sv.mcache + fd_mcache_line_idx(m_seq, wd->sv.req_depth);
+
+    /* same publication order as fd_mcache_publish */
+    FD_COMPILER_MFENCE();
+    FD_VOLATILE(meta->seq) = fd_seq_dec(m_seq, 1UL);
+    FD_COMPILER_MFENCE();
+    meta->sig    = WD_ED25519_RES_PASS;
+    meta->chunk  = m_chunk;
+    meta->sz     = m_sz;
+    meta->ctl    = m_ctrl;
+    meta->tsorig = now;
+    meta->tspub  = now;
+    FD_COMPILER_MFENCE();
+    FD_VOLATILE(meta->seq) = m_seq;
+    FD_COMPILER_MFENCE();
+
+    sub->n_hit ++;
+    sub->n_req ++;
+    return 1;
+}
+
+/* _wd_cache_sent notes a missed request under m_seq once it has been
+   sent (or spilled), so that it is cached once it passes */
+static inline void
+_wd_cache_sent( wd_sub_t *    sub,
+                uint64_t      m_seq,
+                uint64_t      tag,
+                uint64_t      chk)
+{
+    wd_cache_note(sub->wd->cache, m_seq, tag, chk);
+    sub->n_miss ++;
+}
+
+/* _wd_ed25519_verify_req_ev is the submit path, logging to ev.  It is
+   inlined twice, with ev NULL and with the caller's ring, so that the
+   path without an event log has none of it. */
+static inline __attribute__((always_inline)) int
+_wd_ed25519_verify_req_ev( wd_sub_t *        sub,
+                           void const *      msg,
+                           ulong             sz,
+                           void const *      sig,
+                           void const *      public_key,
+                           uint64_t          m_seq,
+                           uint32_t          m_chunk,
+                           uint16_t          m_ctrl,
+                           uint16_t          m_sz,
+                           int64_t           timeout_ns,
+                           wd_evt_ring_t *   ev)
+{
+    uint32_t    slot  = sub->req_slot;
+    wd_lat_t *  lat   = sub->wd->lat;
+    wd_infl_t * infl  = sub->wd->infl;
+    uint64_t    t_sub = 0;
+    uint64_t    t_evt = ev ? __rdtsc() : 0;
+    int         cache = !!sub->wd->cache;
+    uint64_t    tag   = 0, chk = 0;
+    int         err;
+
+    if (sub->wd->rob && (err = _wd_rob_wait(sub, m_seq, timeout_ns)))
+        return err;
+
+    if (cache &&
+        _wd_cache_check(sub, msg, sz, sig, public_key, m_seq, m_chunk, m_ctrl, m_sz, &tag, &chk))
+    {
+        if (infl)
+            wd_infl_note(infl, WD_INFL_SLOT_HOST, msg, sz, sig, public_key, m_seq, m_chunk, m_ctrl, m_sz);
+        if (ev)
+            wd_evt_add(ev, WD_EVT_HOST, WD_EVT_SLOT_NONE, m_seq, t_evt, __rdtsc() - t_evt, 0, 1);
+        return 0;
+    }
+
+    if (lat && (m_seq & lat->sample_mask))
+        lat = NULL;
+    if (lat)
+        t_sub = __rdtsc();
+
+    if (sub->cpu)
+    {
+        // spill to the CPU pool rather than wait out a saturated device
+        int64_t spill_ns = timeout_ns >= 0 && timeout_ns < sub->spill_ns ? timeout_ns : sub->spill_ns;
+        err = _wd_wait_slot(sub, &slot, 1, spill_ns, m_seq, ev);
+        if (err && !wd_cpu_req(sub->cpu, msg, sz, sig, public_key, m_seq, m_chunk, m_ctrl, m_sz))
+        {
+            if (cache)
+                _wd_cache_sent(sub, m_seq, tag, chk);
+            if (infl)
+                wd_infl_note(infl, WD_INFL_SLOT_HOST, msg, sz, sig, public_key, m_seq, m_chunk, m_ctrl, m_sz);
+            sub->n_spill ++;
+            sub->n_req ++;
+            if (ev)
+                wd_evt_add(ev, WD_EVT_HOST, WD_EVT_SLOT_NONE, m_seq, t_evt, __rdtsc() - t_evt, 1, 1);
+            return 0;
+        }
+        // the rest of the timeout
+        int64_t rest = timeout_ns < 0 ? timeout_ns : timeout_ns - spill_ns;
+        if (err && rest)
+            err = _wd_wait_slot(sub, &slot, 1, rest, m_seq, ev);
+    }
+    else
+        err = _wd_wait_slot(sub, &slot, 1, timeout_ns, m_seq, ev);
+    if (err)
+        return err;
+
+    uint64_t t_send = ev ? __rdtsc() : 0;
+    _wd_ed25519_verify_stream(sub, slot, msg, sz, sig, public_key,
+                              m_seq, m_chunk, m_ctrl, m_sz);
+
+    // flush write-combining buffers
+    uint64_t t_fence = ev ? __rdtsc() : 0;
+    _wd_stream_flush(sub, slot);
+    if (ev)
+    {
+        uint64_t t_end = __rdtsc();
+        wd_evt_add(ev, WD_EVT_SEND,  slot, m_seq, t_send,  t_fence - t_send, (uint32_t)_wd_req_beats(sz), 1);
+        wd_evt_add(ev, WD_EVT_FENCE, slot, m_seq, t_fence, t_end - t_fence,  0, 1);
+        wd_evt_add(ev, WD_EVT_REQ,   slot, m_seq, t_evt,   t_end - t_evt,    (uint32_t)sz, 1);
+    }
+
+    if (lat)
+        _wd_lat_sent(lat, slot, m_seq, sz, t_sub, __rdtsc());
+    if (infl)
+        wd_infl_note(infl, slot, msg, sz, sig, public_key, m_seq, m_chunk, m_ctrl, m_sz);
+    if (cache)
+        _wd_cache_sent(sub, m_seq, tag, chk);
+
+    _wd_credit_take(sub, slot, 1, _wd_req_beats(sz));
+    sub->req_slot = slot;
+    sub->n_req ++;
+
+    return 0;
+}
+
+static int
+_wd_ed25519_verify_req( wd_sub_t *    sub,
+                        void const *  msg,
+                        ulong         sz,
+                        void const *  sig,
+                        void const *  public_key,
+                        uint64_t      m_seq,
+                        uint32_t      m_chunk,
+                        uint16_t      m_ctrl,
+                        uint16_t      m_sz,
+                        int64_t       timeout_ns)
+{
+    if (FD_UNLIKELY(sub->wd->evt))
+    {
+        wd_evt_ring_t * ev = wd_evt_ring(sub->wd->evt);
+        if (ev)
+            return _wd_ed25519_verify_req_ev(sub, msg, sz, sig, public_key, m_seq,
+                                             m_chunk, m_ctrl, m_sz, timeout_ns, ev);
+    }
+    return _wd_ed25519_verify_req_ev(sub, msg, sz, sig, public_key, m_seq,
+                                     m_chunk, m_ctrl, m_sz, timeout_ns, NULL);
+}
+
+static ulong
+_wd_ed25519_verify_req_batch( wd_sub_t *            sub,
+                              void const * const *  msg,
+                              ulong const *         sz,
+                              void const * const *  sig,
+                              void const * const *  public_key,
+                              uint64_t const *      m_seq,
+                              uint32_t const *      m_chunk,
+                              uint16_t const *      m_ctrl,
+                              uint16_t const *      m_sz,
+                              ulong                 cnt)
+{
+    uint32_t    slot  = sub->req_slot;
+    ulong       done  = 0;
+    wd_lat_t *  lat   = sub->wd->lat;
+    uint64_t    t_sub = lat ? __rdtsc() : 0;
+    int         cache = !!sub->wd->cache;
+    wd_rob_t *  rob   = sub->wd->rob;
+    wd_infl_t * infl  = sub->wd->infl;
+    wd_evt_ring_t * ev = FD_UNLIKELY(sub->wd->evt) ? wd_evt_ring(sub->wd->evt) : NULL;
+    int64_t     spill_ns = sub->timeout_ns >= 0 && sub->timeout_ns < sub->spill_ns ?
+                           sub->timeout_ns : sub->spill_ns;
+    uint64_t    tag = 0, chk = 0;
+
+    while (done < cnt)
+    {
+        if (rob && _wd_rob_wait(sub, m_seq[done], sub->timeout_ns))
+            break;
+
+        if (cache && _wd_cache_check(sub, msg[done], sz[done], sig[done], public_key[done],
+                                     m_seq[done], m_chunk[done], m_ctrl[done], m_sz[done],
+                                     &tag, &chk))
+        {
+            if (infl)
+                wd_infl_note(infl, WD_INFL_SLOT_HOST, msg[done], sz[done], sig[done], public_key[done],
+                             m_seq[done], m_chunk[done], m_ctrl[done], m_sz[done]);
+            if (ev)
+                wd_evt_add(ev, WD_EVT_HOST, WD_EVT_SLOT_NONE, m_seq[done], __rdtsc(), 0, 0, 1);
+            done ++;
+            continue;
+        }
+
+        if (sub->cpu && _wd_wait_slot(sub, &slot, 1, spill_ns, m_seq[done], ev))
+        {
+            // spill to the CPU pool rather than wait out a saturated device
+            if (!wd_cpu_req(sub->cpu, msg[done], sz[done], sig[done], public_key[done],
+                            m_seq[done], m_chunk[done], m_ctrl[done], m_sz[done]))
+            {
+                if (cache)
+                    _wd_cache_sent(sub, m_seq[done], tag, chk);
+                if (infl)
+                    wd_infl_note(infl, WD_INFL_SLOT_HOST, msg[done], sz[done], sig[done], public_key[done],
+                                 m_seq[done], m_chunk[done], m_ctrl[done], m_sz[done]);
+                sub->n_spill ++;
+                sub->n_req ++;
+                if (ev)
+                    wd_evt_add(ev, WD_EVT_HOST, WD_EVT_SLOT_NONE, m_seq[done], __rdtsc(), 0, 1, 1);
+                done ++;
+                continue;
+            }
+            // the rest of the timeout
+            int64_t rest = sub->timeout_ns < 0 ? sub->timeout_ns : sub->timeout_ns - spill_ns;
+            if (!rest || _wd_wait_slot(sub, &slot, 1, rest, m_seq[done], ev))
+                break;
+        }
+        else if (!sub->cpu && _wd_wait_slot(sub, &slot, 1, sub->timeout_ns, m_seq[done], ev))
+            break;
+
+        // size the next run to the credits held on the slot and to
+        // what the stream window can absorb
+        // and end it early at a cached request, which is then done,
+        // or at one the reorder buffer has no room for yet.  A request
+        // taken into the run is sent, so a miss is noted right there
+        ulong    room = (ulong)sub->cr[slot].avail;
+        uint64_t head = rob ? __atomic_load_n(&rob->head, __ATOMIC_ACQUIRE) : 0;
+        ulong n = 0, bytes = 0, hit = 0;
+        while (done + n < cnt && n < room)
+        {
+            ulong i  = done + n;
+            ulong rb = _wd_req_beats(sz[i]) << 5;
+            if (n && bytes + rb > WD_BATCH_BYTES_MAX)
+                break;
+            if (n && rob && m_seq[i] - head >= rob->depth)
+                break;
+            if (n && cache && _wd_cache_check(sub, msg[i], sz[i], sig[i], public_key[i],
+                                              m_seq[i], m_chunk[i], m_ctrl[i], m_sz[i],
+                                              &tag, &chk))
+            {
+                hit = 1;
+                break;
+            }
+            if (cache)
+                _wd_cache_sent(sub, m_seq[i], tag, chk);
+            bytes += rb;
+            n ++;
+        }
+
+        uint64_t t_send = ev ? __rdtsc() : 0;
+        for (ulong i = done; i < done + n; i ++)
+            _wd_ed25519_verify_stream(sub, slot, msg[i], sz[i], sig[i], public_key[i],
+                                      m_seq[i], m_chunk[i], m_ctrl[i], m_sz[i]);
+
+        // flush write-combining buffers
+        uint64_t t_fence = ev ? __rdtsc() : 0;
+        _wd_stream_flush(sub, slot);
+        if (ev)
+        {
+            // the run as a whole, and each request in it
+            uint64_t t_end = __rdtsc();
+            uint16_t n16   = n < UINT16_MAX ? (uint16_t)n : UINT16_MAX;
+            wd_evt_add(ev, WD_EVT_SEND,  slot, m_seq[done], t_send,  t_fence - t_send, (uint32_t)(bytes >> 5), n16);
+            wd_evt_add(ev, WD_EVT_FENCE, slot, m_seq[done], t_fence, t_end - t_fence,  0, n16);
+            for (ulong i = done; i < done + n; i ++)
+                wd_evt_add(ev, WD_EVT_REQ, slot, m_seq[i], t_send, t_end - t_send, (uint32_t)sz[i], 1);
+            if (hit)
+                wd_evt_add(ev, WD_EVT_HOST, WD_EVT_SLOT_NONE, m_seq[done + n], t_end, 0, 0, 1);
+        }
+
+        if (lat)
+        {
+            uint64_t t_sent = __rdtsc();
+            for (ulong i = done; i < done + n; i ++)
+                if (!(m_seq[i] & lat->sample_mask))
+                    _wd_lat_sent(lat, slot, m_seq[i], sz[i], t_sub, t_sent);
+        }
+        if (infl)
+        {
+            for (ulong i = done; i < done + n; i ++)
+                wd_infl_note(infl, slot, msg[i], sz[i], sig[i], public_key[i],
+                             m_seq[i], m_chunk[i], m_ctrl[i], m_sz[i]);
+            // the cached request that ended the run
+            if (hit)
+                wd_infl_note(infl, WD_INFL_SLOT_HOST, msg[done + n], sz[done + n], sig[done + n],
+                             public_key[done + n], m_seq[done + n], m_chunk[done + n],
+                             m_ctrl[done + n], m_sz[done + n]);
+        }
+
+        _wd_credit_take(sub, slot, n, bytes >> 5);
+        sub->n_req += n;
+        done += n + hit;
+    }
+
+    sub->req_slot = slot;
+
+    return done;
+}
+
+int
+wd_ed25519_verify_req( wd_wksp_t *   wd,
+                       void const *  msg,
+                       ulong         sz,
+                       void const *  sig,
+                       void const *  public_key,
+                       uint64_t      m_seq,
+                       uint32_t      m_chunk,
+                       uint16_t      m_ctrl,
+                       uint16_t      m_sz)
+{
+    return _wd_ed25519_verify_req(&wd->sub, msg, sz, sig, public_key,
+                                  m_seq, m_chunk, m_ctrl, m_sz, wd->sub.timeout_ns);
+}
+
+int
+wd_ed25519_verify_try_req( wd_wksp_t *   wd,
+                           void const *  msg,
+                           ulong         sz,
+                           void const *  sig,
+                           void const *  public_key,
+                           uint64_t      m_seq,
+                           uint32_t      m_chunk,
+                           uint16_t      m_ctrl,
+                           uint16_t      m_sz)
+{
+    return _wd_ed25519_verify_req(&wd->sub, msg, sz, sig, public_key,
+                                  m_seq, m_chunk, m_ctrl, m_sz, 0);
+}
+
+ulong
+wd_ed25519_verify_req_batch( wd_wksp_t *           wd,
+                             void const * const *  msg,
+                             ulong const *         sz,
+                             void const * const *  sig,
+                             void const * const *  public_key,
+                             uint64_t const *      m_seq,
+                             uint32_t const *      m_chunk,
+                             uint16_t const *      m_ctrl,
+                             uint16_t const *      m_sz,
+                             ulong                 cnt)
+{
+    return _wd_ed25519_verify_req_batch(&wd->sub, msg, sz, sig, public_key,
+                                        m_seq, m_chunk, m_ctrl, m_sz, cnt);
+}
+
+//    SSSSSSSSSSSSSSS  UUUUUUUU     UUUUUUUU BBBBBBBBBBBBBBBBB
+//  SS:::::::::::::::S U::::::U     U::::::U B::::::::::::::::B
+// S:::::SSSSSS::::::S U::::::U     U::::::U B::::::BBBBBB:::::B
+// S:::::S     SSSSSSS UU:::::U     U:::::UU BB:::::B     B:::::B
+// S:::::S              U:::::U     U:::::U    B::::B     B:::::B
+// S:::::S              U:::::D     D:::::U    B::::B     B:::::B
+//  S::::SSSS           U:::::D     D:::::U    B::::BBBBBB:::::B
+//   SS::::::SSSSS      U:::::D     D:::::U    B:::::::::::::BB
+//     SSS::::::::SS    U:::::D     D:::::U    B::::BBBBBB:::::B
+//        SSSSSS::::S   U:::::D     D:::::U    B::::B     B:::::B
+//             S:::::S  U:::::D     D:::::U    B::::B     B:::::B
+//             S:::::S  U::::::U   U::::::U    B::::B     B:::::B
+// SSSSSSS     S:::::S  U:::::::UUU:::::::U  BB:::::BBBBBB::::::B
+// S::::::SSSSSS:::::S   UU:::::::::::::UU   B:::::::::::::::::B
+// S:::::::::::::::SS      UU:::::::::UU     B::::::::::::::::B
+//  SSSSSSSSSSSSSSS          UUUUUUUUU       BBBBBBBBBBBBBBBBB
+
+int wd_sub_init(wd_sub_t* sub, wd_wksp_t* wd, uint32_t si, uint64_t slots)
+{
+    if (si >= WD_N_PCI_STREAMS || !slots || (slots & ~wd->pci_slots))
+        return -1;
+
+    /* claim stream si on every slot, undo on conflict */
+    uint32_t bit = 1U << si;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+    {
+        if (!(slots & (1UL << slot)))
+            continue;
+        if (__atomic_fetch_or(&wd->st_owned[slot], bit, __ATOMIC_ACQ_REL) & bit)
+        {
+            for (uint32_t s = 0; s < slot; s ++)
+                if (slots & (1UL << s))
+                    __atomic_fetch_and(&wd->st_owned[s], ~bit, __ATOMIC_ACQ_REL);
+            return -1;
+        }
+    }
+
+    memset(sub, 0, sizeof(*sub));
+    sub->wd       = wd;
+    sub->slots    = slots;
+    sub->si       = si;
+    sub->req_slot = _wd_next_slot(slots, 0);
+    sub->n_req    = 0;
+    sub->rng      = 0x9e3779b97f4a7c15UL * (si + 1);
+    sub->timeout_ns = WD_TIMEOUT_DFLT;
+    sub->drain_ns   = WD_BACKOFF_DRAIN_NS;
+    sub->spill_pend = WD_BP_PEND_MAX;
+    sub->spill_dma  = WD_BP_DMA_MAX;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        if (slots & (1UL << slot))
+            sub->st[slot] = wd->pci[slot].stream[si];
+
+    return 0;
+}
+
+void wd_sub_fini(wd_sub_t* sub)
+{
+    uint32_t bit = 1U << sub->si;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        if (sub->slots & (1UL << slot))
+            __atomic_fetch_and(&sub->wd->st_owned[slot], ~bit, __ATOMIC_ACQ_REL);
+    sub->slots = 0;
+}
+
+int
+wd_ed25519_verify_req_sub( wd_sub_t *    sub,
+                           void const *  msg,
+                           ulong         sz,
+                           void const *  sig,
+                           void const *  public_key,
+                           uint64_t      m_seq,
+                           uint32_t      m_chunk,
+                           uint16_t      m_ctrl,
+                           uint16_t      m_sz)
+{
+    return _wd_ed25519_verify_req(sub, msg, sz, sig, public_key,
+                                  m_seq, m_chunk, m_ctrl, m_sz, sub->timeout_ns);
+}
+
+int
+wd_ed25519_verify_try_req_sub( wd_sub_t *    sub,
+                               void const *  msg,
+                               ulong         sz,
+                               void const *  sig,
+                               void const *  public_key,
+                               uint64_t      m_seq,
+                               uint32_t      m_chunk,
+                               uint16_t      m_ctrl,
+                               uint16_t      m_sz)
+{
+    return _wd_ed25519_verify_req(sub, msg, sz, sig, public_key,
+                                  m_seq, m_chunk, m_ctrl, m_sz, 0);
+}
+
+ulong
+wd_ed25519_verify_req_batch_sub( wd_sub_t *            sub,
+                                 void const * const *  msg,
+                                 ulong const *         sz,
+                                 void const * const *  sig,
+                                 void const * const *  public_key,
+                                 uint64_t const *      m_seq,
+                                 uint32_t const *      m_chunk,
+                                 uint16_t const *      m_ctrl,
+                                 uint16_t const *      m_sz,
+                                 ulong                 cnt)
+{
+    return _wd_ed25519_verify_req_batch(sub, msg, sz, sig, public_key,
+                                        m_seq, m_chunk, m_ctrl, m_sz, cnt);
+}
+
+void wd_sub_credit_policy(wd_sub_t* sub, uint32_t interval)
+{
+    sub->cr_interval = interval;
+}
+
+void wd_sub_timeout(wd_sub_t* sub, int64_t timeout_ns)
+{
+    sub->timeout_ns = timeout_ns;
+}
+
+void wd_sub_spill(wd_sub_t* sub, wd_cpu_t* cpu, int64_t spill_ns)
+{
+    sub->cpu      = cpu;
+    sub->spill_ns = spill_ns;
+}
+
+void wd_sub_spill_at(wd_sub_t* sub, int64_t pend, int64_t dma)
+{
+    sub->spill_pend = pend < WD_BP_PEND_MAX ? pend : WD_BP_PEND_MAX;
+    sub->spill_dma  = dma  < WD_BP_DMA_MAX  ? dma  : WD_BP_DMA_MAX;
+    // take the new levels on the next look at each slot
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        sub->cr[slot].avail = 0;
+}
+
+void wd_ed25519_verify_cache(wd_wksp_t* wd, wd_cache_t* cache)
+{
+    wd->cache = cache;
+}
+
+void wd_ed25519_verify_inflight(wd_wksp_t* wd, wd_infl_t* infl)
+{
+    if (infl)
+        infl->pick = wd->sv.resp_seq;
+    wd->infl = infl;
+}
+
+void wd_ed25519_verify_evt(wd_wksp_t* wd, wd_evt_t* evt)
+{
+    wd->evt = evt;
+}
+
+void wd_ed25519_verify_rob(wd_wksp_t* wd, wd_rob_t* rob)
+{
+    if (rob)
+    {
+        rob->wd   = wd;
+        rob->head = wd->sv.resp_seq;
+    }
+    wd->rob = rob;
+}
+
+void wd_sub_sched(wd_sub_t* sub, uint32_t policy)
+{
+    sub->sched = policy;
+}
+
+void wd_sub_encoder(wd_sub_t* sub, uint32_t enc)
+{
+    sub->enc = enc;
+}
+
+void wd_sub_credit_refresh(wd_sub_t* sub)
+{
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        if (sub->slots & (1UL << slot))
+            _wd_credit_refresh(sub, slot);
+}
+
+void wd_sub_credit_return(wd_sub_t* sub, uint32_t slot, uint64_t n)
+{
+    wd_credit_t * cr = &sub->cr[slot];
+    cr->avail += (int64_t)n;
+    if (cr->avail > cr->share)
+        cr->avail = cr->share;
+    cr->load  -= (int64_t)(n * (cr->n_req ? cr->n_beat / cr->n_req : 4));
+    if (cr->load < 0)
+        cr->load = 0;
+    sub->n_ret += n;
 }
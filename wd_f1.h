@@ -1,6 +1,8 @@
 #ifndef HEADER_fd_src_wiredancer_wd_f1_h
 #define HEADER_fd_src_wiredancer_wd_f1_h
 
+#include <errno.h>
+#include <sched.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -26,7 +28,55 @@
 #define WD_N_PCI_SLOTS          8
 #define WD_N_PCI_STREAMS        32
 
-#define WD_TRY_LIMIT            1000000
+// blocking submits: how long a handle waits for credit (see
+// wd_sub_timeout) and the bounds of its backoff while it does
+#define WD_TIMEOUT_DFLT         1000000000L     // 1 s
+#define WD_TIMEOUT_NONE         (-1L)
+#define WD_BACKOFF_DRAIN_NS     10000L          // initial stall estimate
+#define WD_BACKOFF_DRAIN_MIN_NS 1000L
+#define WD_BACKOFF_DRAIN_MAX_NS 10000000L
+#define WD_BACKOFF_SPIN_MAX_NS  20000L
+#define WD_BACKOFF_SLEEP_MAX_NS 1000000L
+
+// bring-up: how long a vLED query may take to be answered, and how
+// long vDIP writes are given to settle on a slot without vLED readback
+#define WD_VLED_TIMEOUT_NS      2000000L        // 2 ms
+#define WD_VDIP_SETTLE_NS       10000000L       // 10 ms
+
+// backpressure: a submit handle holds credits per slot, one per request
+// the slot can still take.  A refresh reads the fill register and sets
+// them to the room its pipe-chain and DMA buffer levels leave below
+// WD_BP_PEND_MAX / WD_BP_DMA_MAX; every request sent spends one.
+// WD_BP_INTERVAL is the refresh interval of the original fixed-cadence
+// check (see wd_sub_credit_policy)
+#define WD_BP_INTERVAL          16
+#define WD_BP_PEND_MAX          (256 + WD_BP_INTERVAL)
+#define WD_BP_DMA_MAX           (256 + WD_BP_INTERVAL)
+#define WD_BATCH_BYTES_MAX      (1UL << 19)     // half a stream window
+
+// slot scheduling policies, see wd_sub_sched
+#define WD_SCHED_RR             0
+#define WD_SCHED_LEAST          1
+#define WD_SCHED_P2C            2
+#define WD_SCHED_STALE          256     // requests a load estimate is good for
+
+// request encoders, see wd_sub_encoder
+#define WD_ENC_SIZED            0
+#define WD_ENC_GENERIC          1
+#define WD_ENC_NB_MAX           39      // message beats with a sized kernel (1248 B)
+
+// response path: the poller tracks WD_RESP_WINDOW m_seq values past the
+// oldest unresolved one and stops scanning after WD_RESP_GAP lines in a
+// row that are not written yet (one full credit run on a slot)
+#define WD_RESP_WINDOW          4096
+#define WD_RESP_GAP             WD_BP_PEND_MAX
+#define WD_SCAN_PREFETCH        16      // lines prefetched ahead of a scan
+
+// DMA region: up to WD_DMA_PAGE_MAX hugepages of one size (2 MiB, or
+// a single 1 GiB page)
+#define WD_DMA_PAGE_2M          (1UL << 21)
+#define WD_DMA_PAGE_1G          (1UL << 30)
+#define WD_DMA_PAGE_MAX         512
 
 // wd_dma kernel module ioctl commands
 #define WD_IOC_MAGIC          'W'
@@ -42,62 +92,410 @@ typedef struct {
 
 } wd_pci_st_t;
 
+typedef struct wd_pci wd_pci_t;
+typedef struct wd_trace wd_trace_t;
+
+/* wd_dev_t is the device backend underneath the private MMIO, BAR4
+   streaming, vDIP and DMA pinning primitives.  wd_dev_f1 drives the
+   AWS FPGA through the SDK and /dev/wd_dma.  wd_dev_emu (wd_emu.h) is
+   an in-process software model of the same register map and request
+   stream.
+   attach/detach bring a slot up/down (pci->slot and pci->dev_ctx are
+   set before attach is called).  write_256 sends one 32-byte beat at
+   stream offset off, flush makes all beats of stream si visible to the
+   device.  set_vdip writes one raw 16-bit vDIP command, get_vled reads
+   the 16-bit vLED status the device answers with.  pin_hugepage maps
+   the page_sz hugepage at hp_addr for device DMA and returns its
+   IOVA. */
 typedef struct {
 
+    char const *        name;
+    int                 (*attach)       (wd_pci_t* pci);
+    void                (*detach)       (wd_pci_t* pci);
+    uint32_t            (*read_32)      (wd_pci_t* pci, uint32_t addr);
+    void                (*write_32)     (wd_pci_t* pci, uint32_t addr, uint32_t v);
+    void                (*write_256)    (wd_pci_t* pci, uint64_t off, __m256i v);
+    void                (*flush)        (wd_pci_t* pci, uint32_t si);
+    int                 (*set_vdip)     (wd_pci_t* pci, uint16_t v);
+    int                 (*get_vled)     (wd_pci_t* pci, uint16_t* v);
+    uint64_t            (*pin_hugepage) (void* dev_ctx, void* hp_addr, uint64_t page_sz);
+
+} wd_dev_t;
+
+extern wd_dev_t const   wd_dev_f1;
+
+struct wd_pci {
+
     pci_bar_handle_t    bar0;
     pci_bar_handle_t    bar4;
     void*               bar4_addr;
     wd_pci_st_t         stream[WD_N_PCI_STREAMS];
 
-} wd_pci_t;
+    wd_dev_t const *    dev;
+    void*               dev_ctx;
+    uint32_t            slot;
+
+    int                 numa_node;      // -1: unknown
+    cpu_set_t           cpus;           // cores local to the slot, empty: unknown
+    wd_trace_t *        trace;          // NULL unless wd_trace_start
+
+    // bring-up, see wd_ed25519_verify_init_req
+    uint64_t            vdip[2];        // mcache base and mask as programmed
+    uint16_t            vdip_dirty;     // bytes written, not yet read back
+    uint16_t            vled_cmd;       // last vLED query, 0xffff: unknown
+    uint8_t             vled_rb;        // vLED readback: 0 not probed, 1 yes, 2 no
+    int64_t             settle_ns;      // no readback: vDIP settled at, 0: done
+    uint32_t            n_vdip_wr;      // vDIP bytes the last init wrote
+    uint32_t            n_vdip_skip;    // ... and found already in place
+
+};
+
+/* wd_dma_t is a workspace's DMA region: n_page hugepages of 1<<page_lg
+   bytes each, virtually contiguous from base, and the IOVA each one was
+   pinned at.  Translation is one shift and one table load. */
+typedef struct {
+
+    uint8_t *           base;
+    uint64_t            sz;
+    uint32_t            page_lg;
+    uint32_t            n_page;
+    uint64_t            iova[WD_DMA_PAGE_MAX];
+
+} wd_dma_t;
 
 typedef struct {
 
-    uint32_t            req_slot;
     uint64_t            req_depth;
+    fd_frag_meta_t *    mcache;
+    uint8_t             send_fails;     // as passed to init_req
+
+    // response path, see wd_ed25519_verify_poll_resp
+    uint64_t            resp_seq;       // oldest unresolved m_seq
+    uint64_t            resp_win;       // m_seqs tracked from resp_seq
+    uint64_t            resp_done[WD_RESP_WINDOW/64];
+    uint64_t            n_resp;
+    uint64_t            n_lost;
+    int                 resp_flush;     // DMA not coherent, see wd_ed25519_verify_scan
 
 } wd_ed25519_verify_t;
 
+/* wd_credit_t is a submit handle's view of one slot: the requests it
+   may still send there, the requests sent since the last refresh and
+   the load estimate the scheduler ranks slots by.  load is in 32-byte
+   stream beats: what the last refresh saw queued on the slot (requests
+   counted at the handle's mean request size there) plus every beat
+   sent since.  n_req and n_beat count all the handle ever sent to the
+   slot, for checking the balance. */
 typedef struct {
 
+    int64_t             avail;
+    int64_t             share;          // most a refresh grants the handle
+    uint64_t            since;
+    int64_t             load;
+    uint64_t            at;             // handle's n_req at the refresh
+    uint64_t            n_req;
+    uint64_t            n_beat;
+
+} wd_credit_t;
+
+typedef struct wd_cpu wd_cpu_t;
+typedef struct wd_cache wd_cache_t;
+typedef struct wd_rob wd_rob_t;
+typedef struct wd_infl wd_infl_t;
+typedef struct wd_evt wd_evt_t;
+
+/* wd_sub_t is a submit handle.  It owns stream si on every slot in
+   slots and keeps its own address cursor per slot, slot choice and
+   backpressure interval, so handles on different streams can submit
+   from different threads without a lock or a shared written cache
+   line.  wd_pci_t.stream[] only describes each stream's address
+   window.  The workspace's own wd_ed25519_verify_req path is the
+   handle wd->sub, which owns stream 0.
+   Flow control is credit based (see wd_sub_credit_policy), so the fill
+   register is read only when the handle runs out of credit on its
+   current slot.  n_mmio counts those reads and n_stall the ones that
+   came back without enough room; n_ret counts credits handed back by
+   wd_sub_credit_return.  Which slot a request goes to is up to the
+   handle's scheduling policy (see wd_sub_sched).  When no slot has
+   room, blocking calls back off (see wd_sub_timeout); n_wait counts the
+   stalls they waited out, wait_ns the time that took and n_timeout the
+   ones they gave up on.  With a CPU pool attached (wd_sub_spill), n_spill
+   counts the requests it took instead.  With a verified-signature cache
+   on the workspace (wd_ed25519_verify_cache), n_hit counts the requests
+   it completed and n_miss the ones that went on. */
+typedef struct wd_sub {
+
+    struct wd_wksp *    wd;
+    uint64_t            slots;
+    uint32_t            si;
+    uint32_t            req_slot;
+    uint64_t            n_req;
+    wd_pci_st_t         st[WD_N_PCI_SLOTS];
+
+    uint32_t            sched;
+    uint32_t            cr_interval;
+    uint32_t            enc;
+    uint64_t            rng;
+    wd_credit_t         cr[WD_N_PCI_SLOTS];
+    uint64_t            n_mmio;
+    uint64_t            n_stall;
+    uint64_t            n_ret;
+
+    int64_t             timeout_ns;
+    int64_t             drain_ns;       // how long stalls take to clear
+    uint64_t            n_wait;
+    uint64_t            n_timeout;
+    uint64_t            wait_ns;
+
+    wd_cpu_t *          cpu;
+    int64_t             spill_ns;
+    int64_t             spill_pend;     // device levels spilled above
+    int64_t             spill_dma;
+    uint64_t            n_spill;
+
+    uint64_t            n_hit;
+    uint64_t            n_miss;
+
+} __attribute__((aligned(64))) wd_sub_t;
+
+typedef struct wd_lat wd_lat_t;
+
+typedef struct wd_wksp {
+
     int                 initialized;
     uint64_t            pci_slots;
-    uint32_t            *stream_buf;
     wd_pci_t            pci[32];
     wd_ed25519_verify_t sv;
+    wd_dev_t const *    dev;
+    void*               dev_ctx;
+    uint32_t            st_own[WD_N_PCI_SLOTS];
+    uint32_t *          st_owned;       // streams with a handle, st_own or wd_shm's
+    wd_sub_t            sub;
+    wd_dma_t            dma;
+    wd_lat_t *          lat;            // NULL unless wd_lat_init
+    wd_cache_t *        cache;          // NULL unless wd_ed25519_verify_cache
+    wd_rob_t *          rob;            // NULL unless wd_ed25519_verify_rob
+    wd_infl_t *         infl;           // NULL unless wd_ed25519_verify_inflight
+    wd_evt_t *          evt;            // NULL unless wd_ed25519_verify_evt
 } wd_wksp_t;
 
+/* Result lines.  For every request whose signature verifies (and for
+   failing ones too when send_fails is set) the device writes one
+   fd_frag_meta_t into the mcache line at dma_addr, publishing it the
+   same way fd_mcache_publish does (seq last).  seq, chunk, sz and ctl
+   echo the request's m_seq, m_chunk, m_sz and m_ctrl; sig holds the
+   verify result (WD_ED25519_RES_PASS or WD_ED25519_RES_FAIL). */
+#define WD_ED25519_RES_FAIL     0UL
+#define WD_ED25519_RES_PASS     1UL
+/* host side only: the result line was overwritten before it was read */
+#define WD_ED25519_RES_LOST     2UL
+
+/* wd_ed25519_verify_resp_t is one completion as returned by
+   wd_ed25519_verify_poll_resp.  tsorig/tspub are the device timestamps
+   of the result line. */
+typedef struct {
+
+    uint64_t            seq;
+    uint32_t            chunk;
+    uint32_t            res;            // WD_ED25519_RES_*
+    uint32_t            tsorig;
+    uint32_t            tspub;
+
+} wd_ed25519_verify_resp_t;
+
+/* wd_init_pci attaches the FPGA slots in the slots bitmask through the
+   AWS SDK and looks up where each one sits: the NUMA node and the local
+   cores of its PCIe function, from sysfs.  wd_init_dev does the same
+   through an arbitrary backend; the emulator's slots have no location.
+   With more than one slot, each is attached on a thread of its own
+   (the SDK calls themselves one at a time).  Returns -1, with every
+   slot detached again, if any slot fails to attach. */
 int                     wd_init_pci      (wd_wksp_t* wd, uint64_t slots);
+int                     wd_init_dev      (wd_wksp_t* wd, uint64_t slots, wd_dev_t const* dev, void* dev_ctx);
 int                     wd_free_pci      (wd_wksp_t* wd);
 
-void *                  wd_dma_base_ptr  (void);
-uint64_t                wd_dma_base_iova (void);
+/* Placement.  BAR4 streaming stores and the result line DMA both cross
+   the socket interconnect unless the submitting thread and the mcache
+   are on the slot's node.  wd_slot_node returns the slot's NUMA node,
+   -1 if unknown.  wd_wksp_node returns the node all of wd's slots share,
+   -1 if they are on different nodes or unknown.  wd_slot_cpus sets cpus
+   to the cores recommended for the threads that submit to or poll the
+   slot (its local cores, every online core if unknown) and returns
+   their count.  wd_node_cpus does the same for the cores of node and
+   returns -1 if there is no such node.
+   wd_hp_alloc maps sz bytes (a multiple of page_sz, WD_DMA_PAGE_2M or
+   WD_DMA_PAGE_1G) of zeroed hugepages bound to node (any node if -1),
+   NULL on failure; the pages are faulted in before it returns, so they
+   can go to wd_dma_map.  wd_hp_free unmaps them. */
+int                     wd_slot_node     (wd_wksp_t const* wd, uint32_t slot);
+int                     wd_wksp_node     (wd_wksp_t const* wd);
+int                     wd_slot_cpus     (wd_wksp_t const* wd, uint32_t slot, cpu_set_t* cpus);
+int                     wd_node_cpus     (int node, cpu_set_t* cpus);
+void *                  wd_hp_alloc      (uint64_t sz, uint64_t page_sz, int node);
+void                    wd_hp_free       (void* hp, uint64_t sz);
+
+/* wd_dma_map pins the sz bytes at addr, page_sz (WD_DMA_PAGE_2M or
+   WD_DMA_PAGE_1G) hugepages backing them, as wd's DMA region.  addr
+   must be page_sz aligned and sz a multiple of page_sz.  Returns -1 if
+   the region is malformed or too large.  wd_ed25519_verify_init_req
+   maps the mcache as 2 MiB pages itself when no region has been mapped;
+   map one first for a 1 GiB page.
+   wd_get_phys translates an address inside the region to its IOVA. */
+int                     wd_dma_map       (wd_wksp_t* wd, void* addr, uint64_t sz, uint64_t page_sz);
+void *                  wd_dma_base_ptr  (wd_wksp_t* wd);
+uint64_t                wd_dma_base_iova (wd_wksp_t* wd);
+
+/* Pipeline counters, read with wd_snp_cntrs + wd_rd_cntr.  wd_tel.h
+   has their names and a background sampler. */
+#define WD_CNTR_PAD_IN          1
+#define WD_CNTR_PAD_OUT         2
+#define WD_CNTR_SHA_OUT         3
+#define WD_CNTR_SV0_OUT         4
+#define WD_CNTR_SV2_F           5
+#define WD_CNTR_SV2_OUT         6
+#define WD_CNTR_ECC_OUT         7
+#define WD_CNTR_INPUT_COUNT     10
+#define WD_CNTR_INPUT_FILL      11
+#define WD_CNTR_INPUT_DROPS     12
+#define WD_CNTR_RESULT_COUNT    13
+#define WD_CNTR_RESULT_FILL     14
+#define WD_CNTR_RESULT_DROPS    15
+#define WD_CNTR_RESULT_DMA      16
 
 void                    wd_rst_cntrs     (wd_wksp_t* wd, uint32_t slot);
 void                    wd_snp_cntrs     (wd_wksp_t* wd, uint32_t slot);
 uint32_t                wd_rd_cntr       (wd_wksp_t* wd, uint32_t slot, uint32_t ci);
 uint64_t                wd_rd_ts         (wd_wksp_t* wd, uint32_t slot);
 
-uint64_t                wd_get_phys      (void* p);
+uint64_t                wd_get_phys      (wd_wksp_t* wd, void* p);
 void                    wd_zprintf       (const char* format, ...);
 
 /* wd_ed25519_verify_init_req initializes the internal state
-   of the request path. */
+   of the request path.  The mcache_depth 32-byte result lines at
+   mcache_addr must lie in IOVA-contiguous pages of wd's DMA region.
+   Every slot is programmed on a thread of its own: the pipe-chain and
+   sha_pad thresholds and send_fails (posted register writes, always
+   written), then the mcache base and mask in vDIP 0/1.  Those are read
+   back through vLED first, up to the first byte that differs, and
+   written in full unless all 16 bytes are in place, so restarting a
+   process against an already programmed card sends no vDIP writes at
+   all.  Readback is probed with the first query after attach; a slot
+   that does not answer it gets all 16 bytes written, as before.
+   wd_ed25519_verify_ready then waits, up to timeout_ns, until every
+   slot reads back the vDIP bytes written to it (without readback:
+   until WD_VDIP_SETTLE_NS after the writes), and returns 0, or -1 if
+   some slot did not in time.  It returns at once after an init that
+   found everything in place. */
 void
 wd_ed25519_verify_init_req( wd_wksp_t *        wd,
                             uint8_t            send_fails,
                             uint64_t           mcache_depth,
                             void*              mcache_addr);
+int
+wd_ed25519_verify_ready( wd_wksp_t *        wd,
+                         int64_t            timeout_ns);
 
 /* wd_ed25519_verify_init_resp initializes the internal state
-   of the response path. */
+   of the response path, to be called after wd_ed25519_verify_init_req.
+   seq0 is the first m_seq that will be sent.  Every line of the mcache
+   is stamped with the sequence number one lap before the one it expects
+   next, so a zeroed mcache does not read as completed.  Pass
+   send_fails=1 to init_req so that every request gets a result line;
+   with 0 a failing request is only ever resolved as lost, which
+   init_resp warns about. */
+void
+wd_ed25519_verify_init_resp( wd_wksp_t *       wd,
+                             uint64_t          seq0);
+
+/* wd_ed25519_verify_cache puts the verified-signature cache (wd_cache.h,
+   NULL to remove it) in front of every submit on wd.  A request whose
+   (signature, public key, message) has passed before completes at once:
+   its result line is written to the mcache as the device would write
+   it (res WD_ED25519_RES_PASS, tsorig/tspub the time of the hit in
+   250 MHz CLOCK_MONOTONIC ticks) and nothing goes over PCIe.  Every
+   other request is noted and cached once wd_ed25519_verify_poll_resp
+   sees it pass, so the cache only fills while the response path is
+   polled.  Set it before any handle submits. */
+void
+wd_ed25519_verify_cache( wd_wksp_t *           wd,
+                         wd_cache_t *          cache);
+
+/* wd_ed25519_verify_rob puts the reorder buffer rob (wd_rob.h, NULL to
+   remove it) on wd, after wd_ed25519_verify_init_resp: its head starts
+   at the oldest unresolved m_seq.  From then on every submit on wd
+   waits, within its timeout, until its m_seq is less than rob's depth
+   past the oldest m_seq rob has not released, and results are polled
+   with wd_rob_poll. */
 void
-wd_ed25519_verify_init_resp( wd_wksp_t *       wd);
+wd_ed25519_verify_rob( wd_wksp_t *             wd,
+                       wd_rob_t *              rob);
+
+/* wd_ed25519_verify_inflight puts the in-flight table infl (wd_infl.h,
+   NULL to remove it) on wd, after wd_ed25519_verify_init_resp and
+   before any handle submits.  Every request sent from then on is noted
+   in it, and every poll of the response path retires the ones reported
+   and resubmits the ones past their deadline. */
+void
+wd_ed25519_verify_inflight( wd_wksp_t *        wd,
+                            wd_infl_t *        infl);
+
+/* wd_ed25519_verify_evt puts the event log evt (wd_evt.h, NULL to
+   remove it) on wd.  Submits and polls on wd log their requests'
+   lifecycle into it from the next call on. */
+void
+wd_ed25519_verify_evt( wd_wksp_t *             wd,
+                       wd_evt_t *              evt);
+
+/* wd_ed25519_verify_poll_resp returns up to max completions into resp,
+   in no particular order, without blocking.  Only the lines of the
+   m_seqs from the oldest unresolved one onward are read (an acquire
+   load of the line's seq, the fields, then the seq again), and a line
+   is reported once.  A line holding a newer m_seq than expected means
+   the device lapped the consumer; it is reported with res
+   WD_ED25519_RES_LOST and counted in wd->sv.n_lost.  So is the oldest
+   unresolved m_seq once WD_RESP_WINDOW later ones have completed
+   (e.g. the request was dropped).  Single consumer. */
+ulong
+wd_ed25519_verify_poll_resp( wd_wksp_t *                 wd,
+                             wd_ed25519_verify_resp_t *  resp,
+                             ulong                       max);
+
+/* wd_ed25519_verify_scan is the in-order fast path of the response
+   path: it checks the lines from the oldest unresolved m_seq (the
+   watermark, wd->sv.resp_seq) onward, 4 at a time with one AVX2 compare
+   of their seqs against the expected ones, prefetching
+   WD_SCAN_PREFETCH lines ahead, and returns the length n (up to max)
+   of the run that holds its expected m_seq: the results of m_seqs
+   resp_seq .. resp_seq+n-1 are ready in their mcache lines.  Read them
+   like any mcache consumer (and check seq again afterwards, the device
+   may lap a slow reader), then call wd_ed25519_verify_scan_done with n
+   to move the watermark past them.  Nothing is consumed until then.
+   scan_done reads each line's result again for what poll_resp does
+   per result (latency, cache, in-flight tracking, event log), when
+   any of those are set up.
+   It stops at the first line not written yet, so a dropped request or
+   a send_fails=0 failure stalls it: use wd_ed25519_verify_poll_resp,
+   which resolves those, whenever a run comes back short for too long.
+   The two can be mixed: a run also ends at a line poll_resp has
+   already reported, and scan_done retires those behind the run.
+   With wd->sv.resp_flush set (DMA that does not snoop the CPU caches),
+   each line is flushed right before it is read instead of the whole
+   region.  x86 DMA is coherent and needs no flush.  Single consumer. */
+ulong
+wd_ed25519_verify_scan( wd_wksp_t *           wd,
+                        ulong                 max);
+
+void
+wd_ed25519_verify_scan_done( wd_wksp_t *      wd,
+                             ulong            n);
 
 
 /* wd_ed25519_verify_req sends a verification request to the underlying
    hardware to verify the message according to the ED25519 standard.
-   The function blocks until the request can be sent to the hardware.
+   The function blocks until the request can be sent to the hardware,
+   which it learns from wd->sub's credits; the fill register is only
+   read when they run out.  It waits at most wd->sub's timeout (see
+   wd_sub_timeout).
    msg is assumed to point to the first byte of a sz byte memory region
    which holds the message to verify (sz==0 fine, msg==NULL fine if
    sz==0).
@@ -111,7 +509,9 @@ wd_ed25519_verify_init_resp( wd_wksp_t *       wd);
    ctrl shows start_of_packet and end_of_packet boundaries.
    ctrl[0] == sop
    ctrl[1] == eop
-   Returns zero on success. */
+   Returns zero on success, ETIMEDOUT if no slot, or the reorder buffer
+   (wd_ed25519_verify_rob), had room in time (the request was not
+   sent). */
 
 int
 wd_ed25519_verify_req( wd_wksp_t *   wd,
@@ -124,4 +524,271 @@ wd_ed25519_verify_req( wd_wksp_t *   wd,
                        uint16_t      m_ctrl,
                        uint16_t      m_sz);
 
+/* wd_ed25519_verify_try_req is wd_ed25519_verify_req without the
+   wait: it tries each slot of wd->sub once (reading the fill register
+   of those it is out of credit on) and returns EAGAIN if none had room,
+   or the reorder buffer had none,
+   so the caller can do other work, e.g. drain results, and try again. */
+
+int
+wd_ed25519_verify_try_req( wd_wksp_t *   wd,
+                           void const *  msg,
+                           ulong         sz,
+                           void const *  sig,
+                           void const *  public_key,
+                           uint64_t      m_seq,
+                           uint32_t      m_chunk,
+                           uint16_t      m_ctrl,
+                           uint16_t      m_sz);
+
+/* wd_ed25519_verify_req_batch sends cnt verification requests, request
+   i being described by element i of each array exactly as for
+   wd_ed25519_verify_req.  Instead of a fence per request, the batch is
+   cut into runs of as many requests as the current slot has credit for,
+   up to WD_BATCH_BYTES_MAX stream bytes; each run goes to one slot back
+   to back and ends with one fence.
+   Returns the number of requests sent, which is less than cnt only if
+   no slot, or the reorder buffer, had room within wd->sub's timeout
+   (the remaining requests were not sent). */
+
+ulong
+wd_ed25519_verify_req_batch( wd_wksp_t *           wd,
+                             void const * const *  msg,
+                             ulong const *         sz,
+                             void const * const *  sig,
+                             void const * const *  public_key,
+                             uint64_t const *      m_seq,
+                             uint32_t const *      m_chunk,
+                             uint16_t const *      m_ctrl,
+                             uint16_t const *      m_sz,
+                             ulong                 cnt);
+
+/* wd_sub_init claims stream si (1..WD_N_PCI_STREAMS-1) on every slot
+   in slots (must be a subset of wd's) for the handle sub.  Each handle
+   must only be used by one thread at a time; different handles need no
+   coordination.  Returns -1 if the stream is already owned on one of
+   the slots.  wd_sub_fini releases the streams. */
+int                     wd_sub_init      (wd_sub_t* sub, wd_wksp_t* wd, uint32_t si, uint64_t slots);
+void                    wd_sub_fini      (wd_sub_t* sub);
+
+/* wd_ed25519_verify_req_sub, wd_ed25519_verify_try_req_sub and
+   wd_ed25519_verify_req_batch_sub are wd_ed25519_verify_req,
+   wd_ed25519_verify_try_req and wd_ed25519_verify_req_batch on a
+   handle. */
+
+int
+wd_ed25519_verify_req_sub( wd_sub_t *    sub,
+                           void const *  msg,
+                           ulong         sz,
+                           void const *  sig,
+                           void const *  public_key,
+                           uint64_t      m_seq,
+                           uint32_t      m_chunk,
+                           uint16_t      m_ctrl,
+                           uint16_t      m_sz);
+
+int
+wd_ed25519_verify_try_req_sub( wd_sub_t *    sub,
+                               void const *  msg,
+                               ulong         sz,
+                               void const *  sig,
+                               void const *  public_key,
+                               uint64_t      m_seq,
+                               uint32_t      m_chunk,
+                               uint16_t      m_ctrl,
+                               uint16_t      m_sz);
+
+ulong
+wd_ed25519_verify_req_batch_sub( wd_sub_t *            sub,
+                                 void const * const *  msg,
+                                 ulong const *         sz,
+                                 void const * const *  sig,
+                                 void const * const *  public_key,
+                                 uint64_t const *      m_seq,
+                                 uint32_t const *      m_chunk,
+                                 uint16_t const *      m_ctrl,
+                                 uint16_t const *      m_sz,
+                                 ulong                 cnt);
+
+/* wd_sub_credit_policy sets when a handle refreshes its credits on a
+   slot.  With interval 0 (the default) it refreshes only when they run
+   out.  Otherwise it also refreshes after interval requests on the slot
+   (WD_BP_INTERVAL gives the cadence of the original per-16 check),
+   bounding how stale its view of the device can get.
+   A refresh grants a slot's room divided by the number of streams
+   claimed on it, so handles sharing a slot cannot together overrun it.
+   wd_sub_credit_refresh refreshes every slot of the handle now; call it
+   when the producer is idle to keep the fill reads off the hot path.
+   wd_sub_credit_return hands back n credits on slot for requests seen
+   completing in the mcache, up to the handle's share of the slot as of
+   its last refresh.  The device writes no result line for a
+   dropped request, or for a failing one unless send_fails is set, so
+   returns alone undercount completions; the refresh on exhaustion makes
+   up for that.  Only return credits for requests this handle sent to
+   that slot. */
+void                    wd_sub_credit_policy  (wd_sub_t* sub, uint32_t interval);
+void                    wd_sub_credit_refresh (wd_sub_t* sub);
+void                    wd_sub_credit_return  (wd_sub_t* sub, uint32_t slot, uint64_t n);
+
+/* wd_sub_sched sets how a handle spreads requests over its slots.  A
+   request (or a batch run) only goes to a slot the handle holds credit
+   on; the policy decides which of them:
+
+     WD_SCHED_RR     the next slot in turn (the default)
+     WD_SCHED_LEAST  the slot with the lowest load estimate
+     WD_SCHED_P2C    the lower-loaded of two slots picked at random
+
+   RR skips slots that are out of credit and do not grant any on a
+   refresh.  LEAST and P2C refresh a candidate whose estimate has seen
+   WD_SCHED_STALE of the handle's requests go by, and the candidates
+   out of credit when the pick is; one that grants nothing counts as
+   full until its next refresh.  Between refreshes the estimates cost
+   nothing to keep up (see wd_credit_t), so LEAST adds a scan of the
+   handle's slots per request and about one fill read per slot every
+   WD_SCHED_STALE requests; with one slot every policy is the same.
+   sub->cr[slot].n_req/n_beat show where requests went. */
+void                    wd_sub_sched          (wd_sub_t* sub, uint32_t policy);
+
+/* wd_sub_encoder sets how a handle encodes requests onto the stream.
+   WD_ENC_SIZED (the default) picks a kernel compiled for the request's
+   message beat count (up to WD_ENC_NB_MAX, larger messages take the
+   generic loop): every beat unrolled, the padding beat decided at
+   compile time, and when the whole request fits before the stream's
+   next flush point, beats written at fixed offsets with one stream
+   update instead of a flush check per beat.  WD_ENC_GENERIC always
+   takes the loop; the two send the same bytes. */
+void                    wd_sub_encoder        (wd_sub_t* sub, uint32_t enc);
+
+/* wd_sub_timeout sets how long a handle's blocking calls wait for room
+   on a slot: timeout_ns, WD_TIMEOUT_NONE for as long as it takes, 0 to
+   not wait at all (the single request calls then return EAGAIN like
+   the try ones).  The default is WD_TIMEOUT_DFLT.  While waiting the
+   handle retries with a backoff tuned to how long its stalls have been
+   taking to clear: pause-spin for the first quarter of that (up to
+   WD_BACKOFF_SPIN_MAX_NS), then sched_yield, then sleeps doubling up
+   to WD_BACKOFF_SLEEP_MAX_NS, so a short stall is caught within a fill
+   read and a long one neither holds the core nor keeps reading the
+   fill register. */
+void                    wd_sub_timeout        (wd_sub_t* sub, int64_t timeout_ns);
+
+/* wd_sub_spill attaches the CPU verify pool cpu (wd_cpu.h, NULL to
+   detach) to a handle.  A request that finds no slot with room, i.e.
+   every slot's pipe-chain or DMA buffer is at the handle's spill levels
+   (WD_BP_PEND_MAX / WD_BP_DMA_MAX unless set lower with
+   wd_sub_spill_at) less the credits of the other handles, waits at
+   most spill_ns for one (0: not at all) and is then queued on the pool
+   instead; only if the pool is full too does it wait out the rest of
+   the handle's timeout as usual.  The pool writes the result into the
+   same mcache line, so wd_ed25519_verify_poll_resp sees no difference
+   (latency is not recorded for spilled requests).  Completions from the
+   two paths interleave, so a request held up in the device while
+   WD_RESP_WINDOW later ones complete on the CPU is reported lost.  The
+   try calls never wait before spilling.  The pool must publish into
+   wd's mcache with the workspace's send_fails setting. */
+void                    wd_sub_spill          (wd_sub_t* sub, wd_cpu_t* cpu, int64_t spill_ns);
+
+/* wd_sub_spill_at sets the pipe-chain (pend) and DMA buffer levels a
+   handle with a CPU pool stops sending to a slot at, clamped to
+   WD_BP_PEND_MAX / WD_BP_DMA_MAX: lower levels spill earlier and keep
+   the device's queues, and so its latency, shorter.  Without a pool
+   the handle always fills up to the limits. */
+void                    wd_sub_spill_at       (wd_sub_t* sub, int64_t pend, int64_t dma);
+
+/* Latency instrumentation (opt-in, see wd_lat_init).  Each request's
+   TSC is recorded when the submit call starts and when its beats have
+   been flushed; when wd_ed25519_verify_poll_resp reads the result line
+   the request's latency is split into phases and added to one
+   histogram per phase, slot and message size class:
+
+     QUEUE  submit call to flush (credit wait, encoding)
+     PCIE   flush to the device taking the request in (tsorig)
+     PIPE   tsorig to the result line being written (tspub)
+     DMA    tspub to the poller reading it
+     TOTAL  submit call to the poller reading it
+
+   The device phases need the slot's device clock calibrated against
+   the TSC (wd_lat_calibrate); without it only QUEUE and TOTAL count.
+   Histograms are HDR-style: exact below 2^(WD_LAT_SUB_LG+1) cycles,
+   then 2^WD_LAT_SUB_LG buckets per power of two (<= 12.5% error).
+   Recording is single writer (the polling thread) and never blocks a
+   reader. */
+#define WD_LAT_SUB_LG           3
+#define WD_LAT_N_BUCKET         (64 << WD_LAT_SUB_LG)
+#define WD_LAT_N_SZ             4       // msg sz <=64, <=256, <=1024, more
+
+#define WD_LAT_QUEUE            0
+#define WD_LAT_PCIE             1
+#define WD_LAT_PIPE             2
+#define WD_LAT_DMA              3
+#define WD_LAT_TOTAL            4
+#define WD_LAT_N_PHASE          5
+
+typedef struct {
+
+    uint64_t            cnt;
+    uint64_t            sum;
+    uint64_t            max;
+    uint64_t            b[WD_LAT_N_BUCKET];
+
+} wd_lat_hist_t;
+
+typedef struct {
+
+    uint64_t            seq;            // written last
+    uint64_t            t_sub;
+    uint64_t            t_sent;
+    uint32_t            slot;
+    uint32_t            sz;
+
+} wd_lat_rec_t;
+
+typedef struct {
+
+    uint64_t            tsc0;
+    uint64_t            dev0;
+    double              tsc_per_tick;   // 0 until calibrated
+    double              tick_per_tsc;
+
+} wd_lat_cal_t;
+
+struct wd_lat {
+
+    double              tsc_hz;
+    uint64_t            depth;
+    uint64_t            sample_mask;
+    wd_lat_cal_t        cal[WD_N_PCI_SLOTS];
+    wd_lat_hist_t       hist[WD_N_PCI_SLOTS][WD_LAT_N_SZ][WD_LAT_N_PHASE];
+    wd_lat_rec_t *      rec;            // one per mcache line
+
+};
+
+/* wd_lat_init turns the instrumentation on for wd, after
+   wd_ed25519_verify_init_req, for the requests whose m_seq is a
+   multiple of 2^sample_lg, and calibrates the TSC against
+   CLOCK_MONOTONIC and every slot's device clock against the TSC (about
+   20 ms).  A sampled request costs two TSC reads and one 32-byte store
+   on the submit side and one histogram update per phase on the poll
+   side; sample_lg of 4 or so makes it cheap enough to leave on.
+   wd_lat_calibrate redoes the device clock calibration; device and TSC
+   drift apart slowly, so every few minutes is plenty.
+   wd_lat_fini turns it off.  wd_lat_init returns -1 if out of memory. */
+int                     wd_lat_init      (wd_wksp_t* wd, uint32_t sample_lg);
+void                    wd_lat_calibrate (wd_wksp_t* wd);
+void                    wd_lat_fini      (wd_wksp_t* wd);
+
+/* wd_lat_add counts one value (TSC cycles, or anything else) in h,
+   single writer.  wd_lat_merge adds src's counts to dst.
+   wd_lat_quantile returns the upper bound, in TSC cycles, of the
+   bucket holding quantile q (0..1) of h, 0 if h is empty.  wd_lat_ns
+   converts TSC cycles to ns. */
+void                    wd_lat_add       (wd_lat_hist_t* h, uint64_t v);
+void                    wd_lat_merge     (wd_lat_hist_t* dst, wd_lat_hist_t const* src);
+uint64_t                wd_lat_quantile  (wd_lat_hist_t const* h, double q);
+double                  wd_lat_ns        (wd_wksp_t* wd, uint64_t cycles);
+
+/* wd_tsc_hz measures the TSC frequency against CLOCK_MONOTONIC over
+   10 ms; the latency, in-flight, trace and event code all calibrate
+   with it. */
+double                  wd_tsc_hz        (void);
+
 #endif
@@ -0,0 +1,251 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <x86intrin.h>
+
+#include "wd_infl.h"
+
+/* node states */
+#define _WD_INFL_IDLE           0       /* not tracked                 */
+#define _WD_INFL_WAIT           1       /* in the wheel, not due yet   */
+#define _WD_INFL_DUE            2       /* in the wheel, expired, no room to resubmit */
+#define _WD_INFL_DONE           3       /* completed                   */
+
+// IIIIIIIIII NNNNNNNN        NNNNNNNN FFFFFFFFFFFFFFFFFFFFFF LLLLLLLLLLL
+// I::::::::I N:::::::N       N::::::N F::::::::::::::::::::F L:::::::::L
+// I::::::::I N::::::::N      N::::::N F::::::::::::::::::::F L:::::::::L
+// II::::::II N:::::::::N     N::::::N FF::::::FFFFFFFFF::::F LL:::::::LL
+//   I::::I   N::::::::::N    N::::::N   F:::::F       FFFFFF   L:::::L
+//   I::::I   N:::::::::::N   N::::::N   F:::::F                L:::::L
+//   I::::I   N:::::::N::::N  N::::::N   F::::::FFFFFFFFFF      L:::::L
+//   I::::I   N::::::N N::::N N::::::N   F:::::::::::::::F      L:::::L
+//   I::::I   N::::::N  N::::N:::::::N   F:::::::::::::::F      L:::::L
+//   I::::I   N::::::N   N:::::::::::N   F::::::FFFFFFFFFF      L:::::L
+//   I::::I   N::::::N    N::::::::::N   F:::::F                L:::::L
+//   I::::I   N::::::N     N:::::::::N   F:::::F                L:::::L         LLLLLL
+// II::::::II N::::::N      N::::::::N FF:::::::FF            LL:::::::LLLLLLLLL:::::L
+// I::::::::I N::::::N       N:::::::N F::::::::FF            L::::::::::::::::::::::L
+// I::::::::I N::::::N        N::::::N F::::::::FF            L::::::::::::::::::::::L
+// IIIIIIIIII NNNNNNNN         NNNNNNN FFFFFFFFFFF            LLLLLLLLLLLLLLLLLLLLLLLL
+
+int wd_infl_init(wd_infl_t* infl, wd_sub_t* sub, uint64_t depth,
+                 int64_t deadline_ns, uint32_t max_retry)
+{
+    if (!depth || (depth & (depth - 1)) || depth > WD_INFL_NIL || deadline_ns <= 0)
+        return -1;
+
+    memset(infl, 0, sizeof(*infl));
+    infl->sub       = sub;
+    infl->depth     = depth;
+    infl->max_retry = max_retry;
+    infl->deadline  = (uint64_t)((double)deadline_ns * 1e-9 * wd_tsc_hz());
+
+    // a tick of about an eighth of the deadline
+    uint64_t tick = infl->deadline >> 3;
+    infl->tick_lg = tick ? 63 - (uint32_t)__builtin_clzl(tick) : 0;
+    infl->tick    = __rdtsc() >> infl->tick_lg;
+    for (uint32_t b = 0; b < WD_INFL_WHEEL; b ++)
+        infl->wheel[b] = WD_INFL_NIL;
+
+    infl->ent  = aligned_alloc(64, depth * sizeof(wd_infl_ent_t));
+    infl->node = aligned_alloc(64, depth * sizeof(wd_infl_node_t));
+    if (!infl->ent || !infl->node)
+    {
+        wd_infl_free(infl);
+        return -1;
+    }
+    memset(infl->node, 0, depth * sizeof(wd_infl_node_t));
+    memset(infl->ent,  0, depth * sizeof(wd_infl_ent_t));
+    // one lap back, so that no m_seq reads as noted already
+    for (uint64_t i = 0; i < depth; i ++)
+        infl->ent[i].seq = i - depth;
+    return 0;
+}
+
+void wd_infl_free(wd_infl_t* infl)
+{
+    free(infl->ent);
+    free(infl->node);
+    infl->ent  = NULL;
+    infl->node = NULL;
+}
+
+void
+wd_infl_note( wd_infl_t *   infl,
+              uint32_t      slot,
+              void const *  msg,
+              ulong         sz,
+              void const *  sig,
+              void const *  public_key,
+              uint64_t      m_seq,
+              uint32_t      m_chunk,
+              uint16_t      m_ctrl,
+              uint16_t      m_sz)
+{
+    wd_infl_ent_t * e = &infl->ent[m_seq & (infl->depth - 1)];
+    if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) == m_seq)
+        return;
+    e->t_sub      = __rdtsc();
+    e->msg        = msg;
+    e->sig        = sig;
+    e->public_key = public_key;
+    e->sz         = (uint32_t)sz;
+    e->m_chunk    = m_chunk;
+    e->m_ctrl     = m_ctrl;
+    e->m_sz       = m_sz;
+    e->slot       = (uint8_t)slot;
+    __atomic_store_n(&e->seq, m_seq, __ATOMIC_RELEASE);
+}
+
+static void
+_wd_infl_insert(wd_infl_t* infl, uint32_t i, uint64_t exp, uint8_t state)
+{
+    wd_infl_node_t * n = &infl->node[i];
+    if (exp < infl->tick)
+        exp = infl->tick;
+    uint32_t * b = &infl->wheel[exp & (WD_INFL_WHEEL - 1)];
+    n->exp   = exp;
+    n->state = state;
+    n->prev  = WD_INFL_NIL;
+    n->next  = *b;
+    if (*b != WD_INFL_NIL)
+        infl->node[*b].prev = i;
+    *b = i;
+    infl->n_pend ++;
+}
+
+static void
+_wd_infl_unlink(wd_infl_t* infl, uint32_t i)
+{
+    wd_infl_node_t * n = &infl->node[i];
+    if (n->state != _WD_INFL_WAIT && n->state != _WD_INFL_DUE)
+        return;
+    if (n->prev != WD_INFL_NIL)
+        infl->node[n->prev].next = n->next;
+    else
+        infl->wheel[n->exp & (WD_INFL_WHEEL - 1)] = n->next;
+    if (n->next != WD_INFL_NIL)
+        infl->node[n->next].prev = n->prev;
+    n->state = _WD_INFL_IDLE;
+    infl->n_pend --;
+}
+
+void wd_infl_done(wd_infl_t* infl, uint64_t m_seq)
+{
+    uint32_t         i = (uint32_t)(m_seq & (infl->depth - 1));
+    wd_infl_node_t * n = &infl->node[i];
+    if (n->seq == m_seq && n->n_retry && n->state != _WD_INFL_DONE)
+        infl->n_recover ++;
+    // a node still in the wheel for the m_seq a lap back gives it up
+    _wd_infl_unlink(infl, i);
+    n->seq   = m_seq;
+    n->state = _WD_INFL_DONE;
+}
+
+/* pick up the requests noted since, in m_seq order */
+static void
+_wd_infl_pickup(wd_infl_t* infl, uint64_t now)
+{
+    uint64_t mask = infl->depth - 1;
+    for (;;)
+    {
+        uint64_t        seq = infl->pick;
+        wd_infl_ent_t * e   = &infl->ent[seq & mask];
+        if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != seq)
+        {
+            // missing while the next one is noted: a submit that
+            // failed, or one still on its way
+            if (__atomic_load_n(&infl->ent[(seq + 1) & mask].seq, __ATOMIC_ACQUIRE) != seq + 1)
+            {
+                infl->pick_t0 = 0;
+                return;
+            }
+            if (!infl->pick_t0)
+                infl->pick_t0 = now;
+            if (now - infl->pick_t0 < infl->deadline)
+                return;
+            infl->n_skip ++;
+        }
+        else
+        {
+            uint32_t         i = (uint32_t)(seq & mask);
+            wd_infl_node_t * n = &infl->node[i];
+            // completed before it was picked up
+            if (n->seq != seq || n->state != _WD_INFL_DONE)
+            {
+                _wd_infl_unlink(infl, i);
+                n->seq     = seq;
+                n->n_retry = 0;
+                _wd_infl_insert(infl, i, ((e->t_sub + infl->deadline) >> infl->tick_lg) + 1, _WD_INFL_WAIT);
+            }
+        }
+        infl->pick_t0 = 0;
+        infl->pick ++;
+    }
+}
+
+/* node i is due at tick t: resubmit it, or give up on it */
+static void
+_wd_infl_expire(wd_infl_t* infl, uint32_t i, uint64_t now, uint64_t t)
+{
+    wd_infl_node_t * n   = &infl->node[i];
+    wd_infl_ent_t *  e   = &infl->ent[i];
+    wd_sub_t *       sub = infl->sub;
+    uint8_t          due = n->state == _WD_INFL_DUE;
+
+    _wd_infl_unlink(infl, i);
+    if (!due)
+    {
+        infl->n_expire ++;
+        if (e->slot < WD_N_PCI_SLOTS)
+            infl->n_expire_slot[e->slot] ++;
+    }
+    if (!sub || n->n_retry >= infl->max_retry)
+    {
+        infl->n_give_up += !!sub;
+        return;
+    }
+
+    // round robin moves on from the slot it was lost on
+    if (e->slot < WD_N_PCI_SLOTS)
+        sub->req_slot = e->slot;
+    if (wd_ed25519_verify_try_req_sub(sub, e->msg, e->sz, e->sig, e->public_key,
+                                      n->seq, e->m_chunk, e->m_ctrl, e->m_sz))
+    {
+        infl->n_defer ++;
+        _wd_infl_insert(infl, i, t, _WD_INFL_DUE);
+        return;
+    }
+    e->slot  = (uint8_t)sub->req_slot;
+    e->t_sub = now;
+    n->n_retry ++;
+    infl->n_retry ++;
+    _wd_infl_insert(infl, i, ((now + infl->deadline) >> infl->tick_lg) + 1, _WD_INFL_WAIT);
+}
+
+void wd_infl_poll(wd_infl_t* infl)
+{
+    uint64_t now = __rdtsc();
+    _wd_infl_pickup(infl, now);
+
+    uint64_t t = now >> infl->tick_lg;
+    if (t <= infl->tick)
+        return;
+
+    // the buckets of the ticks gone by, each once at most
+    uint64_t n = t - infl->tick < WD_INFL_WHEEL ? t - infl->tick : WD_INFL_WHEEL;
+    for (uint64_t k = 0; k < n; k ++)
+    {
+        uint32_t i = infl->wheel[(infl->tick + k) & (WD_INFL_WHEEL - 1)];
+        while (i != WD_INFL_NIL)
+        {
+            uint32_t next = infl->node[i].next;
+            if (infl->node[i].exp < t)
+                _wd_infl_expire(infl, i, now, t);
+            i = next;
+        }
+    }
+    infl->tick = t;
+}
@@ -0,0 +1,131 @@
+#ifndef HEADER_fd_src_wiredancer_wd_infl_h
+#define HEADER_fd_src_wiredancer_wd_infl_h
+
+#include "wd_f1.h"
+
+/* In-flight table.  A slot that drops a request (input or result drops)
+   leaves a hole that wd_ed25519_verify_poll_resp only reports once
+   WD_RESP_WINDOW later requests have completed.  With an in-flight
+   table on the workspace, every request sent is noted under its m_seq
+   (submit TSC, slot, and the msg/sig/public_key pointers it was sent
+   from), and one still outstanding deadline_ns after it was sent is
+   resubmitted, as is, through the poller's own handle:
+
+     wd_sub_t  rsub;                           // owned by the poller
+     wd_sub_init(&rsub, &wd, 1, wd.pci_slots);
+     wd_infl_t infl;
+     wd_infl_init(&infl, &rsub, wd.sv.req_depth, 200000L, 3);
+     wd_ed25519_verify_inflight(&wd, &infl);
+
+   So msg, sig and public_key must stay valid and unchanged until the
+   request's result has been polled, not only until it was sent.
+   The table has one entry per mcache line, written by whichever thread
+   submits the m_seq (seq last) and read by the poller.  The poller
+   picks entries up in m_seq order into a hashed timer wheel of
+   WD_INFL_WHEEL buckets of 2^tick_lg TSC cycles, about deadline/8
+   each, doubly linked through a poller private node per entry: noting,
+   completing and expiring a request are O(1), and a poll with no
+   bucket due costs one TSC read.  A request expires at most a tick
+   late.
+   An expired request is resubmitted with wd_ed25519_verify_try_req_sub
+   on the table's handle, which with WD_SCHED_RR tries the slot after
+   the one it was dropped on first.  If no slot has room it is tried
+   again the next tick; after max_retry resubmits it is left to
+   poll_resp to report lost.  Without a handle (sub NULL), expiries are
+   only counted.  A request that was only late completes twice; the
+   second result line is not reported again.
+   m_seqs must be consecutive: pickup waits for a missing m_seq for up
+   to deadline_ns while the next one is noted, then skips it (n_skip).
+   deadline_ns should be well inside the time WD_RESP_WINDOW requests
+   take, or poll_resp gives up on a hole before its resubmit lands. */
+
+#define WD_INFL_WHEEL           256             /* buckets, power of 2  */
+#define WD_INFL_NIL             UINT32_MAX
+#define WD_INFL_SLOT_HOST       0xff            /* cache hit, CPU pool  */
+
+/* written by the submitter */
+typedef struct {
+
+    uint64_t            seq;            /* written last                */
+    uint64_t            t_sub;          /* TSC when sent               */
+    void const *        msg;
+    void const *        sig;
+    void const *        public_key;
+    uint32_t            sz;
+    uint32_t            m_chunk;
+    uint16_t            m_ctrl;
+    uint16_t            m_sz;
+    uint8_t             slot;
+
+} __attribute__((aligned(64))) wd_infl_ent_t;
+
+/* poller private */
+typedef struct {
+
+    uint64_t            seq;            /* m_seq the node is about     */
+    uint64_t            exp;            /* tick it is due              */
+    uint32_t            next;
+    uint32_t            prev;
+    uint8_t             state;          /* see wd_infl.c               */
+    uint8_t             n_retry;
+
+} wd_infl_node_t;
+
+struct wd_infl {
+
+    wd_sub_t *          sub;
+    wd_infl_ent_t *     ent;
+    uint64_t            depth;          /* power of 2                  */
+    uint64_t            deadline;       /* TSC cycles                  */
+    uint32_t            tick_lg;
+    uint32_t            max_retry;
+
+    /* poller */
+    wd_infl_node_t *    node            __attribute__((aligned(64)));
+    uint32_t            wheel[WD_INFL_WHEEL];
+    uint64_t            tick;           /* next tick to expire         */
+    uint64_t            pick;           /* next m_seq to pick up       */
+    uint64_t            pick_t0;        /* TSC pickup started waiting  */
+    uint64_t            n_pend;         /* in the wheel                */
+    uint64_t            n_expire;
+    uint64_t            n_retry;
+    uint64_t            n_recover;      /* completed after a resubmit  */
+    uint64_t            n_give_up;
+    uint64_t            n_defer;        /* no room, tried next tick    */
+    uint64_t            n_skip;
+    uint64_t            n_expire_slot[WD_N_PCI_SLOTS];
+
+};
+
+/* wd_infl_init sizes the table for depth (a power of 2, the mcache
+   depth) m_seqs and calibrates the TSC (10 ms) to turn deadline_ns
+   into cycles.  sub is the poller's handle for resubmits, NULL for
+   detection only.  Returns -1 on failure.  wd_infl_free frees it;
+   remove it from the workspace first. */
+int                     wd_infl_init    (wd_infl_t* infl, wd_sub_t* sub, uint64_t depth,
+                                         int64_t deadline_ns, uint32_t max_retry);
+void                    wd_infl_free    (wd_infl_t* infl);
+
+/* wd_infl_note notes the request m_seq as sent to slot.  The submit
+   path calls it; a resubmit of an m_seq already noted is not noted
+   again.  Any thread. */
+void
+wd_infl_note( wd_infl_t *   infl,
+              uint32_t      slot,
+              void const *  msg,
+              ulong         sz,
+              void const *  sig,
+              void const *  public_key,
+              uint64_t      m_seq,
+              uint32_t      m_chunk,
+              uint16_t      m_ctrl,
+              uint16_t      m_sz);
+
+/* wd_infl_done retires m_seq, which poll_resp has reported.
+   wd_infl_poll picks up newly noted requests and expires and
+   resubmits the ones due; wd_ed25519_verify_poll_resp and
+   wd_ed25519_verify_scan_done call both.  Poller only. */
+void                    wd_infl_done    (wd_infl_t* infl, uint64_t m_seq);
+void                    wd_infl_poll    (wd_infl_t* infl);
+
+#endif
@@ -0,0 +1,487 @@
+/* wd_mmio.c – microbenchmarks of the MMIO and write-combining primitives
+   the Wiredancer submit path is built on */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <x86intrin.h>
+
+#include "wd_f1.h"
+
+#define HP_SIZE   (2UL << 20)
+#define DEPTH     1024
+#define MEM_SZ    (1UL << 20)           /* one stream window            */
+#define FENCE_MAX 64                    /* beats before the widest fence */
+#define VLED_TIMEOUT_NS 10000000UL      /* a vLED query that takes longer
+                                           is counted as lost            */
+
+/* -------------- mem backend -------------------------------------------- */
+
+/* stands in for the slots when there is no FPGA: BAR4 is an ordinary
+   (write-back, not write-combining) anonymous mapping taking the same
+   non-temporal stores as the F1 backend, the registers are plain
+   memory and vLED echoes every vDIP command */
+typedef struct {
+    uint8_t  *bar4;
+    uint32_t  reg[64];
+    uint16_t  vled;
+} mem_slot_t;
+
+static mem_slot_t *mem_slot(wd_pci_t *pci) {
+    return (mem_slot_t *)pci->dev_ctx + pci->slot;
+}
+
+static int mem_attach(wd_pci_t *pci) {
+    mem_slot_t *ms = mem_slot(pci);
+    ms->bar4 = mmap(NULL, MEM_SZ, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (ms->bar4 == MAP_FAILED)
+        return -1;
+    pci->bar4_addr = ms->bar4;
+    return 0;
+}
+
+static void mem_detach(wd_pci_t *pci) {
+    munmap(mem_slot(pci)->bar4, MEM_SZ);
+    pci->bar4_addr = 0;
+}
+
+static uint32_t mem_read_32(wd_pci_t *pci, uint32_t addr) {
+    return FD_VOLATILE_CONST(mem_slot(pci)->reg[(addr >> 2) & 63]);
+}
+
+static void mem_write_32(wd_pci_t *pci, uint32_t addr, uint32_t v) {
+    FD_VOLATILE(mem_slot(pci)->reg[(addr >> 2) & 63]) = v;
+}
+
+static void mem_write_256(wd_pci_t *pci, uint64_t off, __m256i v) {
+    _mm256_stream_si256((__m256i *)(mem_slot(pci)->bar4 + (off & (MEM_SZ - 1))), v);
+}
+
+static void mem_flush(wd_pci_t *pci, uint32_t si) {
+    (void)pci;
+    (void)si;
+    _mm_sfence();
+}
+
+static int mem_set_vdip(wd_pci_t *pci, uint16_t v) {
+    FD_VOLATILE(mem_slot(pci)->vled) = (uint16_t)(v & 0xff);
+    return 0;
+}
+
+static int mem_get_vled(wd_pci_t *pci, uint16_t *v) {
+    *v = FD_VOLATILE_CONST(mem_slot(pci)->vled);
+    return 0;
+}
+
+static wd_dev_t const mem_dev = {
+    .name      = "mem",
+    .attach    = mem_attach,
+    .detach    = mem_detach,
+    .read_32   = mem_read_32,
+    .write_32  = mem_write_32,
+    .write_256 = mem_write_256,
+    .flush     = mem_flush,
+    .set_vdip  = mem_set_vdip,
+    .get_vled  = mem_get_vled,
+};
+
+/* -------------- setup -------------------------------------------------- */
+
+typedef struct {
+    int        mem;
+    int        hist;
+    uint64_t   slots;
+    uint64_t   cnt;             /* samples per primitive               */
+    uint64_t   vcnt;            /* samples per vDIP/vLED primitive     */
+    uint64_t   sz;              /* message size of the write samples   */
+    double     tsc_hz;
+
+    wd_wksp_t  wd;
+    mem_slot_t mem_slot[WD_N_PCI_SLOTS];
+    void      *hp;
+} mmio_t;
+
+/* fenced so a sample covers exactly the instructions between two reads */
+static inline uint64_t tsc(void) {
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec;
+}
+
+static void mmio_open(mmio_t *m) {
+    if (m->mem) {
+        if (wd_init_dev(&m->wd, m->slots, &mem_dev, m->mem_slot)) {
+            fprintf(stderr, "wd_init_dev failed\n");
+            exit(1);
+        }
+        return;
+    }
+    if (wd_init_pci(&m->wd, m->slots)) {
+        fprintf(stderr, "wd_init_pci failed\n");
+        exit(1);
+    }
+    /* the request beats need somewhere to send their result lines */
+    m->hp = wd_hp_alloc(HP_SIZE, HP_SIZE, wd_wksp_node(&m->wd));
+    if (!m->hp) { perror("mmap hugepage"); exit(1); }
+    if (wd_dma_map(&m->wd, m->hp, HP_SIZE, HP_SIZE)) {
+        fprintf(stderr, "wd_dma_map failed\n");
+        exit(1);
+    }
+    wd_ed25519_verify_init_req(&m->wd, 0, DEPTH, m->hp);
+}
+
+static void mmio_close(mmio_t *m) {
+    wd_free_pci(&m->wd);
+    if (m->hp)
+        wd_hp_free(m->hp, HP_SIZE);
+}
+
+/* -------------- request stream ----------------------------------------- */
+
+/* The device parses stream 0 of a slot for requests, so the timed beats
+   are one request of sz bytes, encoded once and sent over and over.
+   Its signature is garbage: with send_fails off it gets no result line
+   (and if it passed, the line would land in the tool's own mcache).
+   The cursor follows the submit path's flush cadence: a fence at the
+   end of every 4 KiB page and at the end of the window. */
+typedef struct {
+    wd_pci_t *pci;
+    __m256i  *beat;
+    uint32_t  n;                /* beats per request                   */
+    uint32_t  i;                /* next beat                           */
+    uint64_t  a;                /* stream cursor                       */
+    uint64_t  n_sent;           /* beats, since the last fill check    */
+} src_t;
+
+static void src_init(src_t *s, wd_pci_t *pci, uint64_t sz) {
+    uint64_t nb = (sz + 31) >> 5;
+    s->pci  = pci;
+    s->n    = (uint32_t)(4 + nb + (nb & 1));
+    s->beat = aligned_alloc(32, 32UL * s->n);
+    s->i    = 0;
+    s->a    = 0;
+    s->n_sent = 0;
+
+    uint8_t *p = (uint8_t *)s->beat;
+    for (uint64_t k = 32; k < 32UL * s->n; k++)
+        p[k] = (uint8_t)rand();
+    uint64_t m_seq = 1;
+    uint64_t dma_addr = fd_mcache_line_idx(m_seq, DEPTH) << 5;
+    uint32_t *hdr = (uint32_t *)p;
+    hdr[0] = WD_PCI_MAGIC;
+    hdr[1] = ((uint32_t)sz + 32 + 32) << 16;
+    hdr[2] = (uint32_t)sz | (0x3U << 16);
+    hdr[3] = (uint32_t)dma_addr;
+    hdr[4] = (uint32_t)(dma_addr >> 32);
+    hdr[5] = (uint32_t)m_seq;
+    hdr[6] = (uint32_t)(m_seq >> 32);
+    hdr[7] = 0;
+}
+
+/* beats to go until the cursor reaches a flush point */
+static uint32_t src_room(src_t const *s) {
+    uint64_t in_page = s->a & 0xFFF;
+    return in_page < 0xFC0 ? (uint32_t)((0xFC0 - in_page) >> 5) : 1;
+}
+
+static inline void src_send(src_t *s, uint32_t n) {
+    wd_pci_t *pci = s->pci;
+    for (uint32_t k = 0; k < n; k++) {
+        pci->dev->write_256(pci, s->a | pci->stream[0].b, s->beat[s->i]);
+        if (++s->i == s->n) s->i = 0;
+        s->a += 32;
+        if (s->a == pci->stream[0].m) {
+            pci->dev->flush(pci, 0);
+            s->a = 0;
+        } else if ((s->a & 0xFC0) == 0xFC0) {
+            pci->dev->flush(pci, 0);
+        }
+    }
+    s->n_sent += n;
+}
+
+/* untimed: keep the device's input fifo from overflowing, checked every
+   WD_BP_INTERVAL requests' worth of beats (the bench's own cadence,
+   not the library's, which checks when a handle's credits run out) */
+static void src_drain(src_t *s) {
+    if (s->n_sent < (uint64_t)WD_BP_INTERVAL * s->n)
+        return;
+    s->n_sent = 0;
+    s->pci->dev->flush(s->pci, 0);
+    while (((s->pci->dev->read_32(s->pci, 0x21 << 2) >> 12) & 0x3ff) > 128)
+        _mm_pause();
+}
+
+/* -------------- report ------------------------------------------------- */
+
+/* lower bound of bucket b of a wd_lat_hist_t, see WD_LAT_SUB_LG */
+static uint64_t bucket_lo(uint32_t b) {
+    if (b < (1U << (WD_LAT_SUB_LG + 1)))
+        return b;
+    uint32_t sh = (b >> WD_LAT_SUB_LG) - 1;
+    return ((1UL << WD_LAT_SUB_LG) | (b & ((1U << WD_LAT_SUB_LG) - 1))) << sh;
+}
+
+/* a bucket's upper bound can lie past the largest value counted in it */
+static double quantile(wd_lat_hist_t const *h, double q) {
+    return (double)fd_ulong_min(wd_lat_quantile(h, q), h->max);
+}
+
+static double ns(mmio_t const *m, double cycles) {
+    return cycles * 1e9 / m->tsc_hz;
+}
+
+static void report_head(void) {
+    printf("  %-16s %9s %9s %9s %9s %9s %9s\n",
+           "ns", "mean", "p50", "p90", "p99", "p99.9", "max");
+}
+
+static void report_hist(mmio_t const *m, char const *name, wd_lat_hist_t const *h) {
+    if (!h->cnt) {
+        printf("  %-16s %9s\n", name, "-");
+        return;
+    }
+    printf("  %-16s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name,
+           ns(m, (double)h->sum / (double)h->cnt),
+           ns(m, quantile(h, 0.5)),
+           ns(m, quantile(h, 0.9)),
+           ns(m, quantile(h, 0.99)),
+           ns(m, quantile(h, 0.999)),
+           ns(m, (double)h->max));
+    if (!m->hist)
+        return;
+
+    /* one bar per non-empty bucket, scaled to the fullest */
+    uint64_t top = 0;
+    for (uint32_t b = 0; b < WD_LAT_N_BUCKET; b++)
+        if (h->b[b] > top) top = h->b[b];
+    for (uint32_t b = 0; b < WD_LAT_N_BUCKET; b++) {
+        if (!h->b[b])
+            continue;
+        int w = (int)(50 * h->b[b] / top);
+        printf("  %18s %9.1f %10lu %.*s\n", ">=",
+               ns(m, (double)bucket_lo(b)), (unsigned long)h->b[b],
+               w ? w : 1, "##################################################");
+    }
+}
+
+/* -------------- primitives --------------------------------------------- */
+
+typedef struct {
+    wd_lat_hist_t timer;        /* two back-to-back TSC reads          */
+    wd_lat_hist_t write;        /* one request's beats, no fence       */
+    wd_lat_hist_t fence[8];     /* sfence after fence_beats[i] beats   */
+    wd_lat_hist_t read;         /* fill register round trip            */
+    wd_lat_hist_t vdip;         /* one vDIP command                    */
+    wd_lat_hist_t vled;         /* one vLED status read                */
+    wd_lat_hist_t query;        /* vDIP command until vLED answers     */
+    uint64_t      n_lost;       /* queries past VLED_TIMEOUT_NS        */
+} prim_t;
+
+static uint32_t const fence_beats[8] = { 0, 1, 2, 4, 8, 16, 32, FENCE_MAX };
+
+static void run_write(mmio_t *m, src_t *s, prim_t *p) {
+    for (uint64_t i = 0; i < m->cnt; i++) {
+        src_drain(s);
+        uint64_t t0 = tsc();
+        src_send(s, s->n);
+        uint64_t t1 = tsc();
+        wd_lat_add(&p->write, t1 - t0);
+    }
+    s->pci->dev->flush(s->pci, 0);
+}
+
+/* sfence cost by write-combining buffer occupancy: k beats (k/2 lines)
+   written since the last fence, none of them on a flush point */
+static void run_fence(mmio_t *m, src_t *s, prim_t *p) {
+    for (uint32_t f = 0; f < 8; f++) {
+        uint32_t k = fence_beats[f];
+        for (uint64_t i = 0; i < m->cnt; i++) {
+            src_drain(s);
+            while (src_room(s) <= k)
+                src_send(s, 1);
+            s->pci->dev->flush(s->pci, 0);
+            src_send(s, k);
+            uint64_t t0 = tsc();
+            _mm_sfence();
+            uint64_t t1 = tsc();
+            wd_lat_add(&p->fence[f], t1 - t0);
+        }
+    }
+}
+
+static void run_read(mmio_t *m, wd_pci_t *pci, prim_t *p) {
+    for (uint64_t i = 0; i < m->cnt; i++) {
+        uint64_t t0 = tsc();
+        uint32_t fill = pci->dev->read_32(pci, 0x21 << 2);
+        uint64_t t1 = tsc();
+        (void)fill;
+        wd_lat_add(&p->read, t1 - t0);
+    }
+}
+
+/* vLED queries as test_dma makes them (function 0, select 0..15), each
+   select differing from the one before so a stale vLED cannot answer */
+static void run_vdip(mmio_t *m, wd_pci_t *pci, prim_t *p) {
+    for (uint64_t i = 0; i < m->vcnt; i++) {
+        uint16_t cmd = (uint16_t)((i & 0xf) << 4);
+        uint16_t v;
+
+        uint64_t t0 = tsc();
+        if (pci->dev->set_vdip(pci, cmd))
+            break;
+        uint64_t t1 = tsc();
+        int rc = pci->dev->get_vled(pci, &v);
+        uint64_t t2 = tsc();
+        if (rc)
+            break;
+        wd_lat_add(&p->vdip, t1 - t0);
+        wd_lat_add(&p->vled, t2 - t1);
+
+        uint64_t deadline = now_ns() + VLED_TIMEOUT_NS;
+        while ((v & 0xff) != cmd && now_ns() < deadline)
+            if (pci->dev->get_vled(pci, &v))
+                break;
+        uint64_t t3 = tsc();
+        if ((v & 0xff) == cmd)
+            wd_lat_add(&p->query, t3 - t0);
+        else
+            p->n_lost++;
+    }
+}
+
+/* what a fill register check every n requests of the write samples'
+   size costs the submit path, at the measured write and read times.
+   WD_BP_INTERVAL is the fixed cadence wd_sub_credit_policy offers; by
+   default a handle checks only when its credits run out */
+static void report_bp(mmio_t const *m, prim_t const *p) {
+    if (!p->write.cnt || !p->read.cnt)
+        return;
+    double req  = ns(m, (double)p->write.sum / (double)p->write.cnt);
+    double p50  = ns(m, quantile(&p->read, 0.5));
+    double p99  = ns(m, quantile(&p->read, 0.99));
+    printf("  backpressure check every N requests of %lu bytes (%.1f ns each):\n",
+           (unsigned long)m->sz, req);
+    printf("  %6s %14s %12s %12s\n", "N", "between (ns)", "cost p50", "cost p99");
+    for (uint32_t n = 1; n <= 64; n <<= 1)
+        printf("  %5u%c %14.1f %11.1f%% %11.1f%%\n", n, n == WD_BP_INTERVAL ? '*' : ' ',
+               (double)n * req,
+               100. * p50 / ((double)n * req + p50),
+               100. * p99 / ((double)n * req + p99));
+    printf("  (* WD_BP_INTERVAL, with wd_sub_credit_policy; by default only when credits run out)\n");
+}
+
+static void bench_slot(mmio_t *m, uint32_t slot) {
+    wd_pci_t *pci = &m->wd.pci[slot];
+    prim_t   *p   = calloc(1, sizeof(prim_t));
+    src_t     s;
+
+    /* measure from the slot's own cores */
+    cpu_set_t cpus;
+    wd_slot_cpus(&m->wd, slot, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+    src_init(&s, pci, m->sz);
+    for (uint64_t i = 0; i < m->cnt; i++) {
+        uint64_t t0 = tsc();
+        uint64_t t1 = tsc();
+        wd_lat_add(&p->timer, t1 - t0);
+    }
+    run_write(m, &s, p);
+    run_fence(m, &s, p);
+    run_read (m, pci, p);
+    run_vdip (m, pci, p);
+
+    printf("slot %u (%s, node %d): %lu samples, %lu vDIP/vLED\n", slot, pci->dev->name,
+           wd_slot_node(&m->wd, slot), (unsigned long)m->cnt, (unsigned long)m->vcnt);
+    report_head();
+    report_hist(m, "timer", &p->timer);
+    char name[32];
+    snprintf(name, sizeof(name), "write %u beats", s.n);
+    report_hist(m, name, &p->write);
+    for (uint32_t f = 0; f < 8; f++) {
+        snprintf(name, sizeof(name), "sfence @%u", fence_beats[f]);
+        report_hist(m, name, &p->fence[f]);
+    }
+    report_hist(m, "read_32 fill", &p->read);
+    report_hist(m, "vdip", &p->vdip);
+    report_hist(m, "vled", &p->vled);
+    report_hist(m, "vdip->vled", &p->query);
+    if (p->n_lost)
+        printf("  %lu vLED queries unanswered after %lu ms\n",
+               (unsigned long)p->n_lost, VLED_TIMEOUT_NS / 1000000UL);
+
+    /* streaming throughput, fences on the flush points included */
+    if (p->write.sum)
+        printf("  write: %.3f GB/s\n",
+               (double)(32UL * s.n * p->write.cnt) / ns(m, (double)p->write.sum));
+    report_bp(m, p);
+    printf("\n");
+
+    free(s.beat);
+    free(p);
+}
+
+/* -------------- main --------------------------------------------------- */
+
+static void usage(void) {
+    puts("usage: wd_mmio [options]\n"
+         "options:\n"
+         "  --mem          no FPGA: ordinary memory mappings as the slots\n"
+         "  --hist         print every histogram, not just its percentiles\n"
+         "  -m MASK        slot mask (default 0x1)\n"
+         "  -n CNT         samples per primitive (default 100000)\n"
+         "  -v CNT         samples per vDIP/vLED primitive (default 1000)\n"
+         "  -s SZ          message size of the write samples (default 256)");
+}
+
+int main(int argc, char **argv) {
+    mmio_t m = {0};
+    m.slots = 1;
+    m.cnt   = 100000;
+    m.vcnt  = 1000;
+    m.sz    = 256;
+
+    static struct option const longopts[] = {
+        { "mem",  no_argument, NULL, 'M' },
+        { "hist", no_argument, NULL, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "m:n:v:s:", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'M': m.mem   = 1;                            break;
+        case 'h': m.hist  = 1;                            break;
+        case 'm': m.slots = strtoull(optarg, NULL, 0);    break;
+        case 'n': m.cnt   = strtoull(optarg, NULL, 0);    break;
+        case 'v': m.vcnt  = strtoull(optarg, NULL, 0);    break;
+        case 's': m.sz    = strtoull(optarg, NULL, 0);    break;
+        default : usage(); return 1;
+        }
+    }
+    m.tsc_hz = wd_tsc_hz();
+    mmio_open(&m);
+    printf("tsc %.3f GHz, %s\n\n", m.tsc_hz * 1e-9,
+           m.mem ? "ordinary memory, no write combining" : "f1");
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot++)
+        if (m.slots & (1UL << slot))
+            bench_slot(&m, slot);
+    mmio_close(&m);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <sched.h>
+
+#include "wd_ring.h"
+
+/* The ring is a bounded MPSC ring (Vyukov): entry i is free for the
+   producer at ring position pos when its qseq == pos, holds a request
+   for the submitter at pos when qseq == pos+1, and is handed back for
+   the next lap by setting qseq = pos + depth.  With one consumer the
+   head needs no CAS. */
+
+// RRRRRRRRRRRRRRRRR    IIIIIIIIII NNNNNNNN        NNNNNNNN         GGGGGGGGGGGGG
+// R::::::::::::::::R   I::::::::I N:::::::N       N::::::N      GGG::::::::::::G
+// R::::::RRRRRR:::::R  I::::::::I N::::::::N      N::::::N    GG:::::::::::::::G
+// RR:::::R     R:::::R II::::::II N:::::::::N     N::::::N   G:::::GGGGGGGG::::G
+//   R::::R     R:::::R   I::::I   N::::::::::N    N::::::N  G:::::G       GGGGGG
+//   R::::R     R:::::R   I::::I   N:::::::::::N   N::::::N G:::::G
+//   R::::RRRRRR:::::R    I::::I   N:::::::N::::N  N::::::N G:::::G
+//   R:::::::::::::RR     I::::I   N::::::N N::::N N::::::N G:::::G    GGGGGGGGGG
+//   R::::RRRRRR:::::R    I::::I   N::::::N  N::::N:::::::N G:::::G    G::::::::G
+//   R::::R     R:::::R   I::::I   N::::::N   N:::::::::::N G:::::G    GGGGG::::G
+//   R::::R     R:::::R   I::::I   N::::::N    N::::::::::N G:::::G        G::::G
+//   R::::R     R:::::R   I::::I   N::::::N     N:::::::::N  G:::::G       G::::G
+// RR:::::R     R:::::R II::::::II N::::::N      N::::::::N   G:::::GGGGGGGG::::G
+// R::::::R     R:::::R I::::::::I N::::::N       N:::::::N    GG:::::::::::::::G
+// R::::::R     R:::::R I::::::::I N::::::N        N::::::N      GGG::::::GGG:::G
+// RRRRRRRR     RRRRRRR IIIIIIIIII NNNNNNNN         NNNNNNN         GGGGGG   GGGG
+
+int wd_ring_init(wd_ring_t* ring, wd_sub_t* sub, uint64_t depth)
+{
+    if (!depth || (depth & (depth - 1)))
+        return -1;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->sub   = sub;
+    ring->depth = depth;
+    ring->core  = -1;
+
+    ring->ent = aligned_alloc(64, depth * sizeof(wd_ring_ent_t));
+    if (!ring->ent)
+        return -1;
+    for (uint64_t i = 0; i < depth; i ++)
+        ring->ent[i].qseq = i;
+    return 0;
+}
+
+void wd_ring_free(wd_ring_t* ring)
+{
+    wd_ring_stop(ring);
+    free(ring->ent);
+    ring->ent = NULL;
+}
+
+int
+wd_ring_req( wd_ring_t *   ring,
+             void const *  msg,
+             ulong         sz,
+             void const *  sig,
+             void const *  public_key,
+             uint64_t      m_seq,
+             uint32_t      m_chunk,
+             uint16_t      m_ctrl,
+             uint16_t      m_sz)
+{
+    wd_ring_ent_t * e;
+    uint64_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        e = &ring->ent[pos & (ring->depth - 1)];
+        int64_t d = (int64_t)(__atomic_load_n(&e->qseq, __ATOMIC_ACQUIRE) - pos);
+        if (!d)
+        {
+            if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (d < 0)
+        {
+            __atomic_fetch_add(&ring->n_full, 1, __ATOMIC_RELAXED);
+            return EAGAIN;
+        }
+        else
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    }
+
+    e->msg        = msg;
+    e->sig        = sig;
+    e->public_key = public_key;
+    e->m_seq      = m_seq;
+    e->sz         = (uint32_t)sz;
+    e->m_chunk    = m_chunk;
+    e->m_ctrl     = m_ctrl;
+    e->m_sz       = m_sz;
+    __atomic_store_n(&e->qseq, pos + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+uint64_t wd_ring_poll(wd_ring_t* ring)
+{
+    void const * msg[WD_RING_BURST];
+    ulong        sz [WD_RING_BURST];
+    void const * sig[WD_RING_BURST];
+    void const * pub[WD_RING_BURST];
+    uint64_t     m_seq  [WD_RING_BURST];
+    uint32_t     m_chunk[WD_RING_BURST];
+    uint16_t     m_ctrl [WD_RING_BURST];
+    uint16_t     m_sz   [WD_RING_BURST];
+
+    // take the run of filled entries at the head, handing each back
+    // as soon as its descriptor is copied out
+    uint64_t pos = ring->head;
+    ulong    n   = 0;
+    for (; n < WD_RING_BURST; n ++, pos ++)
+    {
+        wd_ring_ent_t * e = &ring->ent[pos & (ring->depth - 1)];
+        if (__atomic_load_n(&e->qseq, __ATOMIC_ACQUIRE) != pos + 1)
+            break;
+        msg[n]     = e->msg;
+        sz[n]      = e->sz;
+        sig[n]     = e->sig;
+        pub[n]     = e->public_key;
+        m_seq[n]   = e->m_seq;
+        m_chunk[n] = e->m_chunk;
+        m_ctrl[n]  = e->m_ctrl;
+        m_sz[n]    = e->m_sz;
+        __atomic_store_n(&e->qseq, pos + ring->depth, __ATOMIC_RELEASE);
+    }
+    if (!n)
+        return 0;
+    ring->head = pos;
+
+    // the descriptors are off the ring: a timeout only means the device
+    // is behind, so the submitter thread keeps going until the whole
+    // burst is out.  Once it is being stopped, or without it, a call
+    // that sent nothing within the handle's timeout drops the rest
+    ulong done = 0;
+    while (done < n)
+    {
+        ulong k = wd_ed25519_verify_req_batch_sub(ring->sub, msg + done, sz + done,
+                                                  sig + done, pub + done, m_seq + done,
+                                                  m_chunk + done, m_ctrl + done,
+                                                  m_sz + done, n - done);
+        done += k;
+        if (!k && !FD_VOLATILE_CONST(ring->running))
+        {
+            ring->n_drop += n - done;
+            break;
+        }
+    }
+
+    ring->n_burst ++;
+    __atomic_store_n(&ring->sent, ring->sent + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+uint64_t wd_ring_sent(wd_ring_t const* ring)
+{
+    return __atomic_load_n(&ring->sent, __ATOMIC_ACQUIRE);
+}
+
+static void* _wd_ring_main(void* arg)
+{
+    wd_ring_t* ring = (wd_ring_t*)arg;
+    uint32_t   idle = 0;
+    for (;;)
+    {
+        if (wd_ring_poll(ring))
+        {
+            idle = 0;
+            continue;
+        }
+        if (!FD_VOLATILE_CONST(ring->running) &&
+            __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->head)
+            break;
+        // an idle submitter stays hot for a while, then yields its core
+        if (++ idle < 4096)
+            _mm_pause();
+        else
+            sched_yield();
+    }
+    return NULL;
+}
+
+int wd_ring_start(wd_ring_t* ring, int core)
+{
+    if (ring->running)
+        return 0;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (core >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        if (pthread_attr_setaffinity_np(&attr, sizeof(set), &set))
+        {
+            pthread_attr_destroy(&attr);
+            return -1;
+        }
+    }
+    ring->core    = core;
+    ring->running = 1;
+    int err = pthread_create(&ring->thread, &attr, _wd_ring_main, ring);
+    pthread_attr_destroy(&attr);
+    if (err)
+    {
+        ring->running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void wd_ring_stop(wd_ring_t* ring)
+{
+    if (!ring->running)
+        return;
+    FD_VOLATILE(ring->running) = 0;
+    pthread_join(ring->thread, NULL);
+}
@@ -0,0 +1,105 @@
+#ifndef HEADER_fd_src_wiredancer_wd_ring_h
+#define HEADER_fd_src_wiredancer_wd_ring_h
+
+#include <pthread.h>
+
+#include "wd_f1.h"
+
+/* Submission ring.  A submit handle (and the write-combining buffers
+   behind it) belongs to one thread; the ring lets any number of
+   threads feed one handle.  Producers enqueue request descriptors
+   (pointers to msg/sig/public_key plus the mcache fields) into a
+   bounded lock-free multi-producer single-consumer ring, and a
+   submitter thread, optionally pinned to a core, drains them in bursts
+   of up to WD_RING_BURST through wd_ed25519_verify_req_batch_sub, so a
+   burst costs one fence per run and one credit check per slot instead
+   of one per request:
+
+     wd_ring_t ring;
+     wd_ring_init (&ring, &wd.sub, 1UL << 12);
+     wd_ring_start(&ring, 3);                  // submitter on core 3
+     ...
+     while (wd_ring_req(&ring, msg, sz, sig, pub, seq, chunk, 0x3, sz))
+         ;                                     // any thread
+     ...
+     wd_ring_stop (&ring);
+
+   Only descriptors are queued, so msg, sig and public_key must stay
+   valid and unchanged until the request has been sent, which is at the
+   latest when its result line shows up in the mcache (or when
+   wd_ring_sent passes the number of requests queued before it).  The
+   ring is private to the process. */
+
+#define WD_RING_BURST           64              /* dequeued per batch   */
+
+typedef struct {
+
+    uint64_t            qseq;           /* ring sequence, see wd_ring.c */
+    void const *        msg;
+    void const *        sig;
+    void const *        public_key;
+    uint64_t            m_seq;
+    uint32_t            sz;
+    uint32_t            m_chunk;
+    uint16_t            m_ctrl;
+    uint16_t            m_sz;
+
+} __attribute__((aligned(64))) wd_ring_ent_t;
+
+typedef struct {
+
+    wd_sub_t *          sub;
+    wd_ring_ent_t *     ent;
+    uint64_t            depth;          /* power of 2                  */
+
+    /* producers */
+    uint64_t            tail            __attribute__((aligned(64)));
+    uint64_t            n_full;
+    /* submitter */
+    uint64_t            head            __attribute__((aligned(64)));
+    uint64_t            sent;
+    uint64_t            n_burst;
+    uint64_t            n_drop;         /* given up on, see wd_ring_poll */
+
+    pthread_t           thread          __attribute__((aligned(64)));
+    int                 core;           /* -1: not pinned              */
+    volatile int        running;
+
+} wd_ring_t;
+
+/* wd_ring_init sets ring up to feed sub from a depth entry ring (a
+   power of 2).  Returns -1 on failure.  wd_ring_start starts the
+   submitter thread, pinned to core unless core < 0 (-1 if it could not
+   be started or pinned); from then on the thread owns sub.  wd_ring_stop stops
+   it once the ring is empty and every request in it has been sent or
+   dropped.
+   wd_ring_free stops it and frees the ring. */
+int                     wd_ring_init    (wd_ring_t* ring, wd_sub_t* sub, uint64_t depth);
+void                    wd_ring_free    (wd_ring_t* ring);
+int                     wd_ring_start   (wd_ring_t* ring, int core);
+void                    wd_ring_stop    (wd_ring_t* ring);
+
+/* wd_ring_req queues a request, arguments as for wd_ed25519_verify_req.
+   Returns EAGAIN if the ring is full.  Any thread. */
+int
+wd_ring_req( wd_ring_t *   ring,
+             void const *  msg,
+             ulong         sz,
+             void const *  sig,
+             void const *  public_key,
+             uint64_t      m_seq,
+             uint32_t      m_chunk,
+             uint16_t      m_ctrl,
+             uint16_t      m_sz);
+
+/* wd_ring_poll sends up to WD_RING_BURST queued requests on the calling
+   thread and returns how many it took off the ring, for use without the
+   submitter thread.  One polling thread at a time.  The running
+   submitter thread retries a burst until it is out; otherwise the rest
+   of a burst is dropped (counted in n_drop) once a send makes no
+   progress within sub's timeout (wd_sub_timeout).  wd_ring_sent
+   returns the number of requests taken off so far, sent or dropped. */
+uint64_t                wd_ring_poll    (wd_ring_t* ring);
+uint64_t                wd_ring_sent    (wd_ring_t const* ring);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <x86intrin.h>
+
+#include "wd_rob.h"
+
+/* Only the poller writes the ring, so an entry needs no sequence of its
+   own: it is held from the poll that found its completion until the
+   release that passes it, and head is the one word shared with the
+   submitters (a release store here, an acquire load in _wd_rob_wait). */
+
+// RRRRRRRRRRRRRRRRR         OOOOOOOOO      BBBBBBBBBBBBBBBBB
+// R::::::::::::::::R      OO:::::::::OO    B::::::::::::::::B
+// R::::::RRRRRR:::::R   OO:::::::::::::OO  B::::::BBBBBB:::::B
+// RR:::::R     R:::::R O:::::::OOO:::::::O BB:::::B     B:::::B
+//   R::::R     R:::::R O::::::O   O::::::O   B::::B     B:::::B
+//   R::::R     R:::::R O:::::O     O:::::O   B::::B     B:::::B
+//   R::::RRRRRR:::::R  O:::::O     O:::::O   B::::BBBBBB:::::B
+//   R:::::::::::::RR   O:::::O     O:::::O   B:::::::::::::BB
+//   R::::RRRRRR:::::R  O:::::O     O:::::O   B::::BBBBBB:::::B
+//   R::::R     R:::::R O:::::O     O:::::O   B::::B     B:::::B
+//   R::::R     R:::::R O:::::O     O:::::O   B::::B     B:::::B
+//   R::::R     R:::::R O::::::O   O::::::O   B::::B     B:::::B
+// RR:::::R     R:::::R O:::::::OOO:::::::O BB:::::BBBBBB::::::B
+// R::::::R     R:::::R  OO:::::::::::::OO  B:::::::::::::::::B
+// R::::::R     R:::::R    OO:::::::::OO    B::::::::::::::::B
+// RRRRRRRR     RRRRRRR      OOOOOOOOO      BBBBBBBBBBBBBBBBB
+
+int wd_rob_init(wd_rob_t* rob, uint64_t depth)
+{
+    if (!depth || (depth & (depth - 1)))
+        return -1;
+
+    memset(rob, 0, sizeof(*rob));
+    rob->depth = depth;
+
+    rob->ent = aligned_alloc(64, depth * sizeof(wd_rob_ent_t));
+    if (!rob->ent)
+        return -1;
+    memset(rob->ent, 0, depth * sizeof(wd_rob_ent_t));
+    return 0;
+}
+
+void wd_rob_free(wd_rob_t* rob)
+{
+    free(rob->ent);
+    rob->ent = NULL;
+}
+
+ulong
+wd_rob_poll( wd_rob_t *                  rob,
+             wd_ed25519_verify_resp_t *  resp,
+             ulong                       max)
+{
+    wd_ed25519_verify_resp_t in[WD_ROB_BURST];
+    wd_rob_ent_t * ent  = rob->ent;
+    uint64_t       mask = rob->depth - 1;
+    uint64_t       head = rob->head;
+    ulong          cnt  = 0;
+
+    // no more than max, so a completion that cannot be held still fits
+    ulong n = wd_ed25519_verify_poll_resp(rob->wd, in, max < WD_ROB_BURST ? max : WD_ROB_BURST);
+    for (ulong i = 0; i < n; i ++)
+    {
+        uint64_t d = in[i].seq - head;
+        if (d > mask)
+        {
+            resp[cnt ++] = in[i];
+            rob->n_over ++;
+            continue;
+        }
+        wd_lat_add(&rob->depth_hist, d);
+        ent[in[i].seq & mask].r    = in[i];
+        ent[in[i].seq & mask].held = 1;
+    }
+    rob->n_in   += n - cnt;
+    rob->n_held += n - cnt;
+
+    // a head-of-line stall ends when head's completion shows up
+    if (rob->hol_t0 && ent[head & mask].held)
+    {
+        wd_lat_add(&rob->hol_hist, __rdtsc() - rob->hol_t0);
+        rob->hol_t0 = 0;
+    }
+
+    // release the contiguous run from head
+    ulong run = 0;
+    while (cnt < max)
+    {
+        wd_rob_ent_t * e = &ent[head & mask];
+        if (!e->held)
+            break;
+        resp[cnt ++] = e->r;
+        e->held = 0;
+        head ++;
+        run ++;
+    }
+    rob->n_held -= run;
+    rob->n_out  += run;
+    __atomic_store_n(&rob->head, head, __ATOMIC_RELEASE);
+
+    // and one starts when later ones are held behind a missing head
+    if (rob->n_held && !rob->hol_t0 && !ent[head & mask].held)
+        rob->hol_t0 = __rdtsc();
+
+    return cnt;
+}
@@ -0,0 +1,86 @@
+#ifndef HEADER_fd_src_wiredancer_wd_rob_h
+#define HEADER_fd_src_wiredancer_wd_rob_h
+
+#include "wd_f1.h"
+
+/* Reorder buffer.  Slots, and the CPU pool or the cache, complete
+   requests out of m_seq order, and wd_ed25519_verify_poll_resp hands
+   them on as it finds them.  A consumer that needs results in
+   submission order (e.g. to forward transactions in the order they
+   arrived) polls through a reorder buffer instead:
+
+     wd_rob_t rob;
+     wd_rob_init(&rob, 1UL << 12);
+     wd_ed25519_verify_init_resp(&wd, seq0);
+     wd_ed25519_verify_rob(&wd, &rob);
+     ...
+     ulong n = wd_rob_poll(&rob, resp, 64);   // m_seq order, no gaps
+
+   Completions are held in a ring of depth entries indexed by m_seq mod
+   depth, two to a cache line, and released as contiguous runs from the
+   oldest m_seq not yet released (head).  Lost requests are released
+   with res WD_ED25519_RES_LOST at their place, so the run never stalls
+   for longer than poll_resp takes to give up on a request.
+   The ring bounds how far ahead of head a request can be submitted:
+   with a reorder buffer on the workspace, a submit whose m_seq is depth
+   or more past head waits for the poller like it waits for credits
+   (wd_ed25519_verify_try_req returns EAGAIN, n_full counts those).  A
+   thread that both submits and polls would wait on itself: it submits
+   with try_req, or a timeout (wd_sub_timeout), and polls when that
+   fails.  m_seqs must be consecutive, as the mcache wants them.
+   A depth past the mcache depth buys nothing: the device would lap
+   result lines before they are read.  A completion that arrives depth
+   or more past head anyway (the buffer was put on the workspace with
+   more than depth requests in flight) is returned at once, out of
+   order, and counted in n_over.
+
+   depth_hist counts, per completion, how far past head it arrived (0:
+   in order).  hol_hist counts, per head-of-line stall, the TSC cycles
+   (wd_lat_ns converts) completions were held waiting for head. */
+
+#define WD_ROB_BURST            64              /* polled per call      */
+
+typedef struct {
+
+    wd_ed25519_verify_resp_t r;
+    uint64_t            held;           /* 0: empty                    */
+
+} __attribute__((aligned(32))) wd_rob_ent_t;
+
+struct wd_rob {
+
+    wd_wksp_t *         wd;
+    wd_rob_ent_t *      ent;
+    uint64_t            depth;          /* power of 2                  */
+
+    /* poller, head read by submitters */
+    uint64_t            head            __attribute__((aligned(64)));
+    uint64_t            n_held;
+    uint64_t            hol_t0;         /* 0: head not blocked         */
+    uint64_t            n_in;
+    uint64_t            n_out;
+    uint64_t            n_over;         /* arrived depth or more ahead */
+    wd_lat_hist_t       depth_hist;
+    wd_lat_hist_t       hol_hist;
+
+    /* submitters */
+    uint64_t            n_full          __attribute__((aligned(64)));
+
+};
+
+/* wd_rob_init sizes rob for depth (a power of 2) completions in
+   flight.  Returns -1 on failure.  wd_rob_free frees it; remove it
+   from the workspace first. */
+int                     wd_rob_init     (wd_rob_t* rob, uint64_t depth);
+void                    wd_rob_free     (wd_rob_t* rob);
+
+/* wd_rob_poll polls up to WD_ROB_BURST completions from the workspace
+   rob is on and returns up to max completions into resp, in m_seq
+   order, without blocking: the next one returned is always head.
+   Single consumer, in place of wd_ed25519_verify_poll_resp. */
+ulong
+wd_rob_poll( wd_rob_t *                  rob,
+             wd_ed25519_verify_resp_t *  resp,
+             ulong                       max);
+
+#endif
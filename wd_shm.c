@@ -0,0 +1,314 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "wd_shm.h"
+
+/* The control block is written by whoever takes a lease (its pid and
+   expiry, by CAS on the pid), by wd_sub_init/wd_sub_fini (st_owned
+   bits) and by wd_shm_req (seq_next, once per block).  Everything else
+   a member needs is in its own wd_shm_mbr_t. */
+
+static int64_t
+_wd_shm_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* a lease whose holder exited, or stopped renewing it, can be taken */
+static int
+_wd_shm_stale(wd_shm_lease_t const* l, int32_t pid, int64_t now)
+{
+    if (!pid)
+        return 1;
+    if (kill(pid, 0) && errno == ESRCH)
+        return 1;
+    return now > __atomic_load_n(&l->expire_ns, __ATOMIC_RELAXED);
+}
+
+//    SSSSSSSSSSSSSSS  HHHHHHHHH     HHHHHHHHH MMMMMMMM               MMMMMMMM
+//  SS:::::::::::::::S H:::::::H     H:::::::H M:::::::M             M:::::::M
+// S:::::SSSSSS::::::S H:::::::H     H:::::::H M::::::::M           M::::::::M
+// S:::::S     SSSSSSS HH::::::H     H::::::HH M:::::::::M         M:::::::::M
+// S:::::S               H:::::H     H:::::H   M::::::::::M       M::::::::::M
+// S:::::S               H:::::H     H:::::H   M:::::::::::M     M:::::::::::M
+//  S::::SSSS            H::::::HHHHH::::::H   M:::::::M::::M   M::::M:::::::M
+//   SS::::::SSSSS       H:::::::::::::::::H   M::::::M M::::M M::::M M::::::M
+//     SSS::::::::SS     H:::::::::::::::::H   M::::::M  M::::M::::M  M::::::M
+//        SSSSSS::::S    H::::::HHHHH::::::H   M::::::M   M:::::::M   M::::::M
+//             S:::::S   H:::::H     H:::::H   M::::::M    M:::::M    M::::::M
+//             S:::::S   H:::::H     H:::::H   M::::::M     MMMMM     M::::::M
+// SSSSSSS     S:::::S HH::::::H     H::::::HH M::::::M               M::::::M
+// S::::::SSSSSS:::::S H:::::::H     H:::::::H M::::::M               M::::::M
+// S:::::::::::::::SS  H:::::::H     H:::::::H M::::::M               M::::::M
+//  SSSSSSSSSSSSSSS    HHHHHHHHH     HHHHHHHHH MMMMMMMM               MMMMMMMM
+
+wd_shm_t* wd_shm_create(char const* name, wd_wksp_t const* wd, int64_t lease_ns)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return NULL;
+    if (ftruncate(fd, sizeof(wd_shm_t)))
+    {
+        close(fd);
+        shm_unlink(path);
+        return NULL;
+    }
+    void* mem = mmap(NULL, sizeof(wd_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        shm_unlink(path);
+        return NULL;
+    }
+
+    wd_shm_t* shm = (wd_shm_t*)mem;
+    memset(shm, 0, sizeof(wd_shm_t));
+    shm->slots    = wd->pci_slots;
+    shm->depth    = wd->sv.req_depth;
+    shm->seq0     = wd->sv.resp_seq;
+    shm->lease_ns = lease_ns;
+    shm->pid      = getpid();
+    shm->seq_next = shm->seq0;
+    FD_COMPILER_MFENCE();
+    /* members check this last */
+    FD_VOLATILE(shm->magic) = WD_SHM_MAGIC;
+    return shm;
+}
+
+wd_shm_t* wd_shm_open(char const* name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+    void* mem = mmap(NULL, sizeof(wd_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return NULL;
+
+    wd_shm_t* shm = (wd_shm_t*)mem;
+    if (FD_VOLATILE_CONST(shm->magic) != WD_SHM_MAGIC)
+    {
+        munmap(mem, sizeof(wd_shm_t));
+        return NULL;
+    }
+    return shm;
+}
+
+void wd_shm_close(wd_shm_t* shm)
+{
+    munmap(shm, sizeof(wd_shm_t));
+}
+
+void wd_shm_unlink(char const* name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/%s", name);
+    shm_unlink(path);
+}
+
+int wd_shm_join(wd_shm_mbr_t* m, wd_shm_t* shm, wd_wksp_t* wd, fd_frag_meta_t* mcache)
+{
+    if (!shm || (shm->slots & ~wd->pci_slots))
+        return -1;
+
+    memset(m, 0, sizeof(*m));
+    m->shm    = shm;
+    m->wd     = wd;
+    m->mcache = mcache;
+    m->depth  = shm->depth;
+
+    wd->st_owned      = shm->st_owned;
+    wd->sv.mcache     = mcache;
+    wd->sv.req_depth  = shm->depth;
+
+    int32_t me  = getpid();
+    int64_t now = _wd_shm_now();
+    for (uint32_t si = 1; si < WD_N_PCI_STREAMS; si ++)
+    {
+        wd_shm_lease_t * l   = &shm->lease[si];
+        int32_t          pid = __atomic_load_n(&l->pid, __ATOMIC_ACQUIRE);
+        if (pid == me || !_wd_shm_stale(l, pid, now))
+            continue;
+        if (!__atomic_compare_exchange_n(&l->pid, &pid, me, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            continue;
+        __atomic_store_n(&l->expire_ns, now + shm->lease_ns, __ATOMIC_RELAXED);
+
+        // whatever the last holder left claimed
+        if (pid)
+            for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+                __atomic_fetch_and(&shm->st_owned[slot], ~(1U << si), __ATOMIC_ACQ_REL);
+
+        if (wd_sub_init(&m->sub, wd, si, shm->slots))
+        {
+            __atomic_store_n(&l->pid, 0, __ATOMIC_RELEASE);
+            continue;
+        }
+        return 0;
+    }
+
+    wd->st_owned = wd->st_own;
+    return -1;
+}
+
+void wd_shm_leave(wd_shm_mbr_t* m)
+{
+    wd_sub_fini(&m->sub);
+    __atomic_store_n(&m->shm->lease[m->sub.si].pid, 0, __ATOMIC_RELEASE);
+    m->wd->st_owned = m->wd->st_own;
+}
+
+void wd_shm_renew(wd_shm_mbr_t* m)
+{
+    __atomic_store_n(&m->shm->lease[m->sub.si].expire_ns,
+                     _wd_shm_now() + m->shm->lease_ns, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t
+_wd_shm_seq(wd_shm_mbr_t const* m, uint64_t k)
+{
+    return m->blk[(k / WD_SHM_SEQ_BLOCK) % WD_SHM_N_BLOCK] + k % WD_SHM_SEQ_BLOCK;
+}
+
+int
+wd_shm_req( wd_shm_mbr_t *  m,
+            void const *    msg,
+            ulong           sz,
+            void const *    sig,
+            void const *    public_key,
+            uint32_t        m_chunk,
+            uint16_t        m_ctrl,
+            uint16_t        m_sz,
+            uint64_t *      m_seq)
+{
+    uint64_t k = m->k_sub;
+    if (k - m->k_resp >= WD_RESP_WINDOW)
+    {
+        m->n_full ++;
+        return EAGAIN;
+    }
+    // first request of a block: draw the block, once, a failed send
+    // retries on the same m_seq
+    if (k / WD_SHM_SEQ_BLOCK == m->n_blk)
+    {
+        m->blk[m->n_blk % WD_SHM_N_BLOCK] =
+            __atomic_fetch_add(&m->shm->seq_next, WD_SHM_SEQ_BLOCK, __ATOMIC_RELAXED);
+        m->n_blk ++;
+    }
+
+    uint64_t seq = _wd_shm_seq(m, k);
+    int err = wd_ed25519_verify_req_sub(&m->sub, msg, sz, sig, public_key,
+                                        seq, m_chunk, m_ctrl, m_sz);
+    if (err)
+        return err;
+    m->k_sub = k + 1;
+    *m_seq   = seq;
+    return 0;
+}
+
+static inline void
+_wd_shm_lost( wd_shm_mbr_t *              m,
+              wd_ed25519_verify_resp_t *  r,
+              uint64_t                    seq)
+{
+    r->seq    = seq;
+    r->chunk  = 0;
+    r->res    = WD_ED25519_RES_LOST;
+    r->tsorig = 0;
+    r->tspub  = 0;
+    m->n_lost ++;
+}
+
+ulong
+wd_shm_poll( wd_shm_mbr_t *              m,
+             wd_ed25519_verify_resp_t *  resp,
+             ulong                       max)
+{
+    uint64_t out  = m->k_sub - m->k_resp;
+    uint64_t last = 0;      // offset of the furthest request resolved
+    uint64_t gap  = 0;
+    ulong    cnt  = 0;
+
+    if (!(++ m->n_poll % WD_SHM_RENEW))
+        wd_shm_renew(m);
+
+    for (uint64_t j = 0; j < out && cnt < max && gap < WD_RESP_GAP; j ++)
+    {
+        uint64_t   k   = m->k_resp + j;
+        uint64_t * w   = &m->done[(k >> 6) & (WD_RESP_WINDOW/64 - 1)];
+        uint64_t   bit = 1UL << (k & 63);
+        if (*w & bit)
+        {
+            gap  = 0;
+            last = j;
+            continue;
+        }
+
+        uint64_t               seq  = _wd_shm_seq(m, k);
+        fd_frag_meta_t const * meta = m->mcache + fd_mcache_line_idx(seq, m->depth);
+        uint64_t seq0 = __atomic_load_n(&meta->seq, __ATOMIC_ACQUIRE);
+        long     diff = fd_seq_diff(seq0, seq);
+        // not written yet
+        if (diff < 0)
+        {
+            gap ++;
+            continue;
+        }
+
+        wd_ed25519_verify_resp_t * r = resp + cnt;
+        if (!diff)
+        {
+            r->seq    = seq;
+            r->chunk  = FD_VOLATILE_CONST(meta->chunk);
+            r->res    = (uint32_t)FD_VOLATILE_CONST(meta->sig);
+            r->tsorig = FD_VOLATILE_CONST(meta->tsorig);
+            r->tspub  = FD_VOLATILE_CONST(meta->tspub);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            // overwritten while we were reading it
+            if (FD_VOLATILE_CONST(meta->seq) != seq0)
+                _wd_shm_lost(m, r, seq);
+        }
+        else
+            // lapped, by this member or another one
+            _wd_shm_lost(m, r, seq);
+
+        *w  |= bit;
+        gap  = 0;
+        last = j;
+        cnt ++;
+    }
+
+    // the window is full behind a request that never completed
+    uint64_t * w0 = &m->done[(m->k_resp >> 6) & (WD_RESP_WINDOW/64 - 1)];
+    if (cnt < max && out == WD_RESP_WINDOW && last == out - 1 && !(*w0 & (1UL << (m->k_resp & 63))))
+    {
+        _wd_shm_lost(m, resp + cnt, _wd_shm_seq(m, m->k_resp));
+        *w0 |= 1UL << (m->k_resp & 63);
+        cnt ++;
+    }
+
+    // retire the resolved prefix
+    for (;;)
+    {
+        uint64_t * w   = &m->done[(m->k_resp >> 6) & (WD_RESP_WINDOW/64 - 1)];
+        uint64_t   bit = 1UL << (m->k_resp & 63);
+        if (m->k_resp == m->k_sub || !(*w & bit))
+            break;
+        *w &= ~bit;
+        m->k_resp ++;
+    }
+
+    m->n_resp += cnt;
+    return cnt;
+}
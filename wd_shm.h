@@ -0,0 +1,145 @@
+#ifndef HEADER_fd_src_wiredancer_wd_shm_h
+#define HEADER_fd_src_wiredancer_wd_shm_h
+
+#include "wd_f1.h"
+
+/* Multi-process sharing.  A wd_wksp_t belongs to one process, but the
+   streams of a slot are independent: any number of processes can
+   submit to the same slots, each on a stream of its own, as long as
+   they agree on who owns which stream, on the m_seqs they use and on
+   the mcache the results land in.  The process that brings the slots
+   up (and pins the mcache) publishes that in a control block in POSIX
+   shared memory:
+
+     wd_init_pci(&wd, slots);                  // the owner
+     wd_dma_map (&wd, mcache, sz, page_sz);
+     wd_ed25519_verify_init_req (&wd, 1, depth, mcache);
+     wd_ed25519_verify_init_resp(&wd, seq0);
+     wd_shm_t * shm = wd_shm_create("wd_shm", &wd, 1000000000L);
+
+     wd_init_pci(&wd, slots);                  // every member
+     wd_shm_mbr_t m;
+     wd_shm_join(&m, wd_shm_open("wd_shm"), &wd, mcache);
+     wd_shm_req (&m, msg, sz, sig, public_key, m_chunk, m_ctrl, m_sz, &m_seq);
+     ulong n = wd_shm_poll(&m, resp, 64);
+
+   mcache is the member's own mapping of the owner's mcache (the same
+   hugetlbfs file; with the emulator, anonymous shared memory mapped
+   before the fork).  A member leases a stream (1..WD_N_PCI_STREAMS-1)
+   and submits on it through a wd_sub_t of its own, so the hot path
+   takes no lock and touches no shared line but the block allocator,
+   once per WD_SHM_SEQ_BLOCK requests.  Stream ownership (st_owned) is
+   shared too: every member's credit share counts the streams of all
+   members, so together they keep within the slot's fill limits as one
+   process with that many handles would.
+   m_seqs are handed out in blocks of WD_SHM_SEQ_BLOCK, consecutive
+   from the owner's seq0, and a member polls the result lines of its
+   own m_seqs only, with the rules of wd_ed25519_verify_poll_resp over
+   its own requests (a request is lost once WD_RESP_WINDOW later ones of
+   the member have completed).  The mcache must be deep enough for all
+   members' requests in flight: a line another member's request reuses
+   before it was read is reported lost.
+   A lease is taken over once its holder has exited or has not renewed
+   it for lease_ns (wd_shm_poll renews it), and the streams it held are
+   released.  The owner must outlive the members: it holds the pinned
+   pages and /dev/wd_dma.  Its own wd->sub (stream 0) is not counted in
+   the shared ownership and should stay unused; the owner can join as a
+   member to submit. */
+
+#define WD_SHM_MAGIC            0x57445f53484d3031UL    /* "WD_SHM01" */
+#define WD_SHM_SEQ_BLOCK        64              /* m_seqs per allocation */
+#define WD_SHM_N_BLOCK          (2 * WD_RESP_WINDOW / WD_SHM_SEQ_BLOCK)
+#define WD_SHM_RENEW            1024            /* polls per lease renewal */
+
+typedef struct {
+
+    int32_t             pid;            /* 0: free                     */
+    int64_t             expire_ns;      /* CLOCK_MONOTONIC             */
+
+} __attribute__((aligned(64))) wd_shm_lease_t;
+
+typedef struct {
+
+    uint64_t            magic;          /* written last                */
+    uint64_t            slots;
+    uint64_t            depth;          /* mcache depth                */
+    uint64_t            seq0;
+    int64_t             lease_ns;
+    int32_t             pid;            /* owner                       */
+
+    uint64_t            seq_next        __attribute__((aligned(64)));
+    uint32_t            st_owned[WD_N_PCI_SLOTS] __attribute__((aligned(64)));
+    wd_shm_lease_t      lease[WD_N_PCI_STREAMS];
+
+} wd_shm_t;
+
+/* one process's membership, private to it */
+typedef struct {
+
+    wd_shm_t *          shm;
+    wd_wksp_t *         wd;
+    fd_frag_meta_t *    mcache;
+    uint64_t            depth;
+    wd_sub_t            sub;            /* on the leased stream        */
+
+    /* own request k has m_seq blk[k / WD_SHM_SEQ_BLOCK % WD_SHM_N_BLOCK]
+       + k % WD_SHM_SEQ_BLOCK */
+    uint64_t            blk[WD_SHM_N_BLOCK];
+    uint64_t            n_blk;          /* blocks drawn                */
+    uint64_t            k_sub;          /* own requests sent           */
+    uint64_t            k_resp;         /* oldest unresolved           */
+    uint64_t            done[WD_RESP_WINDOW/64];
+    uint64_t            n_poll;
+
+    uint64_t            n_resp;
+    uint64_t            n_lost;
+    uint64_t            n_full;         /* own window full             */
+
+} wd_shm_mbr_t;
+
+/* wd_shm_create publishes the control block for wd's slots, mcache
+   depth and seq0 (after wd_ed25519_verify_init_req/init_resp) under
+   name.  wd_shm_open maps an existing one, NULL if there is none.
+   wd_shm_close unmaps it (leave first); wd_shm_unlink removes the
+   name, the block stays valid for the processes that have it mapped. */
+wd_shm_t *              wd_shm_create   (char const* name, wd_wksp_t const* wd, int64_t lease_ns);
+wd_shm_t *              wd_shm_open     (char const* name);
+void                    wd_shm_close    (wd_shm_t* shm);
+void                    wd_shm_unlink   (char const* name);
+
+/* wd_shm_join leases a free stream for m and sets wd up (slots
+   attached, same slot mask) to submit on it: stream ownership moves to
+   the shared block, the mcache and its depth to the owner's.  Returns
+   -1 if no stream is free.  wd_shm_leave releases the stream and the
+   lease and gives wd its own stream ownership back.  wd_shm_renew
+   extends the lease by lease_ns. */
+int                     wd_shm_join     (wd_shm_mbr_t* m, wd_shm_t* shm, wd_wksp_t* wd,
+                                         fd_frag_meta_t* mcache);
+void                    wd_shm_leave    (wd_shm_mbr_t* m);
+void                    wd_shm_renew    (wd_shm_mbr_t* m);
+
+/* wd_shm_req sends a request on m's stream under the next m_seq of m's
+   blocks, returned in m_seq, waiting for credits as
+   wd_ed25519_verify_req_sub does within m->sub's timeout
+   (wd_sub_timeout).  Returns EAGAIN without waiting when WD_RESP_WINDOW
+   of m's requests are unresolved: poll first.  The m_seq is only used
+   up by a request that was sent. */
+int
+wd_shm_req( wd_shm_mbr_t *  m,
+            void const *    msg,
+            ulong           sz,
+            void const *    sig,
+            void const *    public_key,
+            uint32_t        m_chunk,
+            uint16_t        m_ctrl,
+            uint16_t        m_sz,
+            uint64_t *      m_seq);
+
+/* wd_shm_poll returns up to max completions of m's requests into resp,
+   as wd_ed25519_verify_poll_resp does for a workspace's. */
+ulong
+wd_shm_poll( wd_shm_mbr_t *              m,
+             wd_ed25519_verify_resp_t *  resp,
+             ulong                       max);
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include "wd_tel.h"
+
+wd_cntr_desc_t const wd_cntr_desc[WD_TEL_N_CNTR] = {
+    { WD_CNTR_PAD_IN,         WD_TEL_COUNT, "pad in"           },
+    { WD_CNTR_PAD_OUT,        WD_TEL_COUNT, "pad out"          },
+    { WD_CNTR_SHA_OUT,        WD_TEL_COUNT, "sha out"          },
+    { WD_CNTR_SV0_OUT,        WD_TEL_COUNT, "sv0 out"          },
+    { WD_CNTR_SV2_F,          WD_TEL_COUNT, "sv2_f"            },
+    { WD_CNTR_SV2_OUT,        WD_TEL_COUNT, "sv2 out"          },
+    { WD_CNTR_ECC_OUT,        WD_TEL_COUNT, "ecc out"          },
+
+    { WD_CNTR_INPUT_COUNT,    WD_TEL_COUNT, "input count"      },
+    { WD_CNTR_INPUT_FILL,     WD_TEL_FILL,  "input fifo fill"  },
+    { WD_CNTR_INPUT_DROPS,    WD_TEL_DROP,  "input drops"      },
+    { WD_CNTR_RESULT_COUNT,   WD_TEL_COUNT, "result count"     },
+    { WD_CNTR_RESULT_FILL,    WD_TEL_FILL,  "result fifo fill" },
+    { WD_CNTR_RESULT_DROPS,   WD_TEL_DROP,  "result drops"     },
+    { WD_CNTR_RESULT_DMA,     WD_TEL_COUNT, "result dma count" },
+};
+
+/* same as the pipe-chain thresholds in wd_ed25519_verify_init_req */
+#define WD_TEL_FIFO_HI          200
+
+static uint64_t
+_wd_tel_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec;
+}
+
+// TTTTTTTTTTTTTTTTTTTTTTT EEEEEEEEEEEEEEEEEEEEEE LLLLLLLLLLL
+// T:::::::::::::::::::::T E::::::::::::::::::::E L:::::::::L
+// T:::::::::::::::::::::T E::::::::::::::::::::E L:::::::::L
+// T:::::TT:::::::TT:::::T EE::::::EEEEEEEEE::::E LL:::::::LL
+// TTTTTT  T:::::T  TTTTTT   E:::::E       EEEEEE   L:::::L
+//         T:::::T           E:::::E                L:::::L
+//         T:::::T           E::::::EEEEEEEEEE      L:::::L
+//         T:::::T           E:::::::::::::::E      L:::::L
+//         T:::::T           E:::::::::::::::E      L:::::L
+//         T:::::T           E::::::EEEEEEEEEE      L:::::L
+//         T:::::T           E:::::E                L:::::L
+//         T:::::T           E:::::E       EEEEEE   L:::::L         LLLLLL
+//       TT:::::::TT       EE::::::EEEEEEEE:::::E LL:::::::LLLLLLLLL:::::L
+//       T:::::::::T       E::::::::::::::::::::E L::::::::::::::::::::::L
+//       T:::::::::T       E::::::::::::::::::::E L::::::::::::::::::::::L
+//       TTTTTTTTTTT       EEEEEEEEEEEEEEEEEEEEEE LLLLLLLLLLLLLLLLLLLLLLLL
+
+int wd_tel_init(wd_tel_t* tel, wd_wksp_t* wd, char const* name, uint64_t interval_ns)
+{
+    memset(tel, 0, sizeof(*tel));
+    tel->wd          = wd;
+    tel->interval_ns = interval_ns;
+    tel->fifo_hi     = WD_TEL_FIFO_HI;
+
+    void* mem;
+    if (name)
+    {
+        snprintf(tel->name, sizeof(tel->name), "/%s", name);
+        int fd = shm_open(tel->name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return -1;
+        if (ftruncate(fd, sizeof(wd_tel_shm_t)))
+        {
+            close(fd);
+            shm_unlink(tel->name);
+            return -1;
+        }
+        mem = mmap(NULL, sizeof(wd_tel_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    else
+        mem = mmap(NULL, sizeof(wd_tel_shm_t), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+        if (name)
+            shm_unlink(tel->name);
+        return -1;
+    }
+
+    tel->shm = (wd_tel_shm_t*)mem;
+    memset(tel->shm, 0, sizeof(wd_tel_shm_t));
+    tel->shm->interval_ns = interval_ns;
+    tel->shm->fifo_hi     = tel->fifo_hi;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        tel->shm->slot[slot].active = !!(wd->pci_slots & (1UL << slot));
+    FD_COMPILER_MFENCE();
+    /* readers check this last */
+    FD_VOLATILE(tel->shm->magic) = WD_TEL_MAGIC;
+    return 0;
+}
+
+void wd_tel_free(wd_tel_t* tel)
+{
+    wd_tel_stop(tel);
+    if (tel->shm)
+        munmap(tel->shm, sizeof(wd_tel_shm_t));
+    if (tel->name[0])
+        shm_unlink(tel->name);
+    tel->shm = NULL;
+}
+
+void wd_tel_sample(wd_tel_t* tel)
+{
+    wd_wksp_t*    wd  = tel->wd;
+    wd_tel_shm_t* shm = tel->shm;
+    uint32_t      raw[WD_N_PCI_SLOTS][WD_TEL_N_CNTR];
+
+    /* all PCIe reads happen outside the write side of the seqlock */
+    uint64_t now = _wd_tel_now();
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+    {
+        if (!(wd->pci_slots & (1UL << slot)))
+            continue;
+        wd_snp_cntrs(wd, slot);
+        for (uint32_t i = 0; i < WD_TEL_N_CNTR; i ++)
+            raw[slot][i] = wd_rd_cntr(wd, slot, wd_cntr_desc[i].idx);
+    }
+
+    uint64_t seq = shm->seq;
+    uint64_t dt  = shm->n_sample ? now - shm->ts_ns : 0;
+    double   hz  = dt ? 1e9 / (double)dt : 0.;
+
+    __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+    {
+        if (!(wd->pci_slots & (1UL << slot)))
+            continue;
+        wd_tel_slot_t* ts    = &shm->slot[slot];
+        uint32_t       flags = 0;
+        for (uint32_t i = 0; i < WD_TEL_N_CNTR; i ++)
+        {
+            wd_tel_cntr_t* c = &ts->c[i];
+            uint32_t d = shm->n_sample ? raw[slot][i] - c->raw : 0;   // mod 2^32
+            if (wd_cntr_desc[i].kind == WD_TEL_FILL)
+                d = 0;
+            c->delta = d;
+            c->rate  = (double)d * hz;
+            c->raw   = raw[slot][i];
+
+            switch (wd_cntr_desc[i].idx)
+            {
+            case WD_CNTR_INPUT_DROPS:  if (d)                     flags |= WD_TEL_INPUT_DROP;  break;
+            case WD_CNTR_RESULT_DROPS: if (d)                     flags |= WD_TEL_RESULT_DROP; break;
+            case WD_CNTR_INPUT_FILL:   if (c->raw >= tel->fifo_hi) flags |= WD_TEL_INPUT_SAT;   break;
+            case WD_CNTR_RESULT_FILL:  if (c->raw >= tel->fifo_hi) flags |= WD_TEL_RESULT_SAT;  break;
+            }
+        }
+        ts->flags = flags;
+    }
+    shm->dt_ns   = dt;
+    shm->ts_ns   = now;
+    shm->fifo_hi = tel->fifo_hi;
+    shm->n_sample ++;
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELAXED);
+}
+
+static void* _wd_tel_main(void* arg)
+{
+    wd_tel_t*       tel = (wd_tel_t*)arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (FD_VOLATILE_CONST(tel->running))
+    {
+        wd_tel_sample(tel);
+
+        /* fixed cadence, a slow sample does not shift the next one */
+        uint64_t ns = (uint64_t)next.tv_nsec + tel->interval_ns;
+        next.tv_sec  += (time_t)(ns / 1000000000UL);
+        next.tv_nsec  = (long)(ns % 1000000000UL);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+int wd_tel_start(wd_tel_t* tel)
+{
+    if (tel->running)
+        return 0;
+    tel->running = 1;
+    if (pthread_create(&tel->thread, NULL, _wd_tel_main, tel))
+    {
+        tel->running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void wd_tel_stop(wd_tel_t* tel)
+{
+    if (!tel->running)
+        return;
+    FD_VOLATILE(tel->running) = 0;
+    pthread_join(tel->thread, NULL);
+}
+
+//    SSSSSSSSSSSSSSS  HHHHHHHHH     HHHHHHHHH MMMMMMMM               MMMMMMMM
+//  SS:::::::::::::::S H:::::::H     H:::::::H M:::::::M             M:::::::M
+// S:::::SSSSSS::::::S H:::::::H     H:::::::H M::::::::M           M::::::::M
+// S:::::S     SSSSSSS HH::::::H     H::::::HH M:::::::::M         M:::::::::M
+// S:::::S               H:::::H     H:::::H   M::::::::::M       M::::::::::M
+// S:::::S               H:::::H     H:::::H   M:::::::::::M     M:::::::::::M
+//  S::::SSSS            H::::::HHHHH::::::H   M:::::::M::::M   M::::M:::::::M
+//   SS::::::SSSSS       H:::::::::::::::::H   M::::::M M::::M M::::M M::::::M
+//     SSS::::::::SS     H:::::::::::::::::H   M::::::M  M::::M::::M  M::::::M
+//        SSSSSS::::S    H::::::HHHHH::::::H   M::::::M   M:::::::M   M::::::M
+//             S:::::S   H:::::H     H:::::H   M::::::M    M:::::M    M::::::M
+//             S:::::S   H:::::H     H:::::H   M::::::M     MMMMM     M::::::M
+// SSSSSSS     S:::::S HH::::::H     H::::::HH M::::::M               M::::::M
+// S::::::SSSSSS:::::S H:::::::H     H:::::::H M::::::M               M::::::M
+// S:::::::::::::::SS  H:::::::H     H:::::::H M::::::M               M::::::M
+//  SSSSSSSSSSSSSSS    HHHHHHHHH     HHHHHHHHH MMMMMMMM               MMMMMMMM
+
+wd_tel_shm_t const* wd_tel_join(char const* name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    void* mem = mmap(NULL, sizeof(wd_tel_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return NULL;
+
+    wd_tel_shm_t const* shm = (wd_tel_shm_t const*)mem;
+    if (FD_VOLATILE_CONST(shm->magic) != WD_TEL_MAGIC)
+    {
+        munmap(mem, sizeof(wd_tel_shm_t));
+        return NULL;
+    }
+    return shm;
+}
+
+void wd_tel_leave(wd_tel_shm_t const* shm)
+{
+    munmap((void*)shm, sizeof(wd_tel_shm_t));
+}
+
+void wd_tel_read(wd_tel_shm_t const* shm, wd_tel_shm_t* out)
+{
+    for (;;)
+    {
+        uint64_t s0 = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        if (s0 & 1)
+        {
+            _mm_pause();
+            continue;
+        }
+        memcpy(out, (void const*)shm, sizeof(wd_tel_shm_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == s0)
+            return;
+    }
+}
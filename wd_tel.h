@@ -0,0 +1,114 @@
+#ifndef HEADER_fd_src_wiredancer_wd_tel_h
+#define HEADER_fd_src_wiredancer_wd_tel_h
+
+#include <pthread.h>
+
+#include "wd_f1.h"
+
+/* Pipeline telemetry.  A sampler thread snapshots every pipeline
+   counter of every active slot once per interval and publishes raw
+   values, per-interval deltas, per-second rates and alarm flags into a
+   wd_tel_shm_t.  The struct lives in POSIX shared memory and is guarded
+   by a seqlock, so any number of other processes can watch it with
+   wd_tel_join/wd_tel_read without touching PCIe:
+
+     wd_tel_t tel;
+     wd_tel_init (&tel, &wd, "wd_tel", 100000000UL);   // 100 ms
+     wd_tel_start(&tel);
+     ...
+     wd_tel_shm_t snap;                                // elsewhere
+     wd_tel_read (wd_tel_join("wd_tel"), &snap);
+
+   While the sampler runs it owns the counter select register (0x10):
+   nobody else may call wd_rd_cntr/wd_snp_cntrs/wd_rst_cntrs. */
+
+#define WD_TEL_MAGIC            0x57445f54454c3031UL    /* "WD_TEL01" */
+#define WD_TEL_N_CNTR           14
+
+/* counter kinds */
+#define WD_TEL_COUNT            0       /* event count, has a rate     */
+#define WD_TEL_FILL             1       /* fifo level                  */
+#define WD_TEL_DROP             2       /* event count of lost work    */
+
+/* wd_tel_slot_t.flags, recomputed every sample */
+#define WD_TEL_INPUT_DROP       (1U << 0)   /* input drops went up        */
+#define WD_TEL_RESULT_DROP      (1U << 1)   /* result drops went up       */
+#define WD_TEL_INPUT_SAT        (1U << 2)   /* input fifo at/over fifo_hi */
+#define WD_TEL_RESULT_SAT       (1U << 3)   /* result fifo at/over fifo_hi*/
+
+typedef struct {
+
+    uint8_t             idx;            /* WD_CNTR_*                   */
+    uint8_t             kind;           /* WD_TEL_COUNT/FILL/DROP      */
+    char const *        name;
+
+} wd_cntr_desc_t;
+
+/* pipeline order */
+extern wd_cntr_desc_t const wd_cntr_desc[WD_TEL_N_CNTR];
+
+typedef struct {
+
+    uint32_t            raw;
+    uint32_t            delta;          /* since the previous sample   */
+    double              rate;           /* delta per second            */
+
+} wd_tel_cntr_t;
+
+typedef struct {
+
+    uint32_t            active;
+    uint32_t            flags;
+    wd_tel_cntr_t       c[WD_TEL_N_CNTR];   /* as wd_cntr_desc         */
+
+} wd_tel_slot_t;
+
+typedef struct {
+
+    uint64_t            magic;
+    uint64_t            seq;            /* seqlock, odd while written  */
+    uint64_t            n_sample;
+    uint64_t            ts_ns;          /* CLOCK_MONOTONIC of sample   */
+    uint64_t            dt_ns;          /* since the previous sample   */
+    uint64_t            interval_ns;
+    uint32_t            fifo_hi;
+    uint32_t            _pad;
+    wd_tel_slot_t       slot[WD_N_PCI_SLOTS];
+
+} wd_tel_shm_t;
+
+typedef struct {
+
+    wd_wksp_t *         wd;
+    wd_tel_shm_t *      shm;
+    char                name[64];       /* "" if not shared            */
+
+    uint64_t            interval_ns;
+    uint32_t            fifo_hi;        /* saturation level, fifo fill */
+
+    pthread_t           thread;
+    volatile int        running;
+
+} wd_tel_t;
+
+/* wd_tel_init sets tel up to sample wd every interval_ns and creates
+   the shared memory object name (NULL keeps the struct private to the
+   process).  fifo_hi defaults to the pipe-chain threshold level
+   wd_ed25519_verify_init_req programs; set it before wd_tel_start to
+   change it.  wd_tel_sample takes one sample now, wd_tel_start/
+   wd_tel_stop do it on a background thread.  wd_tel_free stops the
+   thread and removes the shared memory object. */
+int                     wd_tel_init     (wd_tel_t* tel, wd_wksp_t* wd, char const* name, uint64_t interval_ns);
+void                    wd_tel_free     (wd_tel_t* tel);
+void                    wd_tel_sample   (wd_tel_t* tel);
+int                     wd_tel_start    (wd_tel_t* tel);
+void                    wd_tel_stop     (wd_tel_t* tel);
+
+/* wd_tel_join maps the published struct of another process read-only,
+   NULL if there is none.  wd_tel_read copies a consistent sample of it
+   into out.  wd_tel_leave unmaps it. */
+wd_tel_shm_t const *    wd_tel_join     (char const* name);
+void                    wd_tel_leave    (wd_tel_shm_t const* shm);
+void                    wd_tel_read     (wd_tel_shm_t const* shm, wd_tel_shm_t* out);
+
+#endif
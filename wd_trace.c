@@ -0,0 +1,284 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include "wd_trace.h"
+
+#define _WD_TRACE_BURST         64      /* requests per replayed batch  */
+
+// TTTTTTTTTTTTTTTTTTTTTTT RRRRRRRRRRRRRRRRR                   AAA                        CCCCCCCCCCCCC EEEEEEEEEEEEEEEEEEEEEE
+// T:::::::::::::::::::::T R::::::::::::::::R                 A:::A                    CCC::::::::::::C E::::::::::::::::::::E
+// T:::::::::::::::::::::T R::::::RRRRRR:::::R               A:::::A                 CC:::::::::::::::C E::::::::::::::::::::E
+// T:::::TT:::::::TT:::::T RR:::::R     R:::::R             A:::::::A               C:::::CCCCCCCC::::C EE::::::EEEEEEEEE::::E
+// TTTTTT  T:::::T  TTTTTT   R::::R     R:::::R            A:::::::::A             C:::::C       CCCCCC   E:::::E       EEEEEE
+//         T:::::T           R::::R     R:::::R           A:::::A:::::A           C:::::C                 E:::::E
+//         T:::::T           R::::RRRRRR:::::R           A:::::A A:::::A          C:::::C                 E::::::EEEEEEEEEE
+//         T:::::T           R:::::::::::::RR           A:::::A   A:::::A         C:::::C                 E:::::::::::::::E
+//         T:::::T           R::::RRRRRR:::::R         A:::::A     A:::::A        C:::::C                 E:::::::::::::::E
+//         T:::::T           R::::R     R:::::R       A:::::AAAAAAAAA:::::A       C:::::C                 E::::::EEEEEEEEEE
+//         T:::::T           R::::R     R:::::R      A:::::::::::::::::::::A      C:::::C                 E:::::E
+//         T:::::T           R::::R     R:::::R     A:::::AAAAAAAAAAAAA:::::A      C:::::C       CCCCCC   E:::::E       EEEEEE
+//       TT:::::::TT       RR:::::R     R:::::R    A:::::A             A:::::A      C:::::CCCCCCCC::::C EE::::::EEEEEEEE:::::E
+//       T:::::::::T       R::::::R     R:::::R   A:::::A               A:::::A      CC:::::::::::::::C E::::::::::::::::::::E
+//       T:::::::::T       R::::::R     R:::::R  A:::::A                 A:::::A       CCC::::::::::::C E::::::::::::::::::::E
+//       TTTTTTTTTTT       RRRRRRRR     RRRRRRR AAAAAAA                   AAAAAAA         CCCCCCCCCCCCC EEEEEEEEEEEEEEEEEEEEEE
+
+int wd_trace_open(wd_trace_t* tr, char const* path, uint64_t cap)
+{
+    memset(tr, 0, sizeof(*tr));
+    tr->cap    = cap;
+    tr->map_sz = sizeof(wd_trace_hdr_t) + cap * sizeof(wd_trace_rec_t);
+
+    tr->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (tr->fd < 0)
+        return -1;
+    if (ftruncate(tr->fd, (off_t)tr->map_sz))
+    {
+        close(tr->fd);
+        return -1;
+    }
+    void* m = mmap(NULL, tr->map_sz, PROT_READ | PROT_WRITE, MAP_SHARED, tr->fd, 0);
+    if (m == MAP_FAILED)
+    {
+        close(tr->fd);
+        return -1;
+    }
+    tr->hdr = (wd_trace_hdr_t*)m;
+    tr->rec = (wd_trace_rec_t*)(tr->hdr + 1);
+    tr->hdr->magic  = WD_TRACE_MAGIC;
+    tr->hdr->tsc_hz = wd_tsc_hz();
+    return 0;
+}
+
+int wd_trace_close(wd_trace_t* tr)
+{
+    int err = 0;
+    if (!tr->hdr)
+        return -1;
+    if (!tr->rdonly)
+    {
+        // the beats went out with non-temporal stores
+        _mm_sfence();
+        uint64_t n = tr->n_rec < tr->cap ? tr->n_rec : tr->cap;
+        tr->hdr->n_rec  = n;
+        tr->hdr->n_drop = tr->n_drop;
+        err |= msync(tr->hdr, tr->map_sz, MS_SYNC);
+        err |= munmap(tr->hdr, tr->map_sz);
+        err |= ftruncate(tr->fd, (off_t)(sizeof(wd_trace_hdr_t) + n * sizeof(wd_trace_rec_t)));
+    }
+    else
+        err |= munmap(tr->hdr, tr->map_sz);
+    err |= close(tr->fd);
+    tr->hdr = NULL;
+    tr->rec = NULL;
+    return err ? -1 : 0;
+}
+
+void wd_trace_start(wd_trace_t* tr, wd_wksp_t* wd)
+{
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        if (wd->pci_slots & (1UL << slot))
+            FD_VOLATILE(wd->pci[slot].trace) = tr;
+}
+
+void wd_trace_stop(wd_trace_t* tr, wd_wksp_t* wd)
+{
+    (void)tr;
+    for (uint32_t slot = 0; slot < WD_N_PCI_SLOTS; slot ++)
+        FD_VOLATILE(wd->pci[slot].trace) = NULL;
+    _mm_sfence();
+}
+
+int wd_trace_load(wd_trace_t* tr, char const* path)
+{
+    memset(tr, 0, sizeof(*tr));
+    tr->rdonly = 1;
+
+    struct stat st;
+    tr->fd = open(path, O_RDONLY);
+    if (tr->fd < 0)
+        return -1;
+    if (fstat(tr->fd, &st) || (uint64_t)st.st_size < sizeof(wd_trace_hdr_t))
+    {
+        close(tr->fd);
+        return -1;
+    }
+    tr->map_sz = (uint64_t)st.st_size;
+    void* m = mmap(NULL, tr->map_sz, PROT_READ, MAP_SHARED, tr->fd, 0);
+    if (m == MAP_FAILED)
+    {
+        close(tr->fd);
+        return -1;
+    }
+    tr->hdr = (wd_trace_hdr_t*)m;
+    tr->rec = (wd_trace_rec_t*)(tr->hdr + 1);
+    tr->cap = (tr->map_sz - sizeof(wd_trace_hdr_t)) / sizeof(wd_trace_rec_t);
+    if (tr->hdr->magic != WD_TRACE_MAGIC || tr->hdr->n_rec > tr->cap)
+    {
+        munmap(m, tr->map_sz);
+        close(tr->fd);
+        tr->hdr = NULL;
+        return -1;
+    }
+    tr->n_rec  = tr->hdr->n_rec;
+    tr->n_drop = tr->hdr->n_drop;
+    return 0;
+}
+
+uint64_t wd_trace_first_seq(wd_trace_t const* tr)
+{
+    for (uint64_t i = 0; i < tr->n_rec; i ++)
+    {
+        uint32_t const* w = (uint32_t const*)tr->rec[i].beat;
+        if (w[0] == WD_PCI_MAGIC)
+            return (uint64_t)w[5] | ((uint64_t)w[6] << 32);
+    }
+    return 0;
+}
+
+/* a request being reassembled from one slot's stream: the header, then
+   sig, public key and message beats in buf */
+typedef struct {
+
+    uint32_t            need;           /* beats to come, 0: a header  */
+    uint32_t            got;
+    int                 skip;
+    int                 pending;        /* in the batch being built    */
+    uint32_t            sz;
+    uint32_t            m_chunk;
+    uint16_t            m_ctrl;
+    uint16_t            m_sz;
+    uint64_t            m_seq;
+    uint64_t            tsc;
+    uint8_t             buf[96 + WD_TRACE_MSG_MAX + 32];
+
+} _wd_trace_req_t;
+
+typedef struct {
+
+    wd_sub_t *          sub;
+    _wd_trace_req_t *   req[_WD_TRACE_BURST];
+    ulong               n;
+    int                 stuck;
+
+} _wd_trace_batch_t;
+
+static void
+_wd_trace_flush(wd_trace_t* tr, _wd_trace_batch_t* b)
+{
+    void const * msg[_WD_TRACE_BURST];
+    ulong        sz [_WD_TRACE_BURST];
+    void const * sig[_WD_TRACE_BURST];
+    void const * pub[_WD_TRACE_BURST];
+    uint64_t     m_seq  [_WD_TRACE_BURST];
+    uint32_t     m_chunk[_WD_TRACE_BURST];
+    uint16_t     m_ctrl [_WD_TRACE_BURST];
+    uint16_t     m_sz   [_WD_TRACE_BURST];
+
+    for (ulong i = 0; i < b->n; i ++)
+    {
+        _wd_trace_req_t* r = b->req[i];
+        sig[i]     = r->buf;
+        pub[i]     = r->buf + 64;
+        msg[i]     = r->buf + 96;
+        sz[i]      = r->sz;
+        m_seq[i]   = r->m_seq;
+        m_chunk[i] = r->m_chunk;
+        m_ctrl[i]  = r->m_ctrl;
+        m_sz[i]    = r->m_sz;
+        r->pending = 0;
+    }
+    ulong done = b->n ? wd_ed25519_verify_req_batch_sub(b->sub, msg, sz, sig, pub, m_seq,
+                                                        m_chunk, m_ctrl, m_sz, b->n) : 0;
+    tr->n_req += done;
+    if (done < b->n)
+        b->stuck = 1;
+    b->n = 0;
+}
+
+uint64_t wd_trace_replay(wd_trace_t* tr, wd_sub_t* sub, uint32_t flags)
+{
+    _wd_trace_req_t* st = calloc(WD_N_PCI_SLOTS * WD_N_PCI_STREAMS, sizeof(_wd_trace_req_t));
+    if (!st)
+        return 0;
+    _wd_trace_batch_t b = { .sub = sub };
+
+    // paced: recorded TSC deltas, scaled to this host's TSC
+    double   scale  = 1.;
+    uint64_t t_rec0 = tr->n_rec ? tr->rec[0].tsc : 0;
+    if (flags & WD_TRACE_PACED)
+        scale = wd_tsc_hz() / tr->hdr->tsc_hz;
+    uint64_t t0 = __rdtsc();
+
+    uint64_t n_req0 = tr->n_req;
+    for (uint64_t i = 0; i < tr->n_rec && !b.stuck; i ++)
+    {
+        wd_trace_rec_t const* rec = tr->rec + i;
+        uint64_t si = (rec->off >> 32) - 1;
+        if (rec->slot >= WD_N_PCI_SLOTS || si >= WD_N_PCI_STREAMS)
+        {
+            tr->n_bad ++;
+            continue;
+        }
+        _wd_trace_req_t* r = &st[rec->slot * WD_N_PCI_STREAMS + si];
+
+        if (!r->need)
+        {
+            uint32_t const* w = (uint32_t const*)rec->beat;
+            uint32_t len = w[1] >> 16;
+            if (w[0] != WD_PCI_MAGIC || len < 64)
+            {
+                tr->n_bad ++;
+                continue;
+            }
+            if (r->pending)
+                _wd_trace_flush(tr, &b);
+            uint32_t nb = (len - 64 + 31) / 32;
+            r->sz      = len - 64;
+            r->m_sz    = (uint16_t)w[2];
+            r->m_ctrl  = (uint16_t)(w[2] >> 16);
+            r->m_seq   = (uint64_t)w[5] | ((uint64_t)w[6] << 32);
+            r->m_chunk = w[7];
+            r->tsc     = rec->tsc;
+            r->need    = 3 + nb + (nb & 1);
+            r->got     = 0;
+            r->skip    = r->sz > WD_TRACE_MSG_MAX;
+            continue;
+        }
+
+        if (!r->skip && (r->got + 1) * 32 <= sizeof(r->buf))
+            memcpy(r->buf + r->got * 32, rec->beat, 32);
+        r->got ++;
+        if (-- r->need)
+            continue;
+        if (r->skip)
+        {
+            tr->n_skip ++;
+            continue;
+        }
+
+        if (flags & WD_TRACE_PACED)
+        {
+            uint64_t at = t0 + (uint64_t)((double)(r->tsc - t_rec0) * scale);
+            if ((int64_t)(__rdtsc() - at) < 0)
+            {
+                // send what is ready before waiting for the next one
+                _wd_trace_flush(tr, &b);
+                while ((int64_t)(__rdtsc() - at) < 0)
+                    _mm_pause();
+            }
+        }
+        r->pending = 1;
+        b.req[b.n ++] = r;
+        if (b.n == _WD_TRACE_BURST)
+            _wd_trace_flush(tr, &b);
+    }
+    if (!b.stuck)
+        _wd_trace_flush(tr, &b);
+
+    free(st);
+    return tr->n_req - n_req0;
+}
@@ -0,0 +1,114 @@
+#ifndef HEADER_fd_src_wiredancer_wd_trace_h
+#define HEADER_fd_src_wiredancer_wd_trace_h
+
+#include <x86intrin.h>
+
+#include "wd_f1.h"
+
+/* BAR4 stream capture and replay.  While a trace is started on a
+   workspace, every 32-byte beat _wd_write_256 sends to one of its slots
+   is also appended to a memory-mapped trace file, with its slot, stream
+   offset and TSC:
+
+     wd_trace_t tr;
+     wd_trace_open (&tr, "mainnet.wdt", 1UL << 24);    // 16M beats
+     wd_trace_start(&tr, &wd);
+     ...
+     wd_trace_stop (&tr, &wd);
+     wd_trace_close(&tr);
+
+   Appending is one atomic increment and two non-temporal 32-byte
+   stores; a slot without a trace pays one predictable branch per beat.
+   Beats past the file's capacity are counted and dropped.
+
+   wd_trace_load maps a trace back in and wd_trace_replay decodes the
+   request headers in it (per slot and stream, so concurrent handles
+   interleave fine) and sends the requests again through the submit
+   path of any handle, F1 or emulated, with their original m_seq,
+   chunk, ctrl and size, either as fast as the handle takes them or
+   paced to the recorded TSC.  Requests go where the replaying handle's
+   scheduler puts them, not to the recorded slot. */
+
+#define WD_TRACE_MAGIC          0x57445f5452433031UL    /* "WD_TRC01" */
+#define WD_TRACE_MSG_MAX        2048    /* longer requests are not replayed */
+
+/* wd_trace_replay flags */
+#define WD_TRACE_PACED          (1U << 0)   /* keep the recorded gaps       */
+
+typedef struct {
+
+    uint64_t            magic;
+    uint64_t            n_rec;          /* beats recorded              */
+    uint64_t            n_drop;         /* beats past the capacity     */
+    double              tsc_hz;         /* of the recording host       */
+    uint64_t            _pad[4];
+
+} wd_trace_hdr_t;
+
+typedef struct {
+
+    uint64_t            tsc;
+    uint64_t            off;            /* BAR4 offset: stream << 32 | a */
+    uint32_t            slot;
+    uint32_t            _pad[3];
+    uint8_t             beat[32];
+
+} __attribute__((aligned(64))) wd_trace_rec_t;
+
+struct wd_trace {
+
+    int                 fd;
+    wd_trace_hdr_t *    hdr;
+    wd_trace_rec_t *    rec;
+    uint64_t            cap;            /* records the file holds      */
+    uint64_t            map_sz;
+    int                 rdonly;
+
+    /* writers */
+    uint64_t            n_rec           __attribute__((aligned(64)));
+    uint64_t            n_drop;
+
+    /* replay */
+    uint64_t            n_req           __attribute__((aligned(64)));
+    uint64_t            n_bad;          /* beats outside a request     */
+    uint64_t            n_skip;         /* requests over WD_TRACE_MSG_MAX */
+
+};
+
+/* wd_trace_open creates (or truncates) path for cap beats.
+   wd_trace_close finishes the header, trims the file to what was
+   recorded and unmaps it.  Both return -1 on failure. */
+int                     wd_trace_open   (wd_trace_t* tr, char const* path, uint64_t cap);
+int                     wd_trace_close  (wd_trace_t* tr);
+
+/* wd_trace_start records the beats sent to every slot of wd from now
+   on, wd_trace_stop ends it.  Call them while nothing submits. */
+void                    wd_trace_start  (wd_trace_t* tr, wd_wksp_t* wd);
+void                    wd_trace_stop   (wd_trace_t* tr, wd_wksp_t* wd);
+
+/* wd_trace_load maps the trace at path read-only (wd_trace_close
+   unmaps it); -1 if it is not one.  wd_trace_replay sends every
+   request in it on sub, flags WD_TRACE_*, and returns how many it
+   sent; it gives up (returning early) only if sub stays full past its
+   timeout.  wd_trace_first_seq is the m_seq of the first request, for
+   wd_ed25519_verify_init_resp. */
+int                     wd_trace_load   (wd_trace_t* tr, char const* path);
+uint64_t                wd_trace_replay (wd_trace_t* tr, wd_sub_t* sub, uint32_t flags);
+uint64_t                wd_trace_first_seq (wd_trace_t const* tr);
+
+/* append one beat, see _wd_write_256 */
+static inline void
+_wd_trace_beat(wd_trace_t* tr, uint32_t slot, uint64_t off, __m256i v)
+{
+    uint64_t i = __atomic_fetch_add(&tr->n_rec, 1, __ATOMIC_RELAXED);
+    if (i >= tr->cap)
+    {
+        __atomic_fetch_add(&tr->n_drop, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    __m256i* r = (__m256i*)(tr->rec + i);
+    _mm256_stream_si256(r + 0, _mm256_setr_epi64x((long)__rdtsc(), (long)off, (long)slot, 0));
+    _mm256_stream_si256(r + 1, v);
+}
+
+#endif